@@ -30,9 +30,11 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "DataModel.h"
 
 #include <Method.h>
+#include <PerfMethod.h>
 #include <PicoScopeMethod.h>
 #include <RaplMethod.h>
 #include <TimerMethod.h>
+#include <algorithm>
 #include <iostream>
 
 using namespace datamodel;
@@ -41,11 +43,12 @@ using namespace repara::measurement;
 using namespace repara::measurement::scope;
 using namespace repara::measurement::rapl;
 using namespace repara::measurement::timer;
+using namespace repara::measurement::perf;
 
 
 void printUsage()
 {
-    std::cout << "Usage:\t ./measureTool --config configFile [--scope --rapl --timer --isAggregate]" << std::endl;
+    std::cout << "Usage:\t ./measureTool --config configFile [--scope --rapl --timer --perf --isAggregate --isExclusive --isRepeated]" << std::endl;
 }
 
 const std::string convertCapability(const SourceCapability& sourceCapability)
@@ -64,6 +67,34 @@ const std::string convertCapability(const SourceCapability& sourceCapability)
         return "KERNELTIME";
     if (sourceCapability == SourceCapability::UserTime)
         return "USERTIME";
+    if (sourceCapability == SourceCapability::InvocationCount)
+        return "INVOCATIONCOUNT";
+    if (sourceCapability == SourceCapability::CoreEnergy)
+        return "COREENERGY";
+    if (sourceCapability == SourceCapability::UncoreEnergy)
+        return "UNCOREENERGY";
+    if (sourceCapability == SourceCapability::DramEnergy)
+        return "DRAMENERGY";
+    if (sourceCapability == SourceCapability::PlatformEnergy)
+        return "PLATFORMENERGY";
+    if (sourceCapability == SourceCapability::MedianPower)
+        return "MEDIANPOWER";
+    if (sourceCapability == SourceCapability::Percentile95Power)
+        return "PERCENTILE95POWER";
+    if (sourceCapability == SourceCapability::InvocationEnergy)
+        return "INVOCATIONENERGY";
+    if (sourceCapability == SourceCapability::InvocationEnergyLow)
+        return "INVOCATIONENERGYLOW";
+    if (sourceCapability == SourceCapability::InvocationEnergyHigh)
+        return "INVOCATIONENERGYHIGH";
+    if (sourceCapability == SourceCapability::Cycles)
+        return "CYCLES";
+    if (sourceCapability == SourceCapability::Instructions)
+        return "INSTRUCTIONS";
+    if (sourceCapability == SourceCapability::LlcMisses)
+        return "LLCMISSES";
+    if (sourceCapability == SourceCapability::BranchMisses)
+        return "BRANCHMISSES";
 
     return "";
 }
@@ -83,7 +114,19 @@ const std::string convertSourceMap(const Measurement::SourceMap& sourceMap, cons
     return result;
 }
 
-const std::string convertKernelSourceMap(const Measurement& measurement, const std::string& type, bool isAggregate)
+bool isSampled(const Measurement& measurement, const std::string& kernelName)
+{
+    const std::vector<std::string>& kernelNames = measurement.kernelNames();
+    const std::size_t kernel = std::find(kernelNames.begin(), kernelNames.end(), kernelName) - kernelNames.begin();
+    Measurement::InvocationList::const_iterator invocationIt = measurement.invocations().begin();
+    for (; invocationIt != measurement.invocations().end(); ++invocationIt) {
+        if (invocationIt->kernel == kernel && invocationIt->weight != 1.0)
+            return true;
+    }
+    return false;
+}
+
+const std::string convertKernelSourceMap(const Measurement& measurement, const std::string& type, bool isAggregate, bool isExclusive)
 {
     std::string result;
 
@@ -93,6 +136,12 @@ const std::string convertKernelSourceMap(const Measurement& measurement, const s
         result.append("kernelName: " + kernelName + "\n");
         if (isAggregate) {
             result.append(convertSourceMap(measurement.aggregatedSources(kernelName), type));
+            // the confidence of the totals extrapolated from a sampled kernel
+            if (isSampled(measurement, kernelName))
+                result.append(convertSourceMap(measurement.aggregatedErrors(kernelName), type + "_ERROR"));
+            // without the nested kernels
+            if (isExclusive)
+                result.append(convertSourceMap(measurement.exclusiveSources(kernelName), type + "_EXCLUSIVE"));
         }
         else {
             Measurement::SourceContainer::const_iterator resultsIt = kernelSourceIt->second.begin();
@@ -117,8 +166,15 @@ int main(int argc, char *argv[]) {
     #ifdef SCOPE
     bool isScopeEnabled = false;
     #endif
+    #ifdef PERF
+    bool isPerfEnabled = false;
+    #endif
 
     bool isAggregate = false;
+    bool isExclusive = false;
+    #ifdef RAPL
+    bool isRepeated = false;
+    #endif
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
         if ((arg.compare("-c")) == 0 || (arg.compare("--config")) == 0) {
@@ -144,9 +200,22 @@ int main(int argc, char *argv[]) {
             isTimerEnabled = true;
         }
         #endif
+        #ifdef PERF
+        if ((arg.compare("--perf")) == 0) {
+            isPerfEnabled = true;
+        }
+        #endif
         if ((arg.compare("--isAggregate")) == 0) {
             isAggregate = true;
         }
+        if ((arg.compare("--isExclusive")) == 0) {
+            isExclusive = true;
+        }
+        #ifdef RAPL
+        if ((arg.compare("--isRepeated")) == 0) {
+            isRepeated = true;
+        }
+        #endif
         if ((arg.compare("--help")) == 0) {
             printUsage();
             return EXIT_SUCCESS;
@@ -165,6 +234,9 @@ int main(int argc, char *argv[]) {
     RaplMethod* raplMethod = NULL;
     if (isRaplEnabled) {
         raplMethod = RaplMethod::getInstance();
+        // the energy per invocation of the short kernels, in the aggregated results
+        if (isRepeated)
+            raplMethod->setAggregation(AGGREGATE_REPEATED);
     }
     #endif
 
@@ -182,6 +254,13 @@ int main(int argc, char *argv[]) {
     }
     #endif
 
+    #ifdef PERF
+    PerfMethod* perfMethod = NULL;
+    if (isPerfEnabled) {
+        perfMethod = PerfMethod::getInstance();
+    }
+    #endif
+
     const std::vector<Program>& programs = dataModel.programs();
     std::vector<Program>::const_iterator programIterator = programs.begin();
     for (; programIterator != programs.end(); ++programIterator)
@@ -208,6 +287,13 @@ int main(int argc, char *argv[]) {
             timerMeasurement = timerMethod->start();
         }
         #endif
+
+        #ifdef PERF
+        repara::measurement::Measurement* perfMeasurement = NULL;
+        if (isPerfEnabled) {
+            perfMeasurement = perfMethod->start();
+        }
+        #endif
         // run the current application
         std::cout << "Running the " << (*programIterator).name()  << " program" << std::endl;
         programIterator->runProgram();
@@ -218,7 +304,7 @@ int main(int argc, char *argv[]) {
         if (isRaplEnabled && raplMeasurement) {
             // stop the measurement
             raplMeasurement->stop();
-            const std::string raplTest = convertKernelSourceMap(*raplMeasurement, "RAPL", isAggregate);
+            const std::string raplTest = convertKernelSourceMap(*raplMeasurement, "RAPL", isAggregate, isExclusive);
             measurementResults.append(raplTest);
             delete raplMeasurement;
         }
@@ -228,17 +314,27 @@ int main(int argc, char *argv[]) {
         if (isTimerEnabled && timerMeasurement) {
             // stop the measurement
             timerMeasurement->stop();
-            const std::string timerTest = convertKernelSourceMap(*timerMeasurement, "TIMER", isAggregate);
+            const std::string timerTest = convertKernelSourceMap(*timerMeasurement, "TIMER", isAggregate, isExclusive);
             measurementResults.append(timerTest);
             delete timerMeasurement;
         }
         #endif
 
+        #ifdef PERF
+        if (isPerfEnabled && perfMeasurement) {
+            // stop the measurement
+            perfMeasurement->stop();
+            const std::string perfTest = convertKernelSourceMap(*perfMeasurement, "PERF", isAggregate, isExclusive);
+            measurementResults.append(perfTest);
+            delete perfMeasurement;
+        }
+        #endif
+
         #ifdef SCOPE
         if (isScopeEnabled && scopeMeasurement) {
             // stop the measurement
             scopeMeasurement->stop();
-            const std::string scopeTest = convertKernelSourceMap(*scopeMeasurement, "SCOPE", isAggregate);
+            const std::string scopeTest = convertKernelSourceMap(*scopeMeasurement, "SCOPE", isAggregate, isExclusive);
             measurementResults.append(scopeTest);
             delete scopeMeasurement;
         }
@@ -262,5 +358,10 @@ int main(int argc, char *argv[]) {
         TimerMethod::deleteInstance();
     #endif
 
+    #ifdef PERF
+    if (perfMethod)
+        PerfMethod::deleteInstance();
+    #endif
+
     return EXIT_SUCCESS;
 }
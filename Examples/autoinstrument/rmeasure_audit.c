@@ -0,0 +1,341 @@
+/*
+ * Kernel markers for binaries which were not built with rmeasure.h.
+ *
+ * The library is an rtld-audit module (see rtld-audit(7)), the dynamic linker
+ * reports every binding of a function to it:
+ *
+ *     LD_AUDIT=/path/to/librmeasure_audit.so RMEASURE_SYMBOLS="cblas_dgemm,^fftw_execute" ./app
+ *
+ * The calls of the functions matching RMEASURE_SYMBOLS through the PLT (the
+ * calls from one shared object to another) are kernels named after the
+ * function: their begin and end markers are sent by la_pltenter() and
+ * la_pltexit() with the marker path of rmeasure.h (ring, socket or FIFO,
+ * sampling). RMEASURE_SYMBOLS is a comma separated list of function names,
+ * an item with any of the characters ^$.*+?[]()| is an extended regular
+ * expression matched against the names.
+ *
+ * The time spent in the hooks is accounted for each function, it is written
+ * at exit to RMEASURE_AUDIT_REPORT (stderr by default) as the hook overhead.
+ * The profiling trampoline of the dynamic linker (_dl_runtime_profile) and
+ * its copy of RMEASURE_AUDIT_FRAME bytes of the stack run outside the hooks
+ * and are not part of it.
+ *
+ * A function name longer than a kernel name is cut and ended with the hash of
+ * the full name, so functions with a common prefix stay separate kernels.
+ *
+ * Limitations: objects linked with -z now (or run with LD_BIND_NOW) are not
+ * instrumented, a function left by longjmp() or an exception doesn't send its
+ * end marker, and the markers are not batched (the module can't start the
+ * flusher thread in its own link map namespace).
+ */
+
+#define _GNU_SOURCE
+#define DYNAMIC_ANALYSIS
+
+#include <dlfcn.h>
+#include <link.h>
+#include <regex.h>
+
+#include "rmeasure.h"
+
+#define AUDIT_MAX_PATTERNS 64       /* items of RMEASURE_SYMBOLS */
+#define AUDIT_MAX_SYMBOLS 256       /* instrumented functions */
+#define AUDIT_MAX_BINDINGS 4096     /* bindings of the instrumented functions, a power of two */
+
+/*
+ * The bytes of the stack of the caller copied for the arguments passed on the
+ * stack, it can be changed by RMEASURE_AUDIT_FRAME.
+ */
+#define AUDIT_DEFAULT_FRAME 256
+
+struct AuditPattern {
+    char* name;
+    int isRegex;
+    regex_t regex;
+};
+
+/* An instrumented function and its accounting. */
+struct AuditSymbol {
+    char* function;                 /* full name of the function */
+    uint64_t hash;                  /* hash of the full name */
+    char name[RMEASURE_NAME_SIZE];  /* kernel name */
+    uint32_t id;
+    uint64_t calls;
+    uint64_t overhead;              /* ns spent in the hooks */
+};
+
+/*
+ * The symbol names passed to the hooks point into the string table of the
+ * calling object, so they identify a binding: name pointer -> symbol.
+ */
+struct AuditBinding {
+    const char* symname;
+    struct AuditSymbol* symbol;
+};
+
+static struct AuditPattern auditPatterns[AUDIT_MAX_PATTERNS];
+static unsigned auditPatternCount = 0;
+static struct AuditSymbol auditSymbols[AUDIT_MAX_SYMBOLS];
+static unsigned auditSymbolCount = 0;
+static struct AuditBinding auditBindings[AUDIT_MAX_BINDINGS];
+static pthread_mutex_t auditMutex = PTHREAD_MUTEX_INITIALIZER;
+static long int auditFrameSize = AUDIT_DEFAULT_FRAME;
+
+static void parsePatterns(void)
+{
+    const char* item = getenv("RMEASURE_SYMBOLS");
+    const char* frame = getenv("RMEASURE_AUDIT_FRAME");
+
+    if (frame && atol(frame) > 0)
+        auditFrameSize = atol(frame);
+
+    while (item && *item && auditPatternCount < AUDIT_MAX_PATTERNS) {
+        const char* end = strchr(item, ',');
+        size_t length = end ? (size_t)(end - item) : strlen(item);
+        if (length > 0) {
+            struct AuditPattern* pattern = &auditPatterns[auditPatternCount];
+            pattern->name = strndup(item, length);
+            pattern->isRegex = strpbrk(pattern->name, "^$.*+?[]()|") != NULL;
+            if (pattern->name && (!pattern->isRegex || regcomp(&pattern->regex, pattern->name, REG_EXTENDED | REG_NOSUB) == 0))
+                ++auditPatternCount;
+            else
+                fprintf(stderr, "rmeasure_audit: invalid symbol pattern %s\n", pattern->name ? pattern->name : "");
+        }
+        item = end ? end + 1 : NULL;
+    }
+}
+
+static int matchPatterns(const char* symname)
+{
+    unsigned i;
+    for (i = 0; i < auditPatternCount; ++i) {
+        const struct AuditPattern* pattern = &auditPatterns[i];
+        if (pattern->isRegex ? regexec(&pattern->regex, symname, 0, NULL, 0) == 0 : strcmp(pattern->name, symname) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+/* FNV-1a of the full function name. */
+static uint64_t hashName(const char* symname)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (; *symname; ++symname)
+        hash = (hash ^ (unsigned char)*symname) * 0x100000001b3ull;
+    return hash;
+}
+
+static inline size_t bindingSlot(const char* symname)
+{
+    return ((uintptr_t)symname >> 3) * 0x9e3779b97f4a7c15ull >> 32;
+}
+
+/* The instrumented function of a binding, NULL if the function is not instrumented. */
+static inline struct AuditSymbol* boundSymbol(const char* symname)
+{
+    size_t slot = bindingSlot(symname);
+    size_t i;
+    for (i = 0; i < AUDIT_MAX_BINDINGS; ++i) {
+        struct AuditBinding* binding = &auditBindings[(slot + i) & (AUDIT_MAX_BINDINGS - 1)];
+        const char* bound = __atomic_load_n(&binding->symname, __ATOMIC_ACQUIRE);
+        if (bound == symname)
+            return binding->symbol;
+        if (!bound)
+            return NULL;
+    }
+    return NULL;
+}
+
+/* Instrument a binding of a matching function. Returns 0 if the tables are full. */
+static int bindSymbol(const char* symname)
+{
+    struct AuditSymbol* symbol = NULL;
+    const uint64_t hash = hashName(symname);
+    size_t slot = bindingSlot(symname);
+    unsigned i;
+    int bound = 0;
+
+    pthread_mutex_lock(&auditMutex);
+    for (i = 0; i < auditSymbolCount; ++i) {
+        if (auditSymbols[i].hash == hash && strcmp(auditSymbols[i].function, symname) == 0) {
+            symbol = &auditSymbols[i];
+            break;
+        }
+    }
+    if (!symbol && auditSymbolCount < AUDIT_MAX_SYMBOLS) {
+        char* function = strdup(symname);
+        if (function) {
+            symbol = &auditSymbols[auditSymbolCount++];
+            symbol->function = function;
+            symbol->hash = hash;
+            /* the prefix of a long name, '~' and 8 hex digits of its hash fill the kernel name */
+            if (strlen(symname) < RMEASURE_NAME_SIZE)
+                strcpy(symbol->name, symname);
+            else
+                snprintf(symbol->name, RMEASURE_NAME_SIZE, "%.*s~%08x", RMEASURE_NAME_SIZE - 10, symname, (uint32_t)hash);
+            symbol->id = rmeasureKernelId(symbol->name);
+        }
+    }
+    for (i = 0; symbol && i < AUDIT_MAX_BINDINGS; ++i) {
+        struct AuditBinding* binding = &auditBindings[(slot + i) & (AUDIT_MAX_BINDINGS - 1)];
+        if (binding->symname == symname) {
+            bound = 1;
+            break;
+        }
+        if (!binding->symname) {
+            binding->symbol = symbol;
+            __atomic_store_n(&binding->symname, symname, __ATOMIC_RELEASE);
+            bound = 1;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&auditMutex);
+    return bound;
+}
+
+static inline void auditEnter(const char* symname, long int* framesizep)
+{
+    const uint64_t start = markerTimestamp();
+    struct AuditSymbol* symbol = boundSymbol(symname);
+    if (!symbol)
+        return;
+
+    sendMarker(RMEASURE_MARKER_BEGIN, symbol->id, symbol->name);
+    /* a frame size makes the dynamic linker call la_pltexit() */
+    *framesizep = auditFrameSize;
+    __atomic_fetch_add(&symbol->calls, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&symbol->overhead, markerTimestamp() - start, __ATOMIC_RELAXED);
+}
+
+static inline void auditExit(const char* symname)
+{
+    const uint64_t start = markerTimestamp();
+    struct AuditSymbol* symbol = boundSymbol(symname);
+    if (!symbol)
+        return;
+
+    sendMarker(RMEASURE_MARKER_END, 0, NULL);
+    __atomic_fetch_add(&symbol->overhead, markerTimestamp() - start, __ATOMIC_RELAXED);
+}
+
+unsigned int la_version(unsigned int version)
+{
+    parsePatterns();
+    /* the flusher thread of the batches can't be started in the namespace of the module */
+    rmeasureBatchSize = 0;
+    return version < LAV_CURRENT ? version : LAV_CURRENT;
+}
+
+unsigned int la_objopen(struct link_map* map, Lmid_t lmid, uintptr_t* cookie)
+{
+    (void)map;
+    (void)cookie;
+    /* the objects of the application only, not the ones of the module */
+    return lmid == LM_ID_BASE ? LA_FLG_BINDTO | LA_FLG_BINDFROM : 0;
+}
+
+void la_preinit(uintptr_t* cookie)
+{
+    (void)cookie;
+    /*
+     * The fork() of the application runs the atfork handlers of its own libc,
+     * the child gets new producer ids and registrations through that one.
+     */
+    void* libc = dlmopen(LM_ID_BASE, "libc.so.6", RTLD_NOW | RTLD_NOLOAD);
+    if (libc) {
+        int (*registerAtfork)(void (*)(void), void (*)(void), void (*)(void), void*) =
+            (int (*)(void (*)(void), void (*)(void), void (*)(void), void*))dlsym(libc, "__register_atfork");
+        if (registerAtfork)
+            registerAtfork(NULL, NULL, resetProducer, NULL);
+    }
+}
+
+uintptr_t la_symbind64(Elf64_Sym* sym, unsigned int ndx, uintptr_t* refcook, uintptr_t* defcook,
+                       unsigned int* flags, const char* symname)
+{
+    (void)ndx;
+    (void)refcook;
+    (void)defcook;
+    if (auditPatternCount == 0 || !matchPatterns(symname) || !bindSymbol(symname))
+        *flags |= LA_SYMB_NOPLTENTER | LA_SYMB_NOPLTEXIT;
+    return sym->st_value;
+}
+
+#if defined(__x86_64__)
+
+Elf64_Addr la_x86_64_gnu_pltenter(Elf64_Sym* sym, unsigned int ndx, uintptr_t* refcook, uintptr_t* defcook,
+                                  La_x86_64_regs* regs, unsigned int* flags, const char* symname, long int* framesizep)
+{
+    (void)ndx;
+    (void)refcook;
+    (void)defcook;
+    (void)regs;
+    (void)flags;
+    auditEnter(symname, framesizep);
+    return sym->st_value;
+}
+
+unsigned int la_x86_64_gnu_pltexit(Elf64_Sym* sym, unsigned int ndx, uintptr_t* refcook, uintptr_t* defcook,
+                                   const La_x86_64_regs* inregs, La_x86_64_retval* outregs, const char* symname)
+{
+    (void)sym;
+    (void)ndx;
+    (void)refcook;
+    (void)defcook;
+    (void)inregs;
+    (void)outregs;
+    auditExit(symname);
+    return 0;
+}
+
+#elif defined(__aarch64__)
+
+Elf64_Addr la_aarch64_gnu_pltenter(Elf64_Sym* sym, unsigned int ndx, uintptr_t* refcook, uintptr_t* defcook,
+                                   La_aarch64_regs* regs, unsigned int* flags, const char* symname, long int* framesizep)
+{
+    (void)ndx;
+    (void)refcook;
+    (void)defcook;
+    (void)regs;
+    (void)flags;
+    auditEnter(symname, framesizep);
+    return sym->st_value;
+}
+
+unsigned int la_aarch64_gnu_pltexit(Elf64_Sym* sym, unsigned int ndx, uintptr_t* refcook, uintptr_t* defcook,
+                                    const La_aarch64_regs* inregs, La_aarch64_retval* outregs, const char* symname)
+{
+    (void)sym;
+    (void)ndx;
+    (void)refcook;
+    (void)defcook;
+    (void)inregs;
+    (void)outregs;
+    auditExit(symname);
+    return 0;
+}
+
+#else
+#error "rmeasure_audit supports x86_64 and aarch64 only"
+#endif
+
+/* The overhead accounting of the instrumented functions. */
+__attribute__((destructor)) static void auditReport(void)
+{
+    const char* path = getenv("RMEASURE_AUDIT_REPORT");
+    FILE* out = path ? fopen(path, "w") : NULL;
+    unsigned i;
+
+    if (auditSymbolCount == 0)
+        return;
+    if (!out)
+        out = stderr;
+    fprintf(out, "%-48s %14s %20s %14s\n", "function", "calls", "hook overhead (ns)", "hook ns/call");
+    for (i = 0; i < auditSymbolCount; ++i) {
+        const struct AuditSymbol* symbol = &auditSymbols[i];
+        fprintf(out, "%-48s %14llu %20llu %14.1f\n", symbol->function, (unsigned long long)symbol->calls,
+                (unsigned long long)symbol->overhead, symbol->calls ? (double)symbol->overhead / symbol->calls : 0.0);
+    }
+    if (out != stderr)
+        fclose(out);
+}
@@ -0,0 +1,296 @@
+/*
+Copyright (c) 2014-2017 University of Szeged
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software without
+   specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * Overhead of the marker path: DYNAMIC_BEGIN/DYNAMIC_END pairs are sent at
+ * controlled rates from 1 to N threads while the rMeasureService listens
+ * with the timer method. Every step reports the latency percentiles of a
+ * marker at the producer, the markers lost or dropped by the service, and
+ * the CPU time of the listener thread (rmeasure.getListenerStatistics).
+ * The rate is doubled until markers are lost or the producers can't keep
+ * it up (backpressure), the last rate before is the max sustained rate.
+ *
+ * The transport of the markers is selected by the environment as for any
+ * instrumented program (RMEASURE_BATCH, RMEASURE_SOCKET).
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include <time.h>
+#include <unistd.h>
+#include <xmlrpc-c/base.hpp>
+#include <xmlrpc-c/client_simple.hpp>
+
+#define DYNAMIC_ANALYSIS
+#include "rmeasure.h"
+
+#define RMEASURESERVICE "RMEASURESERVICE"
+
+/* Latencies are counted in 1 ns buckets up to LATENCY_BUCKETS ns, the longer ones in the last bucket. */
+static const std::size_t LATENCY_BUCKETS = 1 << 16;
+/* The listener thread of the service starts after timer.startListening returns. */
+static const unsigned LISTENER_START_MS = 200;
+/* A step is sustained if the producers kept up this part of the target rate. */
+static const double SUSTAINED_RATE = 0.95;
+
+struct Settings {
+    unsigned maxThreads;
+    double seconds;     ///< duration of a step
+    double startRate;   ///< markers/s of the first step of every thread count
+    double maxRate;     ///< markers/s, the sweep stops above it
+};
+
+struct StepResult {
+    double targetRate;
+    double achievedRate;
+    uint64_t sent;      ///< markers
+    uint64_t received;  ///< markers of the measured invocations
+    uint64_t dropped;   ///< markers dropped by the marker ring
+    uint64_t percentiles[4]; ///< p50, p99, p99.9 and max latency (ns)
+    double listenerCpu; ///< CPU time of the listener / elapsed time
+    double cpuPerMarker; ///< ns CPU time of the listener per received record
+};
+
+static inline uint64_t nowNs()
+{
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000ull + (uint64_t)time.tv_nsec;
+}
+
+/* The cost of reading the clock, subtracted from the measured latencies. */
+static uint64_t clockOverhead()
+{
+    std::vector<uint64_t> samples;
+    for (int i = 0; i < 10001; ++i) {
+        const uint64_t start = nowNs();
+        samples.push_back(nowNs() - start);
+    }
+    std::nth_element(samples.begin(), samples.begin() + samples.size() / 2, samples.end());
+    return samples[samples.size() / 2];
+}
+
+static inline void record(std::vector<uint64_t>& histogram, uint64_t latency, uint64_t& maxLatency)
+{
+    ++histogram[std::min<uint64_t>(latency, LATENCY_BUCKETS - 1)];
+    maxLatency = std::max(maxLatency, latency);
+}
+
+/*
+ * Send pairs of markers for the given time at rate markers/s, and collect
+ * their latencies. Returns the number of sent markers.
+ */
+static uint64_t produce(double rate, double seconds, uint64_t clockCost,
+                        std::vector<uint64_t>& histogram, uint64_t& maxLatency)
+{
+    const double period = 2e9 / rate;
+    const uint64_t start = nowNs();
+    const uint64_t end = start + (uint64_t)(seconds * 1e9);
+    uint64_t pairs = 0;
+
+    for (uint64_t now = start; now < end; ) {
+        const uint64_t due = start + (uint64_t)(pairs * period);
+        if (now < due) {
+            // sleep if the next pair is far enough, otherwise spin
+            if (due - now > 100000) {
+                timespec sleep = { 0, (long)(due - now - 50000) };
+                nanosleep(&sleep, NULL);
+            }
+            now = nowNs();
+            continue;
+        }
+
+        const uint64_t beginStart = nowNs();
+        DYNAMIC_BEGIN("markerbench")
+        const uint64_t beginEnd = nowNs();
+        DYNAMIC_END
+        now = nowNs();
+        record(histogram, beginEnd - beginStart > clockCost ? beginEnd - beginStart - clockCost : 0, maxLatency);
+        record(histogram, now - beginEnd > clockCost ? now - beginEnd - clockCost : 0, maxLatency);
+        ++pairs;
+    }
+    return pairs * 2;
+}
+
+static uint64_t percentile(const std::vector<uint64_t>& histogram, uint64_t count, double fraction)
+{
+    const uint64_t rank = (uint64_t)(fraction * (count - 1)) + 1;
+    uint64_t seen = 0;
+    for (std::size_t i = 0; i < histogram.size(); ++i) {
+        seen += histogram[i];
+        if (seen >= rank)
+            return i;
+    }
+    return histogram.size() - 1;
+}
+
+static bool callService(const std::string& method, xmlrpc_c::value* result)
+{
+    try {
+        xmlrpc_c::clientSimple client;
+        client.call(getenv(RMEASURESERVICE), method, "", result);
+        return true;
+    } catch (std::exception const& e) {
+        std::cerr << method << " failed: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+static bool runStep(unsigned threads, double rate, const Settings& settings, uint64_t clockCost, StepResult& result)
+{
+    xmlrpc_c::value startResult, stopResult, statisticsResult;
+    if (!callService("timer.startListening", &startResult) || !static_cast<bool>(xmlrpc_c::value_boolean(startResult)))
+        return false;
+    usleep(LISTENER_START_MS * 1000);
+
+    std::vector<std::vector<uint64_t> > histograms(threads, std::vector<uint64_t>(LATENCY_BUCKETS, 0));
+    std::vector<uint64_t> maxLatencies(threads, 0);
+    std::vector<uint64_t> sent(threads, 0);
+    std::vector<std::thread> producers;
+    const uint64_t start = nowNs();
+    for (unsigned i = 0; i < threads; ++i) {
+        producers.push_back(std::thread([&, i]() {
+            sent[i] = produce(rate / threads, settings.seconds, clockCost, histograms[i], maxLatencies[i]);
+        }));
+    }
+    for (unsigned i = 0; i < threads; ++i)
+        producers[i].join();
+    const uint64_t elapsed = nowNs() - start;
+
+    if (!callService("timer.stopListening", &stopResult) || !callService("rmeasure.getListenerStatistics", &statisticsResult))
+        return false;
+    std::map<std::string, xmlrpc_c::value> statistics(static_cast<std::map<std::string, xmlrpc_c::value> >(xmlrpc_c::value_struct(statisticsResult)));
+    const double records = xmlrpc_c::value_double(statistics["records"]);
+    const double cpuTime = xmlrpc_c::value_double(statistics["cpuTime"]);
+    const double listenTime = xmlrpc_c::value_double(statistics["elapsedTime"]);
+
+    std::vector<uint64_t> histogram(LATENCY_BUCKETS, 0);
+    uint64_t maxLatency = 0;
+    result.sent = 0;
+    for (unsigned i = 0; i < threads; ++i) {
+        for (std::size_t j = 0; j < LATENCY_BUCKETS; ++j)
+            histogram[j] += histograms[i][j];
+        maxLatency = std::max(maxLatency, maxLatencies[i]);
+        result.sent += sent[i];
+    }
+
+    result.targetRate = rate;
+    result.achievedRate = result.sent * 1e9 / elapsed;
+    // every invocation is a begin and an end marker
+    result.received = 2 * (uint64_t)xmlrpc_c::value_double(statistics["invocations"]);
+    result.dropped = (uint64_t)xmlrpc_c::value_double(statistics["dropped"]);
+    result.percentiles[0] = result.sent ? percentile(histogram, result.sent, 0.5) : 0;
+    result.percentiles[1] = result.sent ? percentile(histogram, result.sent, 0.99) : 0;
+    result.percentiles[2] = result.sent ? percentile(histogram, result.sent, 0.999) : 0;
+    result.percentiles[3] = maxLatency;
+    result.listenerCpu = listenTime > 0 ? cpuTime / listenTime : 0.0;
+    result.cpuPerMarker = records > 0 ? cpuTime / records : 0.0;
+    return true;
+}
+
+static void printUsage()
+{
+    std::cout << "Usage: RMEASURESERVICE=http://localhost:8080/RPC2 markerbench [-t maxThreads] [-d seconds] [-r startRate] [-m maxRate]" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    Settings settings;
+    settings.maxThreads = std::max(1u, std::thread::hardware_concurrency() / 2);
+    settings.seconds = 1.0;
+    settings.startRate = 10000.0;
+    settings.maxRate = 100e6;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            printUsage();
+            return EXIT_FAILURE;
+        }
+        if (arg == "-t")
+            settings.maxThreads = std::max(1, atoi(argv[++i]));
+        else if (arg == "-d")
+            settings.seconds = atof(argv[++i]);
+        else if (arg == "-r")
+            settings.startRate = atof(argv[++i]);
+        else if (arg == "-m")
+            settings.maxRate = atof(argv[++i]);
+        else {
+            printUsage();
+            return EXIT_FAILURE;
+        }
+    }
+    if (!getenv(RMEASURESERVICE) || settings.seconds <= 0.0 || settings.startRate <= 0.0) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+    if (getenv("RMEASURE_SAMPLING"))
+        std::cerr << "RMEASURE_SAMPLING is set, the sampled markers are counted as lost" << std::endl;
+
+    const uint64_t clockCost = clockOverhead();
+    std::cout << "transport: " << (getenv("RMEASURE_SOCKET") ? "socket" : "ring or named pipe")
+              << (getenv("RMEASURE_BATCH") ? ", batched" : "") << ", clock overhead " << clockCost << " ns" << std::endl;
+    printf("%7s %12s %12s %12s %10s %10s %8s %8s %8s %8s %9s %9s\n", "threads", "target/s", "achieved/s", "sent",
+           "lost", "dropped", "p50 ns", "p99 ns", "p99.9 ns", "max ns", "listener", "ns/record");
+
+    std::vector<std::pair<unsigned, double> > sustained;
+    for (unsigned threads = 1; threads <= settings.maxThreads; threads = threads < settings.maxThreads ? std::min(threads * 2, settings.maxThreads) : threads + 1) {
+        double maxSustained = 0.0;
+        for (double rate = settings.startRate; rate <= settings.maxRate; rate *= 2) {
+            StepResult result;
+            if (!runStep(threads, rate, settings, clockCost, result))
+                return EXIT_FAILURE;
+
+            const uint64_t lost = result.sent > result.received ? result.sent - result.received : 0;
+            printf("%7u %12.0f %12.0f %12llu %10llu %10llu %8llu %8llu %8llu %8llu %8.1f%% %9.1f\n", threads,
+                   result.targetRate, result.achievedRate, (unsigned long long)result.sent, (unsigned long long)lost,
+                   (unsigned long long)result.dropped, (unsigned long long)result.percentiles[0],
+                   (unsigned long long)result.percentiles[1], (unsigned long long)result.percentiles[2],
+                   (unsigned long long)result.percentiles[3], result.listenerCpu * 100.0, result.cpuPerMarker);
+            fflush(stdout);
+
+            if (lost > 0 || result.dropped > 0 || result.achievedRate < SUSTAINED_RATE * result.targetRate)
+                break;
+            maxSustained = result.achievedRate;
+        }
+        sustained.push_back(std::make_pair(threads, maxSustained));
+    }
+
+    std::cout << std::endl << "max sustained rate (markers/s without loss or backpressure):" << std::endl;
+    for (std::size_t i = 0; i < sustained.size(); ++i)
+        printf("%7u %12.0f\n", sustained[i].first, sustained[i].second);
+    return EXIT_SUCCESS;
+}
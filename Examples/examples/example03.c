@@ -0,0 +1,27 @@
+/*
+* compile: gcc example03.c -o example03 -DDYNAMIC_ANALYSIS
+*/
+#include <unistd.h>
+#include <stdio.h>
+#include "rmeasure.h"
+
+int main(void)
+{
+    int i = 0;
+
+    DYNAMIC_BEGIN("example03_iterations")
+    for (i = 0; i < 3; i++) {
+        DYNAMIC_BEGIN("example03_phase")
+        sleep(1);
+
+        DYNAMIC_BEGIN("example03_kernel")
+        printf("Nested kernel in iteration %d\n", i);
+        sleep(1);
+        DYNAMIC_END
+
+        DYNAMIC_END
+    }
+    DYNAMIC_END
+
+    return(0);
+}
@@ -0,0 +1,36 @@
+/*
+* compile: gcc example04.c -o example04 -DDYNAMIC_ANALYSIS -lpthread
+*/
+#include <unistd.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "rmeasure.h"
+
+#define THREADS 4
+
+static void* worker(void* arg)
+{
+    long id = (long)arg;
+
+    DYNAMIC_BEGIN("example04_worker")
+    printf("Worker %ld is running\n", id);
+    sleep(1 + id % 2);
+    DYNAMIC_END
+
+    return NULL;
+}
+
+int main(void)
+{
+    pthread_t threads[THREADS];
+    long i = 0;
+
+    DYNAMIC_BEGIN("example04_main")
+    for (i = 0; i < THREADS; i++)
+        pthread_create(&threads[i], NULL, worker, (void*)i);
+    for (i = 0; i < THREADS; i++)
+        pthread_join(threads[i], NULL);
+    DYNAMIC_END
+
+    return(0);
+}
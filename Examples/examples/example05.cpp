@@ -0,0 +1,22 @@
+/*
+* compile: g++ -std=c++0x example05.cpp -o example05 -DDYNAMIC_ANALYSIS -lpthread
+*/
+#include <unistd.h>
+#include <cstdio>
+#include "rmeasure.hpp"
+
+static void kernel(int i)
+{
+    RMEASURE_SCOPE("example05_kernel");
+    printf("Scoped kernel in iteration %d\n", i);
+    sleep(1);
+}
+
+int main()
+{
+    RMEASURE_SCOPE("example05_main");
+    for (int i = 0; i < 3; i++)
+        kernel(i);
+
+    return(0);
+}
@@ -6,19 +6,195 @@
 #define STATIC_END }
 #define DYNAMIC_BEGIN(NAME)
 #define DYNAMIC_END
+#define RMEASURE_SAMPLING(NAME, POLICY, PARAMETER)
 
 #endif // STATIC_ANALYSIS
 
 #ifdef DYNAMIC_ANALYSIS
 
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "rmeasure_ring.h"
 
 #define FIFO_FILE "../../RMeasureService/RMEASURE_FIFO"
 
-inline void callFifo(const char* msg, int isBegin)
+/* shm_open() name of the marker ring, it must match server.ringName of the service */
+#ifndef RING_NAME
+#define RING_NAME "/rmeasure_ring"
+#endif
+
+/*
+ * With the RMEASURE_SOCKET environment variable set to the marker socket of
+ * the service (server.socketName), the records of the process are sent
+ * through its own connection instead of the shared ring. The connection is
+ * a session of the service, so the processes of different jobs can be told
+ * apart. The state of the connection, or its descriptor:
+ */
+#define RMEASURE_SOCKET_UNKNOWN -2     /* not connected yet */
+#define RMEASURE_SOCKET_CONNECTING -3  /* another thread is connecting */
+
+/*
+ * The longest wait for the service to read a full marker socket. If it is
+ * exceeded, the socket is congested (the service is not listening), and the
+ * records are dropped without waiting until a packet gets through again.
+ */
+#define RMEASURE_SOCKET_TIMEOUT_MS 100
+
+/* Size of the table of the kernels used by the process, a power of two */
+#define RMEASURE_MAX_KERNELS 1024
+
+/* Maximum nesting depth of the sampled kernels, the deeper ones are always measured */
+#define RMEASURE_MAX_SAMPLED_DEPTH 64
+
+/*
+ * Sampling policies of the hot kernels. The invocations which are not
+ * measured are only counted, the measured ones carry the number of the
+ * invocations they represent (weight), so the totals can be extrapolated.
+ */
+enum RMeasureSamplingPolicy {
+    RMEASURE_SAMPLE_ALL = 0,        /* measure every invocation (default) */
+    RMEASURE_SAMPLE_EVERY = 1,      /* measure 1 of every parameter invocations */
+    RMEASURE_SAMPLE_PERIOD = 2,     /* measure at most 1 invocation per parameter nanoseconds */
+    RMEASURE_SAMPLE_RESERVOIR = 3   /* measure the n-th invocation with probability parameter/n */
+};
+
+/*
+ * A kernel used by the process: its id (0 marks a free entry), its sampling
+ * policy and the state of the sampling.
+ */
+struct RMeasureKernel {
+    uint32_t id;
+    uint32_t policy;        /* one of RMeasureSamplingPolicy */
+    uint64_t parameter;     /* N, period (ns) or reservoir size of the policy */
+    uint64_t invocations;   /* number of the invocations */
+    uint64_t unsampled;     /* invocations not measured since the last measured one */
+    uint64_t lastSampled;   /* timestamp of the last measured invocation */
+};
+
+/*
+ * Batching of the markers, enabled by the RMEASURE_BATCH environment variable
+ * (the number of markers a thread collects, 0 or unset disables it). The
+ * batch of a thread is put into the marker ring with a single claim (or into
+ * packets of the marker socket) when it is full, when its oldest marker is older than RMEASURE_BATCH_PERIOD_MS
+ * milliseconds (default 100), at thread exit and at process exit.
+ * The batched markers reach the service late, so only their timestamps are
+ * used (Timer), see RMEASURE_RECORD_BATCHED. The FIFO is never batched.
+ */
+#define RMEASURE_DEFAULT_BATCH_PERIOD_MS 100
+
+/*
+ * The markers collected by a thread. The batches are never freed, the batch
+ * of an exited thread is taken over by a new thread.
+ */
+struct RMeasureBatch {
+    struct RMeasureBatch* next;     /* next batch of the process */
+    int lock;                       /* taken by the owner and the flusher thread */
+    int owned;                      /* non-zero while a thread uses the batch */
+    uint32_t count;
+    uint32_t capacity;
+    struct RMeasureRecord records[];
+};
+
+/*
+ * The markers are tagged with the process and thread of the producer,
+ * so the service can pair the markers of concurrent threads and processes.
+ * The ids are cached per thread, a forked child gets new ones.
+ */
+static __thread uint32_t producerPid = 0;
+static __thread uint32_t producerTid = 0;
+
+/*
+ * The state shared by every translation unit of the process (weak definitions):
+ * the kernels registered at the service, and the stack of the skipped (not
+ * sampled) kernels of each thread, one bit per nesting level.
+ */
+__attribute__((weak)) struct RMeasureKernel rmeasureKernels[RMEASURE_MAX_KERNELS];
+__attribute__((weak)) __thread uint64_t rmeasureSkipped;
+__attribute__((weak)) __thread uint32_t rmeasureDepth;
+__attribute__((weak)) __thread uint64_t rmeasureRandom;
+
+/* The batches of the process and of the thread, and the batch settings (size -1: not read yet). */
+__attribute__((weak)) struct RMeasureBatch* rmeasureBatches;
+__attribute__((weak)) __thread struct RMeasureBatch* rmeasureBatch;
+__attribute__((weak)) int rmeasureBatchSize = -1;
+__attribute__((weak)) uint64_t rmeasureBatchPeriod;
+__attribute__((weak)) pthread_key_t rmeasureBatchKey;
+__attribute__((weak)) pthread_once_t rmeasureBatchOnce = PTHREAD_ONCE_INIT;
+
+/* Specifies whether the markers carry the CPU times of their thread (-1: RMEASURE_CPU_TIMES not read yet). */
+__attribute__((weak)) int rmeasureCpuTimes = -1;
+
+/* The marker socket of the process, -1 if it is not used. */
+__attribute__((weak)) int rmeasureSocket = RMEASURE_SOCKET_UNKNOWN;
+__attribute__((weak)) int rmeasureSocketCongested;
+
+static inline void resetProducer(void)
+{
+    struct RMeasureBatch* batch;
+
+    producerPid = 0;
+    producerTid = 0;
+    /* the registrations belong to the parent process */
+    memset(rmeasureKernels, 0, sizeof rmeasureKernels);
+    /* the markers of the parent are not sent twice, the batches of the other threads are free */
+    for (batch = rmeasureBatches; batch; batch = batch->next) {
+        batch->count = 0;
+        batch->lock = 0;
+        batch->owned = (batch == rmeasureBatch);
+    }
+    /* the flusher thread is not inherited, it is started again */
+    rmeasureBatchOnce = PTHREAD_ONCE_INIT;
+    /* the child opens its own session */
+    if (rmeasureSocket >= 0)
+        close(rmeasureSocket);
+    rmeasureSocket = RMEASURE_SOCKET_UNKNOWN;
+    rmeasureSocketCongested = 0;
+}
+
+static inline void producerIds(uint32_t* pid, uint32_t* tid)
+{
+    if (producerTid == 0) {
+        static int atforkRegistered = 0;
+        if (!__atomic_exchange_n(&atforkRegistered, 1, __ATOMIC_ACQ_REL))
+            pthread_atfork(NULL, NULL, resetProducer);
+        producerPid = (uint32_t)getpid();
+        producerTid = (uint32_t)syscall(SYS_gettid);
+    }
+    *pid = producerPid;
+    *tid = producerTid;
+}
+
+/*
+ * The markers are stamped at the call site, so the service measures the
+ * kernel boundaries instead of the moment it receives the markers.
+ */
+static inline uint64_t markerTimestamp(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+/*
+ * Send a message through the pipe: "B:name" or "B#id" (begin), "E" (end)
+ * and "R:id:name" (register), tagged with the producer, the timestamp and
+ * the weight of a sampled begin marker.
+ */
+static inline void callFifo(const char* msg, uint64_t timestamp, double weight)
 {
     int result = access (FIFO_FILE, F_OK);
     if(result == 0) {
@@ -28,31 +204,559 @@ inline void callFifo(const char* msg, int isBegin)
             perror("fopen");
             exit(1);
         }
-        if (isBegin == 1) {
-            char rKernelName[strlen(msg)+5];
-            memset(rKernelName, 0, sizeof rKernelName);
-            strcat(rKernelName,"B:\0");
-            strcat(rKernelName, msg);
-            strcat(rKernelName, ";\0");
-            fputs(rKernelName, fp);
+        /* one message is shorter than PIPE_BUF, so it is written atomically at fclose() */
+        uint32_t pid, tid;
+        producerIds(&pid, &tid);
+        if (weight != 1.0)
+            fprintf(fp, "%u.%u@%llu*%.17g/%s;", pid, tid, (unsigned long long)timestamp, weight, msg);
+        else
+            fprintf(fp, "%u.%u@%llu/%s;", pid, tid, (unsigned long long)timestamp, msg);
+        fclose(fp);
+    }
+}
 
+/*
+ * Read the sampling policy of a kernel from the RMEASURE_SAMPLING environment
+ * variable, a comma separated list of name=policy:parameter items, e.g.
+ *     RMEASURE_SAMPLING="hot_kernel=every:100,tick=period:10ms,*=reservoir:1000"
+ * The period accepts the ns, us, ms and s suffixes (default is ns).
+ * The item of the name takes precedence over the "*" item.
+ */
+static inline void samplingFromEnvironment(const char* name, uint32_t* policy, uint64_t* parameter)
+{
+    const char* item = getenv("RMEASURE_SAMPLING");
+    int matched = 0;
+    size_t nameLength = strlen(name);
+
+    *policy = RMEASURE_SAMPLE_ALL;
+    *parameter = 0;
+    while (item && *item) {
+        const char* end = strchr(item, ',');
+        const char* equal = strchr(item, '=');
+        if (!end)
+            end = item + strlen(item);
+        if (equal && equal < end) {
+            size_t keyLength = (size_t)(equal - item);
+            int exact = (keyLength == nameLength && strncmp(item, name, keyLength) == 0);
+            if (exact || (!matched && keyLength == 1 && *item == '*')) {
+                const char* value = equal + 1;
+                const char* colon = strchr(value, ':');
+                char* unit = NULL;
+                if (colon && colon < end) {
+                    uint64_t number = strtoull(colon + 1, &unit, 10);
+                    if (unit && strncmp(unit, "us", 2) == 0)
+                        number *= 1000ull;
+                    else if (unit && strncmp(unit, "ms", 2) == 0)
+                        number *= 1000000ull;
+                    else if (unit && *unit == 's')
+                        number *= 1000000000ull;
+                    if (strncmp(value, "every:", 6) == 0)
+                        *policy = RMEASURE_SAMPLE_EVERY;
+                    else if (strncmp(value, "period:", 7) == 0)
+                        *policy = RMEASURE_SAMPLE_PERIOD;
+                    else if (strncmp(value, "reservoir:", 10) == 0)
+                        *policy = RMEASURE_SAMPLE_RESERVOIR;
+                    else
+                        *policy = RMEASURE_SAMPLE_ALL;
+                    *parameter = number;
+                }
+                else {
+                    *policy = RMEASURE_SAMPLE_ALL;
+                    *parameter = 0;
+                }
+                matched = exact;
+                if (exact)
+                    break;
+            }
+        }
+        item = *end ? end + 1 : end;
+    }
+}
+
+/*
+ * Map the marker ring of the service once per process.
+ * Returns NULL if the service has not created a ring, then the FIFO is used.
+ */
+static inline struct RMeasureRing* attachRing(void)
+{
+    static struct RMeasureRing* ring = NULL;
+    static int attached = 0;
+
+    if (__atomic_load_n(&attached, __ATOMIC_ACQUIRE))
+        return ring;
+
+    struct RMeasureRing* mapped = NULL;
+    int fd = shm_open(RING_NAME, O_RDWR, 0);
+    if (fd >= 0) {
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(struct RMeasureRing)) {
+            void* addr = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (addr != MAP_FAILED) {
+                mapped = (struct RMeasureRing*)addr;
+                if (__atomic_load_n(&mapped->magic, __ATOMIC_ACQUIRE) != RMEASURE_RING_MAGIC
+                        || mapped->version != RMEASURE_RING_VERSION
+                        || st.st_size < (off_t)rmeasureRingSize(mapped->capacity)) {
+                    munmap(addr, st.st_size);
+                    mapped = NULL;
+                }
+            }
+        }
+        close(fd);
+    }
+    ring = mapped;
+    __atomic_store_n(&attached, 1, __ATOMIC_RELEASE);
+    return ring;
+}
+
+/*
+ * Connect to the marker socket once per process.
+ * Returns -1 if RMEASURE_SOCKET is not set or the service is not available.
+ */
+static inline int markerSocket(void)
+{
+    int fd = __atomic_load_n(&rmeasureSocket, __ATOMIC_ACQUIRE);
+
+    while (fd < -1) {
+        int expected = RMEASURE_SOCKET_UNKNOWN;
+        if (__atomic_compare_exchange_n(&rmeasureSocket, &expected, RMEASURE_SOCKET_CONNECTING, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            const char* path = getenv("RMEASURE_SOCKET");
+            struct sockaddr_un address;
+            fd = -1;
+            if (path && *path && strlen(path) < sizeof address.sun_path) {
+                memset(&address, 0, sizeof address);
+                address.sun_family = AF_UNIX;
+                strcpy(address.sun_path, path);
+                fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+                if (fd >= 0 && connect(fd, (struct sockaddr*)&address, sizeof address) != 0) {
+                    close(fd);
+                    fd = -1;
+                }
+                if (fd >= 0) {
+                    struct timeval timeout;
+                    timeout.tv_sec = RMEASURE_SOCKET_TIMEOUT_MS / 1000;
+                    timeout.tv_usec = (RMEASURE_SOCKET_TIMEOUT_MS % 1000) * 1000;
+                    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof timeout);
+                }
+            }
+            __atomic_store_n(&rmeasureSocket, fd, __ATOMIC_RELEASE);
+            return fd;
+        }
+        sched_yield();
+        fd = __atomic_load_n(&rmeasureSocket, __ATOMIC_ACQUIRE);
+    }
+    return fd;
+}
+
+/*
+ * Send a packet of records through the marker socket. The socket queues a
+ * few packets only (net.unix.max_dgram_qlen), so the sender waits for the
+ * service, unless the socket is congested.
+ */
+static inline int sendPacket(int fd, const struct RMeasureRecord* records, uint32_t count)
+{
+    const int congested = __atomic_load_n(&rmeasureSocketCongested, __ATOMIC_RELAXED);
+    if (send(fd, records, count * sizeof(struct RMeasureRecord), MSG_NOSIGNAL | (congested ? MSG_DONTWAIT : 0)) >= 0) {
+        if (congested)
+            __atomic_store_n(&rmeasureSocketCongested, 0, __ATOMIC_RELAXED);
+        return 0;
+    }
+    if (!congested && (errno == EAGAIN || errno == EWOULDBLOCK))
+        __atomic_store_n(&rmeasureSocketCongested, 1, __ATOMIC_RELAXED);
+    return -1;
+}
+
+/*
+ * Put records into the marker socket of the process, or into the ring if
+ * there is no socket. A congested socket drops them like a full ring does.
+ * Returns 0 on success, -1 if records were dropped or there is no transport.
+ */
+static inline int deliverRecords(struct RMeasureRing* ring, const struct RMeasureRecord* records, uint32_t count)
+{
+    const int fd = markerSocket();
+    int result = 0;
+
+    if (fd < 0 && !ring)
+        return -1;
+    while (count > 0) {
+        uint32_t chunk = count;
+        if (fd >= 0) {
+            if (chunk > RMEASURE_PACKET_RECORDS)
+                chunk = RMEASURE_PACKET_RECORDS;
+            if (sendPacket(fd, records, chunk) != 0)
+                result = -1;
         }
         else {
-            fputs(msg, fp);
+            if (chunk > ring->capacity)
+                chunk = ring->capacity;
+            if ((chunk == 1 ? rmeasureRingPush(ring, records) : rmeasureRingPushBatch(ring, records, chunk)) != 0)
+                result = -1;
         }
-        fclose(fp);
+        records += chunk;
+        count -= chunk;
+    }
+    return result;
+}
+
+/* RUSAGE_THREAD of Linux, <sys/resource.h> declares it with _GNU_SOURCE only */
+#define RMEASURE_RUSAGE_THREAD 1
+
+/*
+ * Fill the common part of a ring record, the name is copied only if it is given.
+ */
+static inline void fillRecord(struct RMeasureRecord* record, uint32_t type, uint32_t kernel, const char* name)
+{
+    record->type = type;
+    record->kernel = kernel;
+    record->userTime = 0;
+    record->kernelTime = 0;
+    producerIds(&record->pid, &record->tid);
+    if (name) {
+        strncpy(record->name, name, RMEASURE_NAME_SIZE - 1);
+        record->name[RMEASURE_NAME_SIZE - 1] = '\0';
+    }
+    else {
+        record->name[0] = '\0';
+    }
+}
+
+/* Specifies whether the RMEASURE_CPU_TIMES environment variable is set to nonzero. */
+static inline int cpuTimesEnabled(void)
+{
+    int enabled = __atomic_load_n(&rmeasureCpuTimes, __ATOMIC_RELAXED);
+    if (enabled < 0) {
+        const char* value = getenv("RMEASURE_CPU_TIMES");
+        enabled = (value && atoi(value) != 0) ? 1 : 0;
+        __atomic_store_n(&rmeasureCpuTimes, enabled, __ATOMIC_RELAXED);
+    }
+    return enabled;
+}
+
+/*
+ * Add the user and kernel CPU times of the calling thread to a marker record,
+ * if RMEASURE_CPU_TIMES is set. They are read at the call site, so the service
+ * can measure the CPU times of the regions of each thread, the batched ones
+ * too; it costs a system call per marker.
+ */
+static inline void addCpuTimes(struct RMeasureRecord* record)
+{
+    struct rusage usage;
+    if (!cpuTimesEnabled() || getrusage(RMEASURE_RUSAGE_THREAD, &usage) != 0)
+        return;
+    record->userTime = (uint64_t)usage.ru_utime.tv_sec * 1000000000ull + (uint64_t)usage.ru_utime.tv_usec * 1000ull;
+    record->kernelTime = (uint64_t)usage.ru_stime.tv_sec * 1000000000ull + (uint64_t)usage.ru_stime.tv_usec * 1000ull;
+    record->type |= RMEASURE_RECORD_CPU_TIMES;
+}
+
+/*
+ * Find the kernel (id is rmeasureKernelId(name)) in the table of the process,
+ * and register it at the service at its first use. Returns NULL if the kernel
+ * could not be registered (the ring is full or the table is full), then the
+ * begin marker has to carry the name and the kernel is not sampled.
+ */
+static inline struct RMeasureKernel* registerKernel(struct RMeasureRing* ring, uint32_t id, const char* name)
+{
+    uint32_t i;
+
+    for (i = 0; i < RMEASURE_MAX_KERNELS; ++i) {
+        struct RMeasureKernel* entry = &rmeasureKernels[(id + i) & (RMEASURE_MAX_KERNELS - 1)];
+        uint32_t current = __atomic_load_n(&entry->id, __ATOMIC_ACQUIRE);
+        if (current == id)
+            return entry;
+        if (current != 0)
+            continue;
+
+        /*
+         * The registration is sent before the id is published in the table, so the
+         * markers of the other threads which find the id come after it.
+         * A concurrent registration of the same kernel is a harmless duplicate.
+         */
+        if (ring || markerSocket() >= 0) {
+            struct RMeasureRecord record;
+            record.timestamp = 0;
+            record.weight = 1.0;
+            fillRecord(&record, RMEASURE_REGISTER, id, name);
+            if (deliverRecords(ring, &record, 1) != 0)
+                return NULL;
+        }
+        else {
+            char msg[RMEASURE_NAME_SIZE + 16];
+            snprintf(msg, sizeof msg, "R:%u:%.*s", id, RMEASURE_NAME_SIZE - 1, name);
+            callFifo(msg, 0, 1.0);
+        }
+
+        uint32_t policy;
+        uint64_t parameter;
+        samplingFromEnvironment(name, &policy, &parameter);
+        __atomic_store_n(&entry->policy, policy, __ATOMIC_RELAXED);
+        __atomic_store_n(&entry->parameter, parameter, __ATOMIC_RELAXED);
+        if (__atomic_compare_exchange_n(&entry->id, &current, id, 0, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE) || current == id)
+            return entry;
+    }
+    return NULL;
+}
+
+/*
+ * Decide whether the invocation of the kernel is measured. Returns the number
+ * of the invocations it represents, or 0 if it is only counted.
+ */
+static inline double sampleKernel(struct RMeasureKernel* kernel, uint64_t timestamp)
+{
+    const uint32_t policy = __atomic_load_n(&kernel->policy, __ATOMIC_RELAXED);
+    const uint64_t parameter = __atomic_load_n(&kernel->parameter, __ATOMIC_RELAXED);
+    if (policy == RMEASURE_SAMPLE_ALL || parameter == 0)
+        return 1.0;
+
+    const uint64_t invocation = __atomic_fetch_add(&kernel->invocations, 1, __ATOMIC_RELAXED) + 1;
+    switch (policy) {
+        case RMEASURE_SAMPLE_EVERY :
+            if ((invocation - 1) % parameter == 0)
+                return (double)(__atomic_exchange_n(&kernel->unsampled, 0, __ATOMIC_RELAXED) + 1);
+            break;
+        case RMEASURE_SAMPLE_PERIOD : {
+            uint64_t last = __atomic_load_n(&kernel->lastSampled, __ATOMIC_RELAXED);
+            if ((last == 0 || timestamp - last >= parameter)
+                    && __atomic_compare_exchange_n(&kernel->lastSampled, &last, timestamp, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                return (double)(__atomic_exchange_n(&kernel->unsampled, 0, __ATOMIC_RELAXED) + 1);
+            break;
+        }
+        case RMEASURE_SAMPLE_RESERVOIR :
+            /* inclusion probability parameter/n, the weight is its inverse */
+            if (invocation <= parameter)
+                return 1.0;
+            if (rmeasureRandom == 0)
+                rmeasureRandom = (timestamp ^ ((uint64_t)producerTid << 32)) | 1;
+            rmeasureRandom ^= rmeasureRandom << 13;
+            rmeasureRandom ^= rmeasureRandom >> 7;
+            rmeasureRandom ^= rmeasureRandom << 17;
+            if (rmeasureRandom % invocation < parameter)
+                return (double)invocation / (double)parameter;
+            return 0.0;
+        default :
+            return 1.0;
+    }
+    __atomic_fetch_add(&kernel->unsampled, 1, __ATOMIC_RELAXED);
+    return 0.0;
+}
+
+/*
+ * Set the sampling policy of a kernel (see RMeasureSamplingPolicy), it
+ * overrides the RMEASURE_SAMPLING environment variable.
+ */
+static inline void setSampling(uint32_t id, const char* name, uint32_t policy, uint64_t parameter)
+{
+    struct RMeasureKernel* kernel = registerKernel(attachRing(), id, name);
+    if (kernel) {
+        __atomic_store_n(&kernel->parameter, parameter, __ATOMIC_RELAXED);
+        __atomic_store_n(&kernel->policy, policy, __ATOMIC_RELAXED);
+    }
+}
+
+static inline void lockBatch(struct RMeasureBatch* batch)
+{
+    while (__atomic_exchange_n(&batch->lock, 1, __ATOMIC_ACQUIRE))
+        sched_yield();
+}
+
+static inline void unlockBatch(struct RMeasureBatch* batch)
+{
+    __atomic_store_n(&batch->lock, 0, __ATOMIC_RELEASE);
+}
+
+/* Send the markers of a locked batch. */
+static inline void flushBatch(struct RMeasureRing* ring, struct RMeasureBatch* batch)
+{
+    deliverRecords(ring, batch->records, batch->count);
+    batch->count = 0;
+}
+
+/* Flush the batches of the process, the ones younger than the period are kept unless all is set. */
+static inline void flushBatches(int all)
+{
+    struct RMeasureRing* ring = attachRing();
+    const uint64_t now = markerTimestamp();
+    struct RMeasureBatch* batch = __atomic_load_n(&rmeasureBatches, __ATOMIC_ACQUIRE);
+
+    for (; batch; batch = batch->next) {
+        if (all)
+            lockBatch(batch);
+        else if (__atomic_exchange_n(&batch->lock, 1, __ATOMIC_ACQUIRE))
+            continue; /* the owner is busy with it */
+        if (batch->count > 0 && (all || now - batch->records[0].timestamp >= rmeasureBatchPeriod))
+            flushBatch(ring, batch);
+        unlockBatch(batch);
+    }
+}
+
+static inline void* batchFlusher(void* unused)
+{
+    struct timespec period;
+    (void)unused;
+    period.tv_sec = rmeasureBatchPeriod / 1000000000ull;
+    period.tv_nsec = rmeasureBatchPeriod % 1000000000ull;
+    for (;;) {
+        nanosleep(&period, NULL);
+        flushBatches(0);
+    }
+    return NULL;
+}
+
+static inline void flushBatchesAtExit(void)
+{
+    flushBatches(1);
+}
+
+/* Destructor of the batch of an exiting thread: send its markers and free it for a new thread. */
+static inline void releaseBatch(void* data)
+{
+    struct RMeasureBatch* batch = (struct RMeasureBatch*)data;
+    lockBatch(batch);
+    flushBatch(attachRing(), batch);
+    __atomic_store_n(&batch->owned, 0, __ATOMIC_RELEASE);
+    unlockBatch(batch);
+}
+
+static inline void startBatching(void)
+{
+    static int atexitRegistered = 0;
+    pthread_t flusher;
+
+    pthread_key_create(&rmeasureBatchKey, releaseBatch);
+    if (!__atomic_exchange_n(&atexitRegistered, 1, __ATOMIC_ACQ_REL))
+        atexit(flushBatchesAtExit);
+    if (pthread_create(&flusher, NULL, batchFlusher, NULL) == 0)
+        pthread_detach(flusher);
+}
+
+/* The number of markers per batch, 0 if batching is disabled. */
+static inline int batchSize(void)
+{
+    int size = __atomic_load_n(&rmeasureBatchSize, __ATOMIC_ACQUIRE);
+    if (size < 0) {
+        const char* value = getenv("RMEASURE_BATCH");
+        const char* period = getenv("RMEASURE_BATCH_PERIOD_MS");
+        long milliseconds = period ? strtol(period, NULL, 10) : 0;
+        size = value ? atoi(value) : 0;
+        if (size < 0)
+            size = 0;
+        if (milliseconds <= 0)
+            milliseconds = RMEASURE_DEFAULT_BATCH_PERIOD_MS;
+        rmeasureBatchPeriod = (uint64_t)milliseconds * 1000000ull;
+        __atomic_store_n(&rmeasureBatchSize, size, __ATOMIC_RELEASE);
+    }
+    return size;
+}
+
+/* The batch of the calling thread, or NULL if batching is disabled. */
+static inline struct RMeasureBatch* threadBatch(void)
+{
+    struct RMeasureBatch* batch = rmeasureBatch;
+    const int size = batch ? 0 : batchSize();
+
+    if (batch || size == 0)
+        return batch;
+
+    pthread_once(&rmeasureBatchOnce, startBatching);
+    for (batch = __atomic_load_n(&rmeasureBatches, __ATOMIC_ACQUIRE); batch; batch = batch->next) {
+        int owned = 0;
+        if (__atomic_compare_exchange_n(&batch->owned, &owned, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            break;
+    }
+    if (!batch) {
+        batch = (struct RMeasureBatch*)calloc(1, sizeof(struct RMeasureBatch) + (size_t)size * sizeof(struct RMeasureRecord));
+        if (!batch) {
+            /* markers are sent one by one */
+            __atomic_store_n(&rmeasureBatchSize, 0, __ATOMIC_RELEASE);
+            return NULL;
+        }
+        batch->capacity = (uint32_t)size;
+        batch->owned = 1;
+        batch->next = __atomic_load_n(&rmeasureBatches, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&rmeasureBatches, &batch->next, batch, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+            ;
+    }
+    pthread_setspecific(rmeasureBatchKey, batch);
+    rmeasureBatch = batch;
+    return batch;
+}
+
+/*
+ * Send a marker through the marker socket or the ring, or via the FIFO if neither is available.
+ * The id and the name are used by the begin markers only. The markers of the
+ * invocations which are not sampled are not sent.
+ * A full ring drops the marker (counted by the service) instead of reordering
+ * it with the FIFO. With RMEASURE_BATCH the markers of the ring are batched.
+ */
+static inline void sendMarker(uint32_t type, uint32_t id, const char* name)
+{
+    struct RMeasureRing* ring = attachRing();
+    struct RMeasureKernel* kernel = (type == RMEASURE_MARKER_BEGIN) ? registerKernel(ring, id, name) : NULL;
+    const uint64_t timestamp = markerTimestamp();
+    double weight = 1.0;
+
+    if (type == RMEASURE_MARKER_BEGIN) {
+        const uint32_t depth = rmeasureDepth++;
+        /* the deeper kernels are always measured with weight 1, they are not counted by the sampling */
+        if (depth < RMEASURE_MAX_SAMPLED_DEPTH) {
+            if (kernel)
+                weight = sampleKernel(kernel, timestamp);
+            if (weight == 0.0) {
+                rmeasureSkipped |= 1ull << depth;
+                return;
+            }
+            rmeasureSkipped &= ~(1ull << depth);
+        }
+    }
+    else if (type == RMEASURE_MARKER_END && rmeasureDepth > 0) {
+        const uint32_t depth = --rmeasureDepth;
+        if (depth < RMEASURE_MAX_SAMPLED_DEPTH && (rmeasureSkipped & (1ull << depth)))
+            return;
+    }
+
+    if (ring || markerSocket() >= 0) {
+        struct RMeasureBatch* batch = threadBatch();
+        if (batch) {
+            lockBatch(batch);
+            struct RMeasureRecord* record = &batch->records[batch->count++];
+            record->timestamp = timestamp;
+            record->weight = weight;
+            fillRecord(record, type | RMEASURE_RECORD_BATCHED, kernel ? kernel->id : 0, (type == RMEASURE_MARKER_BEGIN && !kernel) ? name : NULL);
+            addCpuTimes(record);
+            if (batch->count == batch->capacity || timestamp - batch->records[0].timestamp >= rmeasureBatchPeriod)
+                flushBatch(ring, batch);
+            unlockBatch(batch);
+            return;
+        }
+
+        struct RMeasureRecord record;
+        record.timestamp = timestamp;
+        record.weight = weight;
+        fillRecord(&record, type, kernel ? kernel->id : 0, (type == RMEASURE_MARKER_BEGIN && !kernel) ? name : NULL);
+        addCpuTimes(&record);
+        deliverRecords(ring, &record, 1);
+    }
+    else if (type == RMEASURE_MARKER_BEGIN) {
+        char msg[RMEASURE_NAME_SIZE + 16];
+        if (kernel)
+            snprintf(msg, sizeof msg, "B#%u", kernel->id);
+        else
+            snprintf(msg, sizeof msg, "B:%.*s", RMEASURE_NAME_SIZE - 1, name);
+        callFifo(msg, timestamp, weight);
+    }
+    else {
+        callFifo("E", timestamp, 1.0);
     }
 }
 
 #define STATIC_BEGIN
 #define STATIC_END
 
-#define DYNAMIC_BEGIN(NAME) callFifo(NAME, 1);
+#define DYNAMIC_BEGIN(NAME) sendMarker(RMEASURE_MARKER_BEGIN, rmeasureKernelId(NAME), NAME);
+
+#define DYNAMIC_END sendMarker(RMEASURE_MARKER_END, 0, NULL);
 
-#define DYNAMIC_END callFifo("E;", 0);
+/* Set the sampling policy of the kernel, e.g. RMEASURE_SAMPLING("hot_kernel", RMEASURE_SAMPLE_EVERY, 100) */
+#define RMEASURE_SAMPLING(NAME, POLICY, PARAMETER) setSampling(rmeasureKernelId(NAME), NAME, POLICY, PARAMETER);
 
 #endif // DYNAMIC_ANALYSIS
 
 #endif // RMEASURE_H_INCLUDED
-
-
@@ -0,0 +1,86 @@
+#ifndef RMEASURE_HPP_INCLUDED
+#define RMEASURE_HPP_INCLUDED
+
+/*
+ * C++ interface of the kernel markers (see rmeasure.h).
+ *
+ *     void compute()
+ *     {
+ *         RMEASURE_SCOPE("compute");
+ *         ...
+ *     } // the kernel ends when the guard goes out of scope
+ *
+ * The kernel id is hashed from the string literal at compile time, so a
+ * marker costs a timestamp and a push into the marker ring (plus a
+ * getrusage() call with RMEASURE_CPU_TIMES=1, see rmeasure.h). Without
+ * DYNAMIC_ANALYSIS the guard compiles to nothing.
+ */
+
+#include <stdint.h>
+#include <type_traits>
+
+#ifdef DYNAMIC_ANALYSIS
+#include "rmeasure.h"
+#endif
+
+namespace rmeasure {
+
+/** 32 bit FNV-1a hash of a string, the same as rmeasureKernelId() of rmeasure_ring.h computes. */
+constexpr uint32_t fnv1a(const char* name, uint32_t hash = 2166136261u)
+{
+    return *name ? fnv1a(name + 1, (hash ^ (unsigned char)*name) * 16777619u) : hash;
+}
+
+/** The kernel id of a name (never 0). */
+constexpr uint32_t kernelId(const char* name)
+{
+    return fnv1a(name) ? fnv1a(name) : 1;
+}
+
+#ifdef DYNAMIC_ANALYSIS
+
+/**
+ * Marks a kernel region from its construction to its destruction.
+ * The name must be the name the id was computed from. Each boundary reads
+ * the clock and pushes a marker, the CPU times of the thread are read only
+ * with RMEASURE_CPU_TIMES=1.
+ */
+class Scope {
+public:
+    Scope(uint32_t id, const char* name)
+    {
+        sendMarker(RMEASURE_MARKER_BEGIN, id, name);
+    }
+
+    ~Scope()
+    {
+        sendMarker(RMEASURE_MARKER_END, 0, NULL);
+    }
+
+    Scope(const Scope&) = delete;
+    void operator=(const Scope&) = delete;
+};
+
+#else
+
+class Scope {
+public:
+    Scope(uint32_t, const char*) {}
+};
+
+#endif // DYNAMIC_ANALYSIS
+
+} // namespace rmeasure
+
+#define RMEASURE_CONCAT_IMPL(A, B) A##B
+#define RMEASURE_CONCAT(A, B) RMEASURE_CONCAT_IMPL(A, B)
+
+#ifdef DYNAMIC_ANALYSIS
+/* NAME must be a string literal, its id is a compile-time constant */
+#define RMEASURE_SCOPE(NAME) \
+    ::rmeasure::Scope RMEASURE_CONCAT(rmeasureScope, __COUNTER__)(std::integral_constant<uint32_t, ::rmeasure::kernelId(NAME)>::value, NAME)
+#else
+#define RMEASURE_SCOPE(NAME)
+#endif
+
+#endif // RMEASURE_HPP_INCLUDED
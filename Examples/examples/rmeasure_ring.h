@@ -0,0 +1,303 @@
+#ifndef RMEASURE_RING_H_INCLUDED
+#define RMEASURE_RING_H_INCLUDED
+
+/*
+ * Shared-memory marker ring between the measured application (rmeasure.h)
+ * and the RMeasureService listener.
+ *
+ * The segment is created by the service with shm_open() and it contains a
+ * RMeasureRing header followed by a power-of-two number of slots. Producers
+ * claim slots without locks (bounded MPSC queue: a slot is free for position
+ * pos when its sequence equals pos, and it is published by storing pos + 1).
+ * The only consumer is the listener, which sleeps on the futex word of the
+ * header when the ring is empty.
+ *
+ * A producer which dies between claiming a slot and publishing it would stop
+ * the consumer at that slot forever, so the consumer skips a slot which stays
+ * claimed but unpublished for a timeout (rmeasureRingSkip()). The producers
+ * publish with a compare-and-swap, a late producer finds its slot skipped and
+ * counts its record as dropped. The timeout is far longer than copying a
+ * record, a producer stopped in the middle of the copy for that long could
+ * still overwrite the slot after the skip.
+ *
+ * The layout is shared by C producers and the C++ service, so only the GCC
+ * __atomic builtins are used here.
+ */
+
+#include <stdint.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#define RMEASURE_RING_MAGIC   0x524d5247u /* "RMRG" */
+#define RMEASURE_RING_VERSION 8
+#define RMEASURE_NAME_SIZE    48
+
+/*
+ * Or'ed to the type of the markers which were collected in a batch of the
+ * producer (see RMEASURE_BATCH in rmeasure.h). They arrive later than the
+ * kernel boundaries they mark, only their timestamps are meaningful.
+ */
+#define RMEASURE_RECORD_BATCHED 0x100u
+
+/*
+ * Or'ed to the type of the markers which carry the CPU times of their thread
+ * at the call site (userTime, kernelTime).
+ */
+#define RMEASURE_RECORD_CPU_TIMES 0x200u
+
+/* Types of the records travelling through the ring. */
+enum RMeasureRecordType {
+    RMEASURE_MARKER_BEGIN = 1,
+    RMEASURE_MARKER_END = 2,
+    RMEASURE_STOP_SCOPE = 3,
+    RMEASURE_STOP_RAPL = 4,
+    RMEASURE_STOP_TIMER = 5,
+    RMEASURE_REGISTER = 6
+};
+
+/*
+ * A kernel is registered once per process: the RMEASURE_REGISTER record maps
+ * the kernel id to the name, the begin markers carry the id only. A begin
+ * marker with kernel 0 carries the name itself (unregistered kernel).
+ */
+struct RMeasureRecord {
+    uint32_t type;                  /* one of RMeasureRecordType, possibly with RMEASURE_RECORD_BATCHED and RMEASURE_RECORD_CPU_TIMES */
+    uint32_t pid;                   /* process of the producer */
+    uint32_t tid;                   /* thread of the producer */
+    uint32_t kernel;                /* kernel id of a begin or register record, 0 if none */
+    uint64_t timestamp;             /* CLOCK_MONOTONIC (ns) at the call site, 0 if unknown */
+    double weight;                  /* number of invocations a sampled begin record represents, 1 if not sampled */
+    uint64_t userTime;              /* user CPU time of the producer thread (ns), with RMEASURE_RECORD_CPU_TIMES */
+    uint64_t kernelTime;            /* kernel CPU time of the producer thread (ns), with RMEASURE_RECORD_CPU_TIMES */
+    char name[RMEASURE_NAME_SIZE];  /* kernel name of a register or an unregistered begin record */
+};
+
+/*
+ * The kernel id of a name (32 bit FNV-1a, never 0). The ids are computed
+ * from the names, so every translation unit of a process agrees on them.
+ */
+static inline uint32_t rmeasureKernelId(const char* name)
+{
+    uint32_t hash = 2166136261u;
+    for (; *name; ++name) {
+        hash ^= (unsigned char)*name;
+        hash *= 16777619u;
+    }
+    return hash ? hash : 1;
+}
+
+/*
+ * The marker socket of the service (SOCK_SEQPACKET, see RMEASURE_SOCKET in
+ * rmeasure.h) carries the same records, at most RMEASURE_PACKET_RECORDS of
+ * them in a packet.
+ */
+#define RMEASURE_PACKET_RECORDS 64
+
+struct RMeasureSlot {
+    uint64_t sequence;
+    struct RMeasureRecord record;
+};
+
+struct RMeasureRing {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;  /* number of slots, power of two */
+    uint32_t waiting;   /* non-zero while the consumer sleeps on the futex */
+    uint32_t futex;     /* bumped by the producers to wake the consumer */
+    uint32_t reserved;
+    uint64_t dropped;   /* records rejected, because the ring was full or their slot was skipped */
+    uint64_t skipped;   /* slots skipped by the consumer, because they were claimed but not published */
+    uint64_t head __attribute__((aligned(64))); /* next position to claim */
+    uint64_t tail __attribute__((aligned(64))); /* next position to consume */
+    struct RMeasureSlot slots[] __attribute__((aligned(64)));
+};
+
+static inline size_t rmeasureRingSize(uint32_t capacity)
+{
+    return sizeof(struct RMeasureRing) + capacity * sizeof(struct RMeasureSlot);
+}
+
+/* Initialize a freshly mapped segment. Capacity must be a power of two. */
+static inline void rmeasureRingInit(struct RMeasureRing* ring, uint32_t capacity)
+{
+    uint32_t i;
+    ring->capacity = capacity;
+    ring->waiting = 0;
+    ring->futex = 0;
+    ring->reserved = 0;
+    ring->dropped = 0;
+    ring->skipped = 0;
+    ring->head = 0;
+    ring->tail = 0;
+    for (i = 0; i < capacity; ++i)
+        ring->slots[i].sequence = i;
+    ring->version = RMEASURE_RING_VERSION;
+    __atomic_store_n(&ring->magic, RMEASURE_RING_MAGIC, __ATOMIC_RELEASE);
+}
+
+/*
+ * Publish the record of a claimed slot. Returns 0 on success, -1 if the
+ * consumer has skipped the slot meanwhile (the record is counted as dropped).
+ */
+static inline int rmeasureRingPublish(struct RMeasureRing* ring, struct RMeasureSlot* slot, uint64_t pos)
+{
+    uint64_t claimed = pos;
+    if (__atomic_compare_exchange_n(&slot->sequence, &claimed, pos + 1, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        return 0;
+    __atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+    return -1;
+}
+
+/*
+ * Put a record into the ring and wake the consumer if it sleeps.
+ * Returns 0 on success, -1 if the ring is full or the slot was skipped (the
+ * record is counted as dropped).
+ */
+static inline int rmeasureRingPush(struct RMeasureRing* ring, const struct RMeasureRecord* record)
+{
+    const uint64_t mask = ring->capacity - 1;
+    struct RMeasureSlot* slot;
+    uint64_t pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+
+    for (;;) {
+        slot = &ring->slots[pos & mask];
+        int64_t diff = (int64_t)__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) - (int64_t)pos;
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&ring->head, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        }
+        else if (diff < 0) {
+            __atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+            return -1;
+        }
+        else {
+            pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+        }
+    }
+
+    slot->record = *record;
+    if (rmeasureRingPublish(ring, slot, pos) != 0)
+        return -1;
+
+    /* pairs with the fence in rmeasureRingPrepareWait() */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->waiting, __ATOMIC_RELAXED)) {
+        __atomic_fetch_add(&ring->futex, 1, __ATOMIC_RELEASE);
+        syscall(SYS_futex, &ring->futex, FUTEX_WAKE, 1, NULL, NULL, 0);
+    }
+    return 0;
+}
+
+/*
+ * Put count records into consecutive slots with a single claim, and wake the
+ * consumer once. The records must fit into the ring (count <= capacity).
+ * Returns 0 on success, -1 if the ring has no room for all of them (they are
+ * counted as dropped) or some of their slots were skipped.
+ */
+static inline int rmeasureRingPushBatch(struct RMeasureRing* ring, const struct RMeasureRecord* records, uint32_t count)
+{
+    const uint64_t mask = ring->capacity - 1;
+    uint64_t pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    uint32_t i;
+    int result = 0;
+
+    if (count == 0)
+        return 0;
+
+    for (;;) {
+        /* the consumer frees the slots in order, so the slots up to the last one are free if that one is */
+        struct RMeasureSlot* last = &ring->slots[(pos + count - 1) & mask];
+        int64_t diff = (int64_t)__atomic_load_n(&last->sequence, __ATOMIC_ACQUIRE) - (int64_t)(pos + count - 1);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&ring->head, &pos, pos + count, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        }
+        else if (diff < 0) {
+            __atomic_fetch_add(&ring->dropped, count, __ATOMIC_RELAXED);
+            return -1;
+        }
+        else {
+            pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+        }
+    }
+
+    for (i = 0; i < count; ++i) {
+        struct RMeasureSlot* slot = &ring->slots[(pos + i) & mask];
+        slot->record = records[i];
+        if (rmeasureRingPublish(ring, slot, pos + i) != 0)
+            result = -1;
+    }
+
+    /* pairs with the fence in rmeasureRingPrepareWait() */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->waiting, __ATOMIC_RELAXED)) {
+        __atomic_fetch_add(&ring->futex, 1, __ATOMIC_RELEASE);
+        syscall(SYS_futex, &ring->futex, FUTEX_WAKE, 1, NULL, NULL, 0);
+    }
+    return result;
+}
+
+/* Take the next record out of the ring (single consumer). Returns 0 on success, -1 if empty. */
+static inline int rmeasureRingPop(struct RMeasureRing* ring, struct RMeasureRecord* record)
+{
+    const uint64_t pos = ring->tail;
+    struct RMeasureSlot* slot = &ring->slots[pos & (ring->capacity - 1)];
+
+    if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != pos + 1)
+        return -1;
+
+    *record = slot->record;
+    __atomic_store_n(&slot->sequence, pos + ring->capacity, __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->tail, pos + 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+/* Check whether a published record is waiting for the consumer. */
+static inline int rmeasureRingReady(struct RMeasureRing* ring)
+{
+    const uint64_t pos = ring->tail;
+    return __atomic_load_n(&ring->slots[pos & (ring->capacity - 1)].sequence, __ATOMIC_ACQUIRE) == pos + 1;
+}
+
+/*
+ * Check whether the slot of the next record is claimed by a producer, but not
+ * published yet. Returns the position of the slot + 1, 0 if it isn't stalled.
+ */
+static inline uint64_t rmeasureRingStalled(struct RMeasureRing* ring)
+{
+    const uint64_t pos = ring->tail;
+    if (__atomic_load_n(&ring->slots[pos & (ring->capacity - 1)].sequence, __ATOMIC_ACQUIRE) != pos)
+        return 0;
+    return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) > pos ? pos + 1 : 0;
+}
+
+/*
+ * Skip the claimed, unpublished slot of the next record (single consumer).
+ * Returns 0 if the slot was skipped, -1 if its producer published it meanwhile.
+ */
+static inline int rmeasureRingSkip(struct RMeasureRing* ring)
+{
+    const uint64_t pos = ring->tail;
+    struct RMeasureSlot* slot = &ring->slots[pos & (ring->capacity - 1)];
+    uint64_t claimed = pos;
+
+    if (!__atomic_compare_exchange_n(&slot->sequence, &claimed, pos + ring->capacity, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        return -1;
+    __atomic_fetch_add(&ring->skipped, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&ring->tail, pos + 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+/*
+ * Announce that the consumer is going to sleep. Returns the futex value
+ * to wait for; the caller must check rmeasureRingReady() afterwards.
+ */
+static inline uint32_t rmeasureRingPrepareWait(struct RMeasureRing* ring)
+{
+    __atomic_store_n(&ring->waiting, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    return __atomic_load_n(&ring->futex, __ATOMIC_ACQUIRE);
+}
+
+#endif // RMEASURE_RING_H_INCLUDED
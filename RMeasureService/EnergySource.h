@@ -0,0 +1,98 @@
+/*
+Copyright (c) 2014-2017 University of Szeged
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software without
+   specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef ENERGYSOURCE_H_INCLUDED
+#define ENERGYSOURCE_H_INCLUDED
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/**
+ * Namespace for the Rapl implementation
+ */
+namespace rapl {
+
+/**
+ * The RAPL domains of a socket. The package is always measured, the other
+ * domains if the processor has them (see EnergySource::domains()). PSys is
+ * the whole platform, it is counted on the first socket, its counter on the
+ * other sockets stays 0.
+ */
+enum Domain {
+    DOMAIN_PACKAGE,
+    DOMAIN_PP0,
+    DOMAIN_PP1,
+    DOMAIN_DRAM,
+    DOMAIN_PSYS,
+    DOMAIN_COUNT
+};
+
+/** The name of a domain in the results of the service ("package", "pp0", "pp1", "dram", "psys"). */
+const char* domainName(Domain domain);
+
+/**
+ * The energy counters of the RAPL domains of the measured sockets, read by
+ * RaplCounter. The counters are raw: they count in energyUnit() Joules, and
+ * they wrap around to 0 at counterRange().
+ */
+class EnergySource {
+public:
+    virtual ~EnergySource() {}
+
+    /** The name of the backend ("msr", "powercap", ...) for the log. */
+    virtual std::string name() const = 0;
+
+    /** The domains measured on every socket, the package first. */
+    virtual const std::vector<Domain>& domains() const = 0;
+
+    /** Joules per count of a domain (an index of domains()) of a socket. */
+    virtual double energyUnit(std::size_t socket, std::size_t domain) const = 0;
+
+    /** The counter of a domain of a socket wraps around to 0 at this value, 0 if it doesn't wrap. */
+    virtual uint64_t counterRange(std::size_t socket, std::size_t domain) const = 0;
+
+    /**
+     * Read the counters of the domains of a socket, in the order of domains().
+     * Different sockets may be read by different threads at the same time.
+     * Returns false if the counters couldn't be read, the reading is dropped.
+     */
+    virtual bool read(std::size_t socket, uint64_t* counters) = 0;
+
+    /**
+     * The highest power the package of a socket may draw (in Watts), it
+     * bounds how fast the counters wrap around. 0 if it is not known.
+     */
+    virtual double powerLimit(std::size_t socket) const { return 0.0; }
+};
+
+} // namespace rapl
+
+#endif // ENERGYSOURCE_H_INCLUDED
@@ -0,0 +1,115 @@
+/*
+Copyright (c) 2014-2017 University of Szeged
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software without
+   specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef MARKER_H_INCLUDED
+#define MARKER_H_INCLUDED
+
+#include <utility>
+#include <stdint.h> /* for uint32 definition */
+#include <time.h>   /* for clock_gettime */
+
+/**
+ * Namespace for the marker transports
+ */
+namespace marker {
+
+/**
+ * The process and thread (pid, tid) which sent a marker.
+ * Markers without these tags (old rmeasure.h) come from Producer(0, 0).
+ */
+typedef std::pair<uint32_t, uint32_t> Producer;
+
+/**
+ * The CLOCK_MONOTONIC time of a kernel boundary in nanoseconds. The markers
+ * are stamped by rmeasure.h at the call site, markers without a timestamp
+ * get the time they were received.
+ */
+typedef uint64_t Timestamp;
+
+/** The current CLOCK_MONOTONIC time in nanoseconds. */
+inline Timestamp now()
+{
+    timespec currentTime;
+    clock_gettime(CLOCK_MONOTONIC, &currentTime);
+    return (Timestamp)currentTime.tv_sec * 1000000000ull + (Timestamp)currentTime.tv_nsec;
+}
+
+/**
+ * The user and kernel CPU times of the producer thread at a marker (in
+ * nanosec), read by rmeasure.h at the call site.
+ */
+struct CpuTimes {
+    uint64_t userTime;
+    uint64_t kernelTime;
+};
+
+/**
+ * Information about a measured kernel invocation, in the order of the begin markers.
+ */
+struct Invocation {
+    int parent; ///< index of the enclosing invocation of the same producer (-1 if none)
+    Producer producer; ///< the producer of the markers
+    bool scopeMarked; ///< specifies whether this invocation raised the parallel port pin
+    uint64_t scopeBeginDelay; ///< time between the begin marker and raising the pin (in nanosec)
+    uint64_t scopeEndDelay; ///< time between the end marker and lowering the pin (in nanosec)
+    double weight; ///< number of the invocations this sampled invocation represents (1 if not sampled)
+    bool batched; ///< the markers arrived in a batch, only the timer measured the invocation
+    uint32_t session; ///< the socket session of the producer (0: marker ring or FIFO)
+};
+
+/**
+ * A connection of a measured process to the marker socket. The markers of
+ * the session are kept apart from the other sessions: their pid is the one
+ * of the peer in the pid namespace of the service (SO_PEERCRED).
+ */
+struct Session {
+    uint32_t id; ///< the id of the session, starting from 1
+    uint32_t pid; ///< the process of the peer
+    uint32_t uid; ///< the user of the peer
+    uint32_t gid; ///< the group of the peer
+    int fd; ///< the connection, -1 after the peer closed it
+    bool isStopped; ///< the peer sent a stop command, its later markers are not measured
+    bool isArchived; ///< the results of the session are stored apart from the listening
+};
+
+/**
+ * The cost of the current (or the last) listening of the service, from the
+ * start of the listener loop to the last stop command.
+ */
+struct ListenerStatistics {
+    uint64_t records; ///< the markers and registrations received (ring, socket and named pipe)
+    uint64_t dropped; ///< the markers dropped, because the marker ring was full or their slot was skipped
+    uint64_t skipped; ///< the slots of the marker ring skipped, because their producer didn't publish them
+    Timestamp elapsedTime; ///< wall-clock time of the listening (ns)
+    Timestamp cpuTime; ///< CPU time of the listener thread (ns)
+};
+
+} // namespace marker
+
+#endif // MARKER_H_INCLUDED
@@ -0,0 +1,222 @@
+/*
+Copyright (c) 2014-2017 University of Szeged
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software without
+   specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "MarkerRing.h"
+
+namespace marker {
+
+#define STALL_TIMEOUT_NS 1000000000ull ///< a slot claimed but not published for this long is skipped, its producer is assumed dead
+#define STALL_POLL_NS 10000000l ///< the notifier checks a stalled slot this often, the producers don't wake it for that
+
+MarkerRing::MarkerRing(const std::string& name, unsigned int capacity) :
+    m_name(name),
+    m_capacity(1),
+    m_size(0),
+    m_ring(NULL),
+    m_readyFd(-1),
+    m_drainedFd(-1),
+    m_notifying(false),
+    m_notifier(),
+    m_stalledSlot(0),
+    m_stallStart(0)
+{
+    // the slot index is masked, so round the capacity up to a power of two
+    while (m_capacity < capacity)
+        m_capacity <<= 1;
+    m_size = rmeasureRingSize(m_capacity);
+}
+
+MarkerRing::~MarkerRing()
+{
+    stopNotifier();
+    if (m_ring) {
+        munmap(m_ring, m_size);
+        shm_unlink(m_name.c_str());
+    }
+}
+
+bool MarkerRing::create()
+{
+    if (m_ring)
+        return true;
+
+    // remove the segment of a previous service instance, its layout may differ
+    shm_unlink(m_name.c_str());
+
+    int fd = shm_open(m_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0666);
+    if (fd < 0)
+        return false;
+
+    // the measured applications run as any user
+    fchmod(fd, 0666);
+    if (ftruncate(fd, m_size) != 0) {
+        close(fd);
+        shm_unlink(m_name.c_str());
+        return false;
+    }
+
+    void* addr = mmap(NULL, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        shm_unlink(m_name.c_str());
+        return false;
+    }
+
+    m_ring = static_cast<RMeasureRing*>(addr);
+    rmeasureRingInit(m_ring, m_capacity);
+    return true;
+}
+
+bool MarkerRing::push(const RMeasureRecord& record)
+{
+    return m_ring && rmeasureRingPush(m_ring, &record) == 0;
+}
+
+bool MarkerRing::pop(RMeasureRecord& record)
+{
+    if (!m_ring)
+        return false;
+    // without the notifier the listener polls the ring, it skips the stalled slots itself
+    while (rmeasureRingPop(m_ring, &record) != 0) {
+        if (m_notifying || !skipStalled())
+            return false;
+    }
+    return true;
+}
+
+bool MarkerRing::skipStalled()
+{
+    const uint64_t stalled = rmeasureRingStalled(m_ring);
+    if (stalled != m_stalledSlot) {
+        m_stalledSlot = stalled;
+        m_stallStart = now();
+        return false;
+    }
+    if (stalled == 0 || now() - m_stallStart < STALL_TIMEOUT_NS)
+        return false;
+    m_stalledSlot = 0;
+    return rmeasureRingSkip(m_ring) == 0;
+}
+
+bool MarkerRing::startNotifier()
+{
+    if (!m_ring)
+        return false;
+    if (m_notifying)
+        return true;
+
+    m_readyFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    m_drainedFd = eventfd(0, EFD_CLOEXEC);
+    if (m_readyFd < 0 || m_drainedFd < 0) {
+        stopNotifier();
+        return false;
+    }
+    m_notifying = true;
+    m_notifier = std::thread(&MarkerRing::notify, this);
+    return true;
+}
+
+void MarkerRing::stopNotifier()
+{
+    if (m_notifier.joinable()) {
+        m_notifying = false;
+        // wake the notifier wherever it sleeps
+        __atomic_fetch_add(&m_ring->futex, 1, __ATOMIC_RELEASE);
+        syscall(SYS_futex, &m_ring->futex, FUTEX_WAKE, 1, NULL, NULL, 0);
+        drained();
+        m_notifier.join();
+    }
+    if (m_readyFd >= 0)
+        close(m_readyFd);
+    if (m_drainedFd >= 0)
+        close(m_drainedFd);
+    m_readyFd = -1;
+    m_drainedFd = -1;
+}
+
+int MarkerRing::readyFd() const
+{
+    return m_readyFd;
+}
+
+void MarkerRing::drained()
+{
+    uint64_t one = 1;
+    if (m_drainedFd >= 0 && write(m_drainedFd, &one, sizeof one) < 0)
+        return;
+}
+
+void MarkerRing::notify()
+{
+    uint64_t value = 1;
+    while (m_notifying) {
+        if (!rmeasureRingReady(m_ring)) {
+            if (skipStalled())
+                continue;
+            uint32_t futexValue = rmeasureRingPrepareWait(m_ring);
+            if (!rmeasureRingReady(m_ring) && m_notifying) {
+                timespec stallPoll = { 0, STALL_POLL_NS };
+                syscall(SYS_futex, &m_ring->futex, FUTEX_WAIT, futexValue, m_stalledSlot ? &stallPoll : NULL, NULL, 0);
+            }
+            __atomic_store_n(&m_ring->waiting, 0, __ATOMIC_RELAXED);
+            continue;
+        }
+
+        // the listener empties the ring, meanwhile the producers don't need to wake anybody
+        value = 1;
+        if (write(m_readyFd, &value, sizeof value) < 0)
+            break;
+        if (read(m_drainedFd, &value, sizeof value) < 0)
+            break;
+    }
+}
+
+uint64_t MarkerRing::dropped() const
+{
+    return m_ring ? __atomic_load_n(&m_ring->dropped, __ATOMIC_RELAXED) : 0;
+}
+
+uint64_t MarkerRing::skipped() const
+{
+    return m_ring ? __atomic_load_n(&m_ring->skipped, __ATOMIC_RELAXED) : 0;
+}
+
+const std::string& MarkerRing::name() const
+{
+    return m_name;
+}
+
+} // namespace marker
@@ -0,0 +1,121 @@
+/*
+Copyright (c) 2014-2017 University of Szeged
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software without
+   specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef MARKERRING_H_INCLUDED
+#define MARKERRING_H_INCLUDED
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <stdint.h> /* for uint64 definition */
+
+#include "Marker.h"
+#include "rmeasure_ring.h"
+
+/**
+ * Namespace for the marker transports
+ */
+namespace marker {
+
+/**
+ * Service side of the shared-memory marker ring (see rmeasure_ring.h).
+ * The service owns the segment: it is created by create() and removed
+ * in the destructor.
+ *
+ * The producers wake the consumer with a futex, which can't be polled. A
+ * notifier thread sleeps on the futex instead of the listener, and signals
+ * readyFd() when records are waiting, so the ring is one of the descriptors
+ * of the event loop of the listener.
+ *
+ * A slot claimed by a producer which died before publishing it would stop
+ * the consumer, the notifier (or the listener, if the ring is polled) skips
+ * a slot which stays unpublished for a timeout and counts it.
+ */
+class MarkerRing {
+    std::string m_name; ///< shm_open() name of the segment
+    uint32_t m_capacity; ///< number of slots in the ring
+    size_t m_size; ///< size of the mapping in bytes
+    RMeasureRing* m_ring; ///< the mapped segment
+    int m_readyFd; ///< eventfd signalled by the notifier when records are waiting
+    int m_drainedFd; ///< eventfd signalled by the listener when it emptied the ring
+    std::atomic<bool> m_notifying; ///< cleared to stop the notifier
+    std::thread m_notifier;
+    uint64_t m_stalledSlot; ///< the stalled slot seen last (see rmeasureRingStalled()), 0 if none
+    Timestamp m_stallStart; ///< the time the slot was first seen stalled
+
+    void notify();
+    /** Skip the next slot if it has been stalled for the timeout. Returns true if it was skipped. */
+    bool skipStalled();
+
+public:
+    MarkerRing(const std::string& name, unsigned int capacity);
+    ~MarkerRing();
+
+    /**
+     * \brief Create and map the shared-memory segment.
+     * \return true if the ring is ready to use, false otherwise
+     */
+    bool create();
+
+    /** Put a record into the ring, return false if it is full. */
+    bool push(const RMeasureRecord& record);
+
+    /** Take the next record out of the ring, return false if it is empty. */
+    bool pop(RMeasureRecord& record);
+
+    /**
+     * \brief Start the notifier thread.
+     * \return true if readyFd() can be polled, false otherwise
+     */
+    bool startNotifier();
+
+    /** Stop the notifier thread. */
+    void stopNotifier();
+
+    /**
+     * Readable when records are waiting. The listener reads it, pops the
+     * records until the ring is empty, then calls drained().
+     */
+    int readyFd() const;
+
+    /** Let the notifier sleep again, the ring has been emptied. */
+    void drained();
+
+    /** The number of records rejected by the producers since create(). */
+    uint64_t dropped() const;
+
+    /** The number of the slots skipped since create(), because they were claimed but never published. */
+    uint64_t skipped() const;
+
+    const std::string& name() const;
+};
+
+} // namespace marker
+
+#endif // MARKERRING_H_INCLUDED
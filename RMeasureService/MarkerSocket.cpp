@@ -0,0 +1,129 @@
+/*
+Copyright (c) 2014-2017 University of Szeged
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software without
+   specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "MarkerSocket.h"
+
+namespace marker {
+
+MarkerSocket::MarkerSocket(const std::string& path) :
+    m_path(path),
+    m_fd(-1)
+{
+}
+
+MarkerSocket::~MarkerSocket()
+{
+    if (m_fd >= 0) {
+        close(m_fd);
+        unlink(m_path.c_str());
+    }
+}
+
+bool MarkerSocket::create()
+{
+    if (m_fd >= 0)
+        return true;
+
+    sockaddr_un address;
+    memset(&address, 0, sizeof address);
+    address.sun_family = AF_UNIX;
+    if (m_path.empty() || m_path.size() >= sizeof address.sun_path)
+        return false;
+    strncpy(address.sun_path, m_path.c_str(), sizeof address.sun_path - 1);
+
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return false;
+
+    // remove the socket of a previous service instance
+    unlink(m_path.c_str());
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof address) != 0
+            || listen(fd, SOMAXCONN) != 0) {
+        close(fd);
+        return false;
+    }
+
+    // the measured applications run as any user
+    chmod(m_path.c_str(), 0666);
+    m_fd = fd;
+    return true;
+}
+
+int MarkerSocket::fd() const
+{
+    return m_fd;
+}
+
+int MarkerSocket::accept(Session& session)
+{
+    int fd = accept4(m_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0)
+        return -1;
+
+    ucred credentials;
+    socklen_t length = sizeof credentials;
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) != 0) {
+        close(fd);
+        return -1;
+    }
+    session.pid = credentials.pid;
+    session.uid = credentials.uid;
+    session.gid = credentials.gid;
+    session.fd = fd;
+    return fd;
+}
+
+int MarkerSocket::receive(int fd, RMeasureRecord* records)
+{
+    for (;;) {
+        ssize_t length = recv(fd, records, RMEASURE_PACKET_RECORDS * sizeof(RMeasureRecord), 0);
+        if (length < 0)
+            return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? -1 : 0;
+        // the producers never send an empty packet, it means the end of the session
+        if (length == 0)
+            return 0;
+        // a packet shorter than a record is not from rmeasure.h, it is skipped
+        if ((std::size_t)length >= sizeof(RMeasureRecord))
+            return length / sizeof(RMeasureRecord);
+    }
+}
+
+const std::string& MarkerSocket::path() const
+{
+    return m_path;
+}
+
+} // namespace marker
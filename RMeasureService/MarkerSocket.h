@@ -0,0 +1,84 @@
+/*
+Copyright (c) 2014-2017 University of Szeged
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software without
+   specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef MARKERSOCKET_H_INCLUDED
+#define MARKERSOCKET_H_INCLUDED
+
+#include <string>
+
+#include "Marker.h"
+#include "rmeasure_ring.h"
+
+/**
+ * Namespace for the marker transports
+ */
+namespace marker {
+
+/**
+ * Service side of the unix domain marker socket. Every connection
+ * (SOCK_SEQPACKET) is a session of one measured process, its packets hold
+ * RMeasureRecords (see rmeasure_ring.h). The socket file is created by
+ * create() and removed in the destructor.
+ */
+class MarkerSocket {
+    std::string m_path; ///< file system path of the socket
+    int m_fd; ///< the listening socket
+
+public:
+    MarkerSocket(const std::string& path);
+    ~MarkerSocket();
+
+    /**
+     * \brief Create the listening socket.
+     * \return true if the socket is ready to use, false otherwise
+     */
+    bool create();
+
+    /** The listening socket, readable when a connection is waiting. */
+    int fd() const;
+
+    /**
+     * \brief Accept a waiting connection, and fill the credentials of the session.
+     * \return the non-blocking descriptor of the session, -1 if no connection is waiting
+     */
+    int accept(Session& session);
+
+    /**
+     * \brief Receive the next packet of a session into records (RMEASURE_PACKET_RECORDS long).
+     * \return the number of the records, 0 if the peer closed the session,
+     *         -1 if no packet is waiting
+     */
+    static int receive(int fd, RMeasureRecord* records);
+
+    const std::string& path() const;
+};
+
+} // namespace marker
+
+#endif // MARKERSOCKET_H_INCLUDED
@@ -0,0 +1,115 @@
+/*
+Copyright (c) 2014-2017 University of Szeged
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software without
+   specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "MsrDevice.h"
+
+namespace rapl {
+
+MsrDevice::MsrDevice(int core, const std::string& pathFormat) :
+    m_core(core),
+    m_fd(-1),
+    m_offsetScale(1)
+{
+    std::string path = pathFormat;
+    const std::size_t corePosition = path.find("%d");
+    if (corePosition != std::string::npos)
+        path.replace(corePosition, 2, std::to_string(core));
+    const char* msr_filename = path.c_str();
+
+    m_fd = open(msr_filename, O_RDONLY | O_CLOEXEC);
+    if ( m_fd < 0 ) {
+        if ( errno == ENXIO ) {
+              fprintf(stderr, "rdmsr: No CPU %d\n", core);
+        } else if ( errno == EIO ) {
+              fprintf(stderr, "rdmsr: CPU %d doesn't support MSRs\n", core);
+        } else {
+              perror("rdmsr:open");
+              fprintf(stderr,"Trying to open %s\n",msr_filename);
+        }
+    }
+    struct stat status;
+    if (m_fd >= 0 && fstat(m_fd, &status) == 0 && S_ISREG(status.st_mode))
+        m_offsetScale = sizeof(uint64_t);
+}
+
+off_t MsrDevice::offset(uint32_t which) const
+{
+    return (off_t)which * m_offsetScale;
+}
+
+MsrDevice::~MsrDevice()
+{
+    if (m_fd >= 0)
+        close(m_fd);
+}
+
+int MsrDevice::core() const
+{
+    return m_core;
+}
+
+bool MsrDevice::isOpen() const
+{
+    return m_fd >= 0;
+}
+
+uint64_t MsrDevice::read(uint32_t which) const
+{
+    uint64_t data = 0;
+    read(&which, &data, 1);
+    return data;
+}
+
+bool MsrDevice::probe(uint32_t which, uint64_t& value) const
+{
+    value = 0;
+    return m_fd >= 0 && pread(m_fd, &value, sizeof value, offset(which)) == sizeof value;
+}
+
+void MsrDevice::read(const uint32_t* which, uint64_t* values, std::size_t count) const
+{
+    for (std::size_t i = 0; i < count; ++i) {
+        values[i] = 0;
+        if (m_fd < 0)
+            continue;
+        if ( pread(m_fd, &values[i], sizeof values[i], offset(which[i])) != sizeof values[i] ) {
+            perror("rdmsr:pread");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+} // namespace rapl
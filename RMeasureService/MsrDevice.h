@@ -0,0 +1,92 @@
+/*
+Copyright (c) 2014-2017 University of Szeged
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software without
+   specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef MSRDEVICE_H_INCLUDED
+#define MSRDEVICE_H_INCLUDED
+
+#include <cstddef>
+#include <string>
+#include <stdint.h>
+#include <sys/types.h>
+
+/**
+ * Namespace for the Rapl implementation
+ */
+namespace rapl {
+
+/**
+ * The model-specific registers of one core (/dev/cpu/N/msr of the msr
+ * driver). The device is opened once and kept open for the lifetime of the
+ * object, so reading a register is a single pread().
+ *
+ * A (sparse) regular file can stand in for the device, with the value of
+ * each register at 8 times its address as offset (the addresses of the
+ * device are offsets of 64 bit values, they are consecutive numbers).
+ */
+class MsrDevice {
+    int m_core;
+    int m_fd;
+    int m_offsetScale; ///< the offset of a register is its address times this, 8 for the regular files
+
+    /** The offset of a register in the device. */
+    off_t offset(uint32_t which) const;
+
+public:
+    /** The %d of the path format is replaced by the number of the core. */
+    MsrDevice(int core, const std::string& pathFormat = "/dev/cpu/%d/msr");
+    ~MsrDevice();
+    MsrDevice(const MsrDevice&) = delete;
+    void operator=(const MsrDevice&) = delete;
+
+    int core() const;
+    bool isOpen() const;
+
+    /**
+     * \brief Read a register.
+     * \return the value of the register, 0 if the device is not open
+     */
+    uint64_t read(uint32_t which) const;
+
+    /**
+     * \brief Read a register which the processor may not have.
+     * \return true if the register could be read, false otherwise
+     */
+    bool probe(uint32_t which, uint64_t& value) const;
+
+    /**
+     * Read several registers back to back, the values are stored in the
+     * order of the addresses. The msr driver has no vectored interface,
+     * but the reads of a batch are not interleaved with any other work.
+     */
+    void read(const uint32_t* which, uint64_t* values, std::size_t count) const;
+};
+
+} // namespace rapl
+
+#endif // MSRDEVICE_H_INCLUDED
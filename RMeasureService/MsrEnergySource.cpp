@@ -0,0 +1,273 @@
+/*
+Copyright (c) 2014-2017 University of Szeged
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software without
+   specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <algorithm>
+#include <cstring>
+#include <math.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+#include "MsrEnergySource.h"
+
+namespace rapl {
+
+/** The energy status register of each domain (in the order of Domain). */
+static const uint32_t ENERGY_STATUS_REGISTERS[DOMAIN_COUNT] = {
+    MSR_PKG_ENERGY_STATUS,
+    MSR_PP0_ENERGY_STATUS,
+    MSR_PP1_ENERGY_STATUS,
+    MSR_DRAM_ENERGY_STATUS,
+    MSR_PLATFORM_ENERGY_STATUS
+};
+
+/*
+ * The DRAM domain of the server processors counts in fixed 15.3 uJ units
+ * instead of the energy status unit of the power unit register.
+ */
+static bool hasFixedDramUnit()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return false;
+    const unsigned int family = (eax >> 8) & 0xf;
+    const unsigned int model = ((eax >> 4) & 0xf) | ((eax >> 12) & 0xf0);
+    if (family != 6)
+        return false;
+    switch (model) {
+        case 0x3f : // Haswell-EP
+        case 0x4f : // Broadwell-EP
+        case 0x56 : // Broadwell-DE
+        case 0x55 : // Skylake-SP, Cascade Lake
+        case 0x57 : // Knights Landing
+        case 0x85 : // Knights Mill
+        case 0x6a : // Ice Lake-SP
+        case 0x6c : // Ice Lake-D
+        case 0x8f : // Sapphire Rapids
+        case 0xcf : // Emerald Rapids
+            return true;
+        default :
+            return false;
+    }
+#else
+    return false;
+#endif
+}
+
+/*
+ * The register set of the vendor of the processor, the other vendors are
+ * expected to follow Intel. The AMD registers came with Zen (family 17h),
+ * the older AMD processors have no RAPL registers at all: their probe of the
+ * Intel unit register fails, so they have no domain.
+ */
+static MsrEnergySource::RegisterSet detectRegisterSet()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid(0, &eax, &ebx, &ecx, &edx)) {
+        char vendor[13];
+        memcpy(vendor, &ebx, 4);
+        memcpy(vendor + 4, &edx, 4);
+        memcpy(vendor + 8, &ecx, 4);
+        vendor[12] = '\0';
+        if ((strcmp(vendor, "AuthenticAMD") == 0 || strcmp(vendor, "HygonGenuine") == 0)
+                && __get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+            // the extended family is added to the base family 0xf
+            unsigned int family = (eax >> 8) & 0xf;
+            if (family == 0xf)
+                family += (eax >> 20) & 0xff;
+            if (family >= 0x17)
+                return MsrEnergySource::REGISTERS_AMD;
+        }
+    }
+#endif
+    return MsrEnergySource::REGISTERS_INTEL;
+}
+
+MsrEnergySource::MsrEnergySource(const std::vector<int>& cores, const std::string& pathFormat, const std::string& vendor) :
+    m_pathFormat(pathFormat),
+    m_registerSet(vendor == "amd" ? REGISTERS_AMD : (vendor == "intel" ? REGISTERS_INTEL : detectRegisterSet())),
+    m_socketCount(cores.size()),
+    m_devices(),
+    m_domains(),
+    m_registers(),
+    m_coreRegister(MSR_AMD_CORE_ENERGY_STATUS),
+    m_energyUnits(),
+    m_powerLimits()
+{
+    // the devices stay open and the units never change while the service runs
+    for (std::size_t i = 0; i < cores.size(); ++i)
+        m_devices.push_back(new MsrDevice(cores[i], m_pathFormat));
+    detectDomains();
+    readPowerLimits();
+}
+
+MsrEnergySource::~MsrEnergySource()
+{
+    for (std::size_t i = 0; i < m_devices.size(); ++i)
+        delete m_devices[i];
+}
+
+void MsrEnergySource::detectDomains()
+{
+    const bool fixedDramUnit = m_registerSet == REGISTERS_INTEL && hasFixedDramUnit();
+    const uint32_t powerUnitRegister = m_registerSet == REGISTERS_AMD ? MSR_AMD_RAPL_POWER_UNIT : MSR_RAPL_POWER_UNIT;
+    std::vector<double> energyUnits;
+    for (std::size_t i = 0; i < m_devices.size(); ++i) {
+        // a processor without the registers (or a missing msr driver) has no domain, like the other sources
+        uint64_t powerUnit = 0;
+        if (!m_devices[i]->probe(powerUnitRegister, powerUnit))
+            return;
+        energyUnits.push_back(pow(0.5, (double)((powerUnit >> 8) & 0x1f)));
+    }
+
+    // the energy unit register has the same layout on AMD, but there is no domain besides the package
+    if (m_registerSet == REGISTERS_AMD) {
+        m_domains.push_back(DOMAIN_PACKAGE);
+        m_registers.push_back(MSR_AMD_PKG_ENERGY_STATUS);
+        for (std::size_t i = 0; i < m_devices.size(); ++i)
+            m_energyUnits.push_back(std::vector<double>(1, energyUnits[i]));
+        return;
+    }
+
+    for (int domain = DOMAIN_PACKAGE; domain < DOMAIN_COUNT; ++domain) {
+        // a domain is measured if every socket has it, a counter which doesn't count is missing too
+        bool available = true;
+        for (std::size_t i = 0; available && i < m_devices.size() && domain != DOMAIN_PACKAGE; ++i) {
+            uint64_t value = 0;
+            available = m_devices[i]->probe(ENERGY_STATUS_REGISTERS[domain], value) && (uint32_t)value != 0;
+        }
+        if (!available)
+            continue;
+        m_domains.push_back((Domain)domain);
+        m_registers.push_back(ENERGY_STATUS_REGISTERS[domain]);
+    }
+
+    m_energyUnits.assign(m_devices.size(), std::vector<double>());
+    for (std::size_t i = 0; i < m_devices.size(); ++i) {
+        for (std::size_t j = 0; j < m_domains.size(); ++j)
+            m_energyUnits[i].push_back(m_domains[j] == DOMAIN_DRAM && fixedDramUnit ? 15.3e-6 : energyUnits[i]);
+    }
+}
+
+void MsrEnergySource::readPowerLimits()
+{
+    for (std::size_t i = 0; i < m_devices.size(); ++i) {
+        uint64_t value = 0;
+        double limit = 0.0;
+        // the AMD processors don't report their power limits in MSRs
+        if (m_registerSet == REGISTERS_INTEL && m_devices[i]->probe(MSR_RAPL_POWER_UNIT, value)) {
+            const double powerUnit = pow(0.5, (double)(value & 0xf));
+            // PL1 in bits 14:0, PL2 in bits 46:32, the thermal design power in bits 14:0 of the power info
+            if (m_devices[i]->probe(MSR_PKG_POWER_LIMIT, value))
+                limit = std::max((double)(value & 0x7fff), (double)((value >> 32) & 0x7fff)) * powerUnit;
+            if (m_devices[i]->probe(MSR_PKG_POWER_INFO, value))
+                limit = std::max(limit, (double)(value & 0x7fff) * powerUnit);
+        }
+        m_powerLimits.push_back(limit);
+    }
+}
+
+std::string MsrEnergySource::name() const
+{
+    return "msr";
+}
+
+const std::vector<Domain>& MsrEnergySource::domains() const
+{
+    return m_domains;
+}
+
+double MsrEnergySource::energyUnit(std::size_t socket, std::size_t domain) const
+{
+    return m_energyUnits[socket][domain];
+}
+
+uint64_t MsrEnergySource::counterRange(std::size_t socket, std::size_t domain) const
+{
+    // the energy status registers have 32 bits
+    return 1ull << 32;
+}
+
+double MsrEnergySource::powerLimit(std::size_t socket) const
+{
+    return m_powerLimits[socket];
+}
+
+MsrEnergySource::RegisterSet MsrEnergySource::registerSet() const
+{
+    return m_registerSet;
+}
+
+bool MsrEnergySource::addCores(const std::vector<int>& cores)
+{
+    if (m_registerSet != REGISTERS_AMD || m_domains.size() != 1)
+        return false;
+
+    std::vector<MsrDevice*> devices;
+    std::vector<uint64_t> powerUnits;
+    for (std::size_t i = 0; i < cores.size(); ++i) {
+        uint64_t value = 0;
+        devices.push_back(new MsrDevice(cores[i], m_pathFormat));
+        powerUnits.push_back(0);
+        if (!devices.back()->probe(m_coreRegister, value) || !devices.back()->probe(MSR_AMD_RAPL_POWER_UNIT, powerUnits.back())) {
+            for (std::size_t j = 0; j < devices.size(); ++j)
+                delete devices[j];
+            return false;
+        }
+    }
+    for (std::size_t i = 0; i < devices.size(); ++i) {
+        m_devices.push_back(devices[i]);
+        m_energyUnits.push_back(std::vector<double>(1, pow(0.5, (double)((powerUnits[i] >> 8) & 0x1f))));
+        // the power of a core is bounded by its package, it isn't known here
+        m_powerLimits.push_back(0.0);
+    }
+    return true;
+}
+
+bool MsrEnergySource::read(std::size_t socket, uint64_t* counters)
+{
+    // the components after the sockets are cores, their only counter is the core energy
+    if (socket >= m_socketCount) {
+        m_devices[socket]->read(&m_coreRegister, counters, 1);
+        counters[0] &= 0xffffffffull;
+        return true;
+    }
+    // the platform register (the last domain) is the same on every socket, it is counted on the first one
+    std::size_t count = m_registers.size();
+    if (socket > 0 && count > 0 && m_domains.back() == DOMAIN_PSYS)
+        counters[--count] = 0;
+    m_devices[socket]->read(m_registers.data(), counters, count);
+    for (std::size_t i = 0; i < count; ++i)
+        counters[i] &= 0xffffffffull;
+    return true;
+}
+
+} // namespace rapl
@@ -0,0 +1,120 @@
+/*
+Copyright (c) 2014-2017 University of Szeged
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software without
+   specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef MSRENERGYSOURCE_H_INCLUDED
+#define MSRENERGYSOURCE_H_INCLUDED
+
+#include "EnergySource.h"
+#include "MsrDevice.h"
+
+#define MSR_RAPL_POWER_UNIT     0x606
+/* Package RAPL Domain */
+#define MSR_PKG_POWER_LIMIT     0x610
+#define MSR_PKG_ENERGY_STATUS   0x611
+#define MSR_PKG_POWER_INFO      0x614
+/* PP0 RAPL Domain (cores) */
+#define MSR_PP0_ENERGY_STATUS   0x639
+/* PP1 RAPL Domain (uncore, graphics on client processors) */
+#define MSR_PP1_ENERGY_STATUS   0x641
+/* DRAM RAPL Domain */
+#define MSR_DRAM_ENERGY_STATUS  0x619
+/* PSys RAPL Domain (platform) */
+#define MSR_PLATFORM_ENERGY_STATUS  0x64D
+
+/* The RAPL registers of the AMD processors (family 17h and later) */
+#define MSR_AMD_RAPL_POWER_UNIT     0xC0010299
+#define MSR_AMD_CORE_ENERGY_STATUS  0xC001029A
+#define MSR_AMD_PKG_ENERGY_STATUS   0xC001029B
+
+namespace rapl {
+
+/**
+ * The RAPL energy status registers read through the msr driver, from one
+ * core of each socket. It needs root and the msr module.
+ *
+ * The register set follows the vendor of the processor: the AMD processors
+ * (from family 17h) have the package domain only, at other addresses, but
+ * they count the energy of each core too. The core counters can be read as
+ * additional components after the sockets (see addCores()), with the core
+ * energy as their package domain.
+ */
+class MsrEnergySource : public EnergySource {
+public:
+    /** The register sets, "auto" detects it from the vendor of the processor. */
+    enum RegisterSet {
+        REGISTERS_INTEL,
+        REGISTERS_AMD
+    };
+
+private:
+    std::string m_pathFormat; ///< the path of the MSR devices, see MsrDevice
+    RegisterSet m_registerSet;
+    std::size_t m_socketCount; ///< the devices of the sockets, the devices of the cores follow them
+    std::vector<MsrDevice*> m_devices; ///< the open MSR device of each socket and core
+    std::vector<Domain> m_domains;
+    std::vector<uint32_t> m_registers; ///< the energy status register of each measured domain, read by one batch
+    uint32_t m_coreRegister; ///< the energy status register of the cores
+    std::vector<std::vector<double> > m_energyUnits; ///< Joules per count of each measured domain of each socket, read at startup
+    std::vector<double> m_powerLimits; ///< the highest of the power limits and the TDP of each socket (in Watts)
+
+    /** Find the domains every socket has, and read their energy units. */
+    void detectDomains();
+    /** Read the package power limits (PL1, PL2) and the TDP of each socket. */
+    void readPowerLimits();
+
+public:
+    /**
+     * The cores are the first cores of the sockets. The vendor is "intel",
+     * "amd" or "auto".
+     */
+    MsrEnergySource(const std::vector<int>& cores, const std::string& pathFormat = "/dev/cpu/%d/msr", const std::string& vendor = "auto");
+    ~MsrEnergySource();
+    MsrEnergySource(const MsrEnergySource&) = delete;
+    void operator=(const MsrEnergySource&) = delete;
+
+    std::string name() const;
+    const std::vector<Domain>& domains() const;
+    double energyUnit(std::size_t socket, std::size_t domain) const;
+    uint64_t counterRange(std::size_t socket, std::size_t domain) const;
+    bool read(std::size_t socket, uint64_t* counters);
+    double powerLimit(std::size_t socket) const;
+
+    RegisterSet registerSet() const;
+
+    /**
+     * Read the energy of these cores too, as the components after the
+     * sockets. Returns false, and adds nothing, if the processor doesn't
+     * count the energy of its cores.
+     */
+    bool addCores(const std::vector<int>& cores);
+};
+
+} // namespace rapl
+
+#endif // MSRENERGYSOURCE_H_INCLUDED
@@ -0,0 +1,409 @@
+/*
+Copyright (c) 2014-2017 University of Szeged
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software without
+   specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "PerfCounter.h"
+
+namespace perf {
+
+static const char* const EVENT_NAMES[EVENT_COUNT] = { "cycles", "instructions", "llcMisses", "branchMisses" };
+
+/** Marks the regions of m_openKernels which are not measured (see PerfCounter::skip()). */
+static const std::size_t SKIPPED_REGION = (std::size_t)-1;
+
+const char* eventName(Event event)
+{
+    return event < EVENT_COUNT ? EVENT_NAMES[event] : "";
+}
+
+/* Open a counting event on a thread or a cpu, in the group of the leader (-1 for a new group). */
+static int openEvent(Event event, int pid, int cpu, int leader)
+{
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof attr);
+    attr.size = sizeof attr;
+    switch (event) {
+        case EVENT_CYCLES :
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case EVENT_INSTRUCTIONS :
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case EVENT_LLC_MISSES :
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        case EVENT_BRANCH_MISSES :
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+        default :
+            return -1;
+    }
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return syscall(__NR_perf_event_open, &attr, pid, cpu, leader, PERF_FLAG_FD_CLOEXEC);
+}
+
+MeasurementData::MeasurementData() :
+    m_start(),
+    m_runningRatio(0.0),
+    m_readDelay(0),
+    m_isMeasured(false)
+{
+    for (int i = 0; i < EVENT_COUNT; ++i)
+        m_counts[i] = 0.0;
+}
+
+void MeasurementData::begin(const Reading& reading, marker::Timestamp delay)
+{
+    m_start = reading;
+    m_readDelay = delay;
+}
+
+void MeasurementData::end(const Reading& reading, marker::Timestamp delay)
+{
+    // the same groups are read at both boundaries
+    if (reading.size() != m_start.size())
+        return;
+    m_readDelay = std::max(m_readDelay, delay);
+    m_runningRatio = 1.0;
+    for (std::size_t i = 0; i < reading.size(); ++i) {
+        const uint64_t enabled = reading[i].enabled - m_start[i].enabled;
+        const uint64_t running = reading[i].running - m_start[i].running;
+        if (enabled == 0)
+            continue;
+        // a group which was not scheduled during the region adds nothing, its ratio shows it
+        if (running > 0)
+            m_counts[reading[i].event] += (double)(reading[i].count - m_start[i].count) * enabled / running;
+        m_runningRatio = std::min(m_runningRatio, (double)running / enabled);
+    }
+    m_isMeasured = true;
+}
+
+const double& MeasurementData::count(Event event) const
+{
+    return m_counts[event];
+}
+
+const double& MeasurementData::runningRatio() const
+{
+    return m_runningRatio;
+}
+
+const marker::Timestamp& MeasurementData::readDelay() const
+{
+    return m_readDelay;
+}
+
+const bool& MeasurementData::isMeasured() const
+{
+    return m_isMeasured;
+}
+
+PerfCounter::PerfCounter(const std::vector<std::vector<Event> >& groups, Target target,
+    const std::vector<std::string>& components, const std::vector<std::vector<int> >& cpus,
+    marker::Timestamp maxReadDelay) :
+    m_groups(groups),
+    m_events(),
+    m_target(target),
+    m_components(components),
+    m_cpus(cpus),
+    m_socketGroups(),
+    m_threadGroups(),
+    m_failedThreads(0),
+    m_maxReadDelay(maxReadDelay),
+    m_delayedRegions(0),
+    m_kernelList(),
+    m_openKernels()
+{
+    // the counts of a repeated event would be summed
+    for (std::size_t i = 0; i < m_groups.size(); ++i) {
+        std::vector<Event> events;
+        for (std::size_t j = 0; j < m_groups[i].size(); ++j) {
+            if (std::find(m_events.begin(), m_events.end(), m_groups[i][j]) == m_events.end()) {
+                events.push_back(m_groups[i][j]);
+                m_events.push_back(m_groups[i][j]);
+            }
+        }
+        m_groups[i].swap(events);
+    }
+    m_groups.erase(std::remove_if(m_groups.begin(), m_groups.end(),
+        [](const std::vector<Event>& group) { return group.empty(); }), m_groups.end());
+}
+
+PerfCounter::~PerfCounter()
+{
+    stopMeasurement();
+}
+
+std::vector<PerfCounter::Group> PerfCounter::openGroups(int pid, int cpu) const
+{
+    std::vector<Group> groups(m_groups.size());
+    for (std::size_t i = 0; i < m_groups.size(); ++i) {
+        for (std::size_t j = 0; j < m_groups[i].size(); ++j) {
+            const int fd = openEvent(m_groups[i][j], pid, cpu, j == 0 ? -1 : groups[i].fds[0]);
+            if (fd < 0) {
+                closeGroups(groups);
+                return groups;
+            }
+            groups[i].events.push_back(m_groups[i][j]);
+            groups[i].fds.push_back(fd);
+        }
+        groups[i].buffer.resize(3 + groups[i].events.size());
+    }
+    return groups;
+}
+
+void PerfCounter::closeGroups(std::vector<Group>& groups)
+{
+    for (std::size_t i = 0; i < groups.size(); ++i) {
+        for (std::size_t j = 0; j < groups[i].fds.size(); ++j)
+            close(groups[i].fds[j]);
+    }
+    groups.clear();
+}
+
+bool PerfCounter::readGroups(Group* groups, std::size_t count, Reading& reading)
+{
+    // PERF_FORMAT_GROUP with the times: the number of the events, the enabled and the running time, then the values
+    for (std::size_t i = 0; i < count; ++i) {
+        Group& group = groups[i];
+        const ssize_t expected = group.buffer.size() * sizeof(uint64_t);
+        if (::read(group.fds[0], group.buffer.data(), expected) != expected)
+            return false;
+        for (std::size_t j = 0; j < group.events.size(); ++j) {
+            EventValue value;
+            value.event = group.events[j];
+            value.count = group.buffer[3 + j];
+            value.enabled = group.buffer[1];
+            value.running = group.buffer[2];
+            reading.push_back(value);
+        }
+    }
+    return true;
+}
+
+void PerfCounter::read(const marker::Producer& producer, std::vector<Reading>& readings, std::vector<bool>& isRead)
+{
+    readings.assign(m_components.size(), Reading());
+    isRead.assign(m_components.size(), false);
+    if (m_groups.empty())
+        return;
+    if (m_target == TARGET_SOCKET) {
+        for (std::size_t i = 0; i < m_socketGroups.size() && i < m_components.size(); ++i)
+            isRead[i] = readGroups(m_socketGroups[i].data(), m_socketGroups[i].size(), readings[i]);
+        return;
+    }
+
+    // the groups of a thread are opened at its first region, markers without a producer can't be measured
+    std::map<marker::Producer, std::vector<Group> >::iterator groupsIt = m_threadGroups.find(producer);
+    if (groupsIt == m_threadGroups.end()) {
+        // the descriptors of the exited threads are not kept while new threads come
+        closeExitedThreads();
+        std::vector<Group> groups;
+        if (producer.second != 0)
+            groups = openGroups(producer.second, -1);
+        if (groups.empty())
+            ++m_failedThreads;
+        groupsIt = m_threadGroups.insert(std::make_pair(producer, groups)).first;
+    }
+    if (!groupsIt->second.empty() && !m_components.empty())
+        isRead[0] = readGroups(groupsIt->second.data(), groupsIt->second.size(), readings[0]);
+}
+
+void PerfCounter::closeThread(std::map<marker::Producer, std::vector<Group> >::iterator groupsIt)
+{
+    // an end read from new groups would be compared to a begin read from the closed ones
+    std::map<marker::Producer, std::vector<std::size_t> >::iterator openIt = m_openKernels.find(groupsIt->first);
+    if (openIt != m_openKernels.end()) {
+        for (std::size_t i = 0; i < openIt->second.size(); ++i) {
+            if (openIt->second[i] != SKIPPED_REGION)
+                m_kernelList[openIt->second[i]].clear();
+        }
+        m_openKernels.erase(openIt);
+    }
+    closeGroups(groupsIt->second);
+    m_threadGroups.erase(groupsIt);
+}
+
+void PerfCounter::closeExitedThreads()
+{
+    std::map<marker::Producer, std::vector<Group> >::iterator groupsIt = m_threadGroups.begin();
+    while (groupsIt != m_threadGroups.end()) {
+        std::map<marker::Producer, std::vector<Group> >::iterator threadIt = groupsIt++;
+        if (syscall(SYS_tgkill, threadIt->first.first, threadIt->first.second, 0) != 0 && errno == ESRCH)
+            closeThread(threadIt);
+    }
+}
+
+void PerfCounter::closeProcess(uint32_t pid)
+{
+    std::map<marker::Producer, std::vector<Group> >::iterator groupsIt = m_threadGroups.lower_bound(marker::Producer(pid, 0));
+    while (groupsIt != m_threadGroups.end() && groupsIt->first.first == pid)
+        closeThread(groupsIt++);
+}
+
+const KernelList& PerfCounter::kernelList() const
+{
+    return m_kernelList;
+}
+
+const std::vector<std::string>& PerfCounter::components() const
+{
+    return m_components;
+}
+
+const std::vector<Event>& PerfCounter::events() const
+{
+    return m_events;
+}
+
+Target PerfCounter::target() const
+{
+    return m_target;
+}
+
+std::size_t PerfCounter::failedThreads() const
+{
+    return m_failedThreads;
+}
+
+std::size_t PerfCounter::delayedRegions() const
+{
+    return m_delayedRegions;
+}
+
+void PerfCounter::begin(const marker::Producer& producer, marker::Timestamp time)
+{
+    std::vector<Reading> readings;
+    std::vector<bool> isRead;
+    read(producer, readings, isRead);
+    const marker::Timestamp now = marker::now();
+    const marker::Timestamp delay = now > time ? now - time : 0;
+
+    MeasurementMap measurements;
+    for (std::size_t i = 0; i < m_components.size(); ++i) {
+        if (!isRead[i])
+            continue;
+        MeasurementData measurementData;
+        measurementData.begin(readings[i], delay);
+        measurements.insert(std::pair<std::string, MeasurementData>(m_components[i], measurementData));
+    }
+    m_openKernels[producer].push_back(m_kernelList.size());
+    m_kernelList.push_back(measurements);
+}
+
+void PerfCounter::skip(const marker::Producer& producer)
+{
+    m_openKernels[producer].push_back(SKIPPED_REGION);
+    m_kernelList.push_back(MeasurementMap());
+}
+
+void PerfCounter::end(const marker::Producer& producer, marker::Timestamp time)
+{
+    std::vector<std::size_t>& openKernels = m_openKernels[producer];
+    if (openKernels.empty())
+        return;
+    const std::size_t kernel = openKernels.back();
+    openKernels.pop_back();
+    if (kernel == SKIPPED_REGION)
+        return;
+
+    std::vector<Reading> readings;
+    std::vector<bool> isRead;
+    read(producer, readings, isRead);
+    const marker::Timestamp now = marker::now();
+    const marker::Timestamp delay = now > time ? now - time : 0;
+
+    MeasurementMap& measurements = m_kernelList[kernel];
+    bool isDelayed = false;
+    for (std::size_t i = 0; i < m_components.size(); ++i) {
+        MeasurementMap::iterator measurementIt = measurements.find(m_components[i]);
+        if (measurementIt == measurements.end())
+            continue;
+        if (isRead[i])
+            measurementIt->second.end(readings[i], delay);
+        // the counts of the producer after its markers would be added to the region
+        if (!isRead[i] || (m_maxReadDelay > 0 && measurementIt->second.readDelay() > m_maxReadDelay)) {
+            isDelayed = isDelayed || isRead[i];
+            measurements.erase(measurementIt);
+        }
+    }
+    if (isDelayed)
+        ++m_delayedRegions;
+}
+
+bool PerfCounter::startMeasurement()
+{
+    stopMeasurement();
+    m_kernelList.clear();
+    m_openKernels.clear();
+    m_failedThreads = 0;
+    m_delayedRegions = 0;
+    if (m_target != TARGET_SOCKET)
+        return true;
+    if (m_cpus.empty())
+        return false;
+
+    // the groups of every cpu of a socket follow each other in its list
+    m_socketGroups.assign(m_cpus.size(), std::vector<Group>());
+    for (std::size_t i = 0; i < m_cpus.size(); ++i) {
+        for (std::size_t j = 0; j < m_cpus[i].size(); ++j) {
+            std::vector<Group> groups = openGroups(-1, m_cpus[i][j]);
+            if (groups.empty()) {
+                stopMeasurement();
+                return false;
+            }
+            m_socketGroups[i].insert(m_socketGroups[i].end(), groups.begin(), groups.end());
+        }
+    }
+    return true;
+}
+
+void PerfCounter::stopMeasurement()
+{
+    for (std::size_t i = 0; i < m_socketGroups.size(); ++i)
+        closeGroups(m_socketGroups[i]);
+    m_socketGroups.clear();
+    std::map<marker::Producer, std::vector<Group> >::iterator groupsIt = m_threadGroups.begin();
+    for (; groupsIt != m_threadGroups.end(); ++groupsIt)
+        closeGroups(groupsIt->second);
+    m_threadGroups.clear();
+}
+
+} // namespace perf
@@ -0,0 +1,184 @@
+/*
+Copyright (c) 2014-2017 University of Szeged
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software without
+   specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef PERFCOUNTER_H_INCLUDED
+#define PERFCOUNTER_H_INCLUDED
+
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h> /* for uint64 definition */
+
+#include "Marker.h"
+
+/**
+ * Namespace for the hardware performance counter implementation
+ */
+namespace perf {
+
+/** The hardware events of the kernel regions. */
+enum Event {
+    EVENT_CYCLES,
+    EVENT_INSTRUCTIONS,
+    EVENT_LLC_MISSES, ///< the read misses of the last level cache
+    EVENT_BRANCH_MISSES,
+    EVENT_COUNT
+};
+
+/** The name of an event in the configuration and the results ("cycles", "instructions", "llcMisses", "branchMisses"). */
+const char* eventName(Event event);
+
+/** The measuring scope of the events. */
+enum Target {
+    TARGET_THREAD, ///< the producer thread of the markers, on every cpu
+    TARGET_SOCKET ///< every cpu of each socket, whatever runs on them
+};
+
+/** The count of an event in one group read, with the times the group was enabled and running (in nanosec). */
+struct EventValue {
+    Event event;
+    uint64_t count;
+    uint64_t enabled;
+    uint64_t running;
+};
+
+/**
+ * One reading of the event groups of a component, one value for each event
+ * of each group (of each cpu of a socket), in the same order at every read.
+ */
+typedef std::vector<EventValue> Reading;
+
+/**
+ * The counts of the events of one kernel region on one component. The
+ * groups are multiplexed if there are more events than hardware counters,
+ * the count of each group read (of each cpu) is scaled by the time the group
+ * was enabled per the time it was running during the region, then summed.
+ */
+class MeasurementData {
+    Reading m_start;
+    double m_counts[EVENT_COUNT];
+    double m_runningRatio; ///< the smallest running per enabled time of the group reads
+    marker::Timestamp m_readDelay; ///< the longer time from a marker to the read of its boundary (in nanosec)
+    bool m_isMeasured;
+
+public:
+    MeasurementData();
+    /** The delay is the time from the marker of the boundary to the reading. */
+    void begin(const Reading& reading, marker::Timestamp delay);
+    void end(const Reading& reading, marker::Timestamp delay);
+    const double& count(Event event) const;
+    const double& runningRatio() const;
+    const marker::Timestamp& readDelay() const;
+    /** Specifies whether both boundaries of the region were read. */
+    const bool& isMeasured() const;
+};
+
+typedef std::map<std::string, MeasurementData> MeasurementMap;
+typedef std::vector<MeasurementMap> KernelList;
+
+/**
+ * Reads hardware performance counters (perf_event_open) at the kernel
+ * boundaries. The events are opened in the configured groups, the events of
+ * a group are counted at the same time and read by one read() of their
+ * leader. The counters are read when the listener processes the markers,
+ * a little later than their timestamps: the counters of the producer run on
+ * meanwhile, so a region whose boundary was read later than the maximal read
+ * delay is rejected.
+ */
+class PerfCounter {
+    /** An opened event group, its events are in the order of their configuration. */
+    struct Group {
+        std::vector<Event> events;
+        std::vector<int> fds; ///< fds[0] is the leader
+        std::vector<uint64_t> buffer; ///< the read() of the leader: the number of the events, the enabled and the running time, the counts
+    };
+
+    std::vector<std::vector<Event> > m_groups; ///< the configured event groups, every event in one of them at most
+    std::vector<Event> m_events; ///< the measured events, in the order of the groups
+    Target m_target;
+    std::vector<std::string> m_components; ///< the platform (TARGET_THREAD) or the sockets (TARGET_SOCKET)
+    std::vector<std::vector<int> > m_cpus; ///< the cpus of each socket (TARGET_SOCKET)
+    std::vector<std::vector<Group> > m_socketGroups; ///< the groups opened on the cpus of each socket while measuring
+    std::map<marker::Producer, std::vector<Group> > m_threadGroups; ///< the groups opened on each producer thread, empty if they couldn't be opened
+    std::size_t m_failedThreads; ///< the number of the producer threads whose groups couldn't be opened
+    marker::Timestamp m_maxReadDelay; ///< the longest accepted time from a marker to its read (in nanosec), 0 accepts any
+    std::size_t m_delayedRegions; ///< the number of the regions rejected for their read delay
+    KernelList m_kernelList;
+    std::map<marker::Producer, std::vector<std::size_t> > m_openKernels; ///< stacks of the open regions of each producer (indices of m_kernelList)
+
+    /** Open the configured groups on a thread (pid, cpu -1) or on a cpu (pid -1), empty if any of them failed. */
+    std::vector<Group> openGroups(int pid, int cpu) const;
+    static void closeGroups(std::vector<Group>& groups);
+    /** Append the counts and the times of the groups to the reading. */
+    static bool readGroups(Group* groups, std::size_t count, Reading& reading);
+    /** Read the components measuring the regions of the producer, false for the ones which couldn't be read. */
+    void read(const marker::Producer& producer, std::vector<Reading>& readings, std::vector<bool>& isRead);
+    /** Close the groups of a producer thread, its open regions are not measured. */
+    void closeThread(std::map<marker::Producer, std::vector<Group> >::iterator groupsIt);
+    /** Close the groups of the producer threads which exited. */
+    void closeExitedThreads();
+
+public:
+    /**
+     * The groups are lists of events, the first event of a group is its
+     * leader. An event is measured in its first group only. With TARGET_THREAD the only component is the platform, with
+     * TARGET_SOCKET the components are the sockets (names and cpus).
+     */
+    PerfCounter(const std::vector<std::vector<Event> >& groups, Target target,
+        const std::vector<std::string>& components, const std::vector<std::vector<int> >& cpus,
+        marker::Timestamp maxReadDelay = 0);
+    ~PerfCounter();
+    PerfCounter(const PerfCounter&) = delete;
+    void operator=(const PerfCounter&) = delete;
+
+    const KernelList& kernelList() const;
+    const std::vector<std::string>& components() const;
+    const std::vector<Event>& events() const;
+    Target target() const;
+    std::size_t failedThreads() const;
+    std::size_t delayedRegions() const;
+
+    /** Open a new (possibly nested) kernel region of the producer, time is the timestamp of its marker. */
+    void begin(const marker::Producer& producer, marker::Timestamp time);
+    /** Open a kernel region which is not measured (batched markers), its measurements are empty. */
+    void skip(const marker::Producer& producer);
+    /** Close the innermost open kernel region of the producer, time is the timestamp of its marker. */
+    void end(const marker::Producer& producer, marker::Timestamp time);
+    /** Close the groups of the threads of a process, which ended (e.g. its session was closed). */
+    void closeProcess(uint32_t pid);
+
+    /** Clear the results and open the groups of the sockets, false if they couldn't be opened. */
+    bool startMeasurement();
+    /** Close every group, the results are kept until the next start. */
+    void stopMeasurement();
+};
+
+} // namespace perf
+
+#endif // PERFCOUNTER_H_INCLUDED
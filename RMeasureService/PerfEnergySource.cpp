@@ -0,0 +1,179 @@
+/*
+Copyright (c) 2014-2017 University of Szeged
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software without
+   specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "Log.h"
+#include "PerfEnergySource.h"
+#include "Topology.h"
+
+namespace rapl {
+
+/** The perf events of the domains, indexed by Domain. */
+static const char* const EVENT_NAMES[DOMAIN_COUNT] = {
+    "energy-pkg",
+    "energy-cores",
+    "energy-gpu",
+    "energy-ram",
+    "energy-psys"
+};
+
+/* Open a counting event of the power PMU on a cpu, in the group of the leader (-1 for a new group). */
+static int openEvent(uint32_t type, uint64_t config, int cpu, int leader)
+{
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof attr);
+    attr.size = sizeof attr;
+    attr.type = type;
+    attr.config = config;
+    attr.read_format = PERF_FORMAT_GROUP;
+    // the power PMU counts per package, it can only be opened system wide on a cpu
+    return syscall(__NR_perf_event_open, &attr, -1, cpu, leader, PERF_FLAG_FD_CLOEXEC);
+}
+
+PerfEnergySource::PerfEnergySource(const std::string& root, const std::vector<int>& cores, const std::string& logFile) :
+    m_root(root),
+    m_logFile(logFile),
+    m_domains(),
+    m_units(),
+    m_groups()
+{
+    const std::string type = readAttribute(m_root + "/type");
+    if (type.empty()) {
+        Log(m_logFile, "There is no perf power PMU at " + m_root);
+        return;
+    }
+
+    // the events of the PMU (e.g. event=0x02), a domain is measured if it can be opened on every socket
+    std::vector<uint64_t> configs;
+    for (int domain = DOMAIN_PACKAGE; domain < DOMAIN_COUNT; ++domain) {
+        const std::string eventPath = m_root + "/events/" + EVENT_NAMES[domain];
+        const std::string event = readAttribute(eventPath);
+        const std::string scale = readAttribute(eventPath + ".scale");
+        bool available = !cores.empty() && event.compare(0, 6, "event=") == 0 && !scale.empty();
+        const uint64_t config = available ? strtoull(event.c_str() + 6, NULL, 0) : 0;
+        for (std::size_t i = 0; available && i < cores.size(); ++i) {
+            const int fd = openEvent(atoi(type.c_str()), config, cores[i], -1);
+            available = fd >= 0;
+            if (available)
+                close(fd);
+        }
+        if (!available) {
+            if (domain == DOMAIN_PACKAGE) {
+                Log(m_logFile, std::string("Couldn't open the perf ") + EVENT_NAMES[domain] + " event of " + m_root);
+                return;
+            }
+            continue;
+        }
+        m_domains.push_back((Domain)domain);
+        m_units.push_back(strtod(scale.c_str(), NULL));
+        configs.push_back(config);
+    }
+
+    m_groups.assign(cores.size(), Group());
+    for (std::size_t i = 0; i < cores.size(); ++i) {
+        Group& group = m_groups[i];
+        group.leader = -1;
+        for (std::size_t j = 0; j < configs.size(); ++j) {
+            // the platform event counts the same energy on every socket, only the first one has it
+            if (i > 0 && m_domains[j] == DOMAIN_PSYS)
+                continue;
+            const int fd = openEvent(atoi(type.c_str()), configs[j], cores[i], group.leader);
+            if (fd < 0) {
+                Log(m_logFile, "Couldn't open the perf energy event group of cpu " + std::to_string(cores[i]));
+                closeGroups();
+                m_domains.clear();
+                m_units.clear();
+                return;
+            }
+            if (j == 0)
+                group.leader = fd;
+            group.fds.push_back(fd);
+        }
+    }
+}
+
+PerfEnergySource::~PerfEnergySource()
+{
+    closeGroups();
+}
+
+void PerfEnergySource::closeGroups()
+{
+    for (std::size_t i = 0; i < m_groups.size(); ++i) {
+        for (std::size_t j = 0; j < m_groups[i].fds.size(); ++j)
+            close(m_groups[i].fds[j]);
+    }
+    m_groups.clear();
+}
+
+std::string PerfEnergySource::name() const
+{
+    return "perf";
+}
+
+const std::vector<Domain>& PerfEnergySource::domains() const
+{
+    return m_domains;
+}
+
+double PerfEnergySource::energyUnit(std::size_t socket, std::size_t domain) const
+{
+    return m_units[domain];
+}
+
+uint64_t PerfEnergySource::counterRange(std::size_t socket, std::size_t domain) const
+{
+    // the kernel accumulates the 32 bit hardware counters
+    return 0;
+}
+
+bool PerfEnergySource::read(std::size_t socket, uint64_t* counters)
+{
+    if (m_groups.empty())
+        return false;
+
+    // PERF_FORMAT_GROUP: the number of the events, then their values in the order they were opened
+    // the sockets may be read by several threads at once, each read has its own buffer
+    uint64_t buffer[1 + DOMAIN_COUNT];
+    const std::size_t count = m_groups[socket].fds.size();
+    const ssize_t expected = (1 + count) * sizeof(uint64_t);
+    if (::read(m_groups[socket].leader, buffer, expected) != expected)
+        return false;
+    std::copy(buffer + 1, buffer + 1 + count, counters);
+    std::fill(counters + count, counters + m_domains.size(), 0);
+    return true;
+}
+
+} // namespace rapl
@@ -0,0 +1,81 @@
+/*
+Copyright (c) 2014-2017 University of Szeged
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software without
+   specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef PERFENERGYSOURCE_H_INCLUDED
+#define PERFENERGYSOURCE_H_INCLUDED
+
+#include "EnergySource.h"
+
+namespace rapl {
+
+/**
+ * The RAPL energy counters of the power PMU of perf_event
+ * (/sys/bus/event_source/devices/power), it needs CAP_PERFMON or
+ * kernel.perf_event_paranoid <= 0 instead of the msr module.
+ *
+ * The events of a socket (energy-pkg, energy-cores, energy-gpu, energy-ram,
+ * energy-psys) are opened on its first core as one group (energy-psys on
+ * the first socket only, it is the whole platform), the package event is
+ * the leader, so a single read() gives the counters of every domain of the
+ * socket at the same moment. The kernel accumulates the counters in 64 bits,
+ * they don't wrap; they count in the .scale of their event (Joules).
+ */
+class PerfEnergySource : public EnergySource {
+    /** The event group of a socket. */
+    struct Group {
+        int leader; ///< the fd of the package event, -1 if the group couldn't be opened
+        std::vector<int> fds; ///< the fds of the events in the order of m_domains (without the PSys event on the other sockets than the first), fds[0] is the leader
+    };
+
+    std::string m_root; ///< the directory of the power PMU
+    std::string m_logFile; ///< the log of the service
+    std::vector<Domain> m_domains;
+    std::vector<double> m_units; ///< the scale of the event of each measured domain
+    std::vector<Group> m_groups; ///< the event group of each socket
+
+    /** Close the events of every group. */
+    void closeGroups();
+
+public:
+    /** The cores are the first cores of the sockets, the events which can't be opened are logged to the log file. */
+    PerfEnergySource(const std::string& root, const std::vector<int>& cores, const std::string& logFile);
+    ~PerfEnergySource();
+    PerfEnergySource(const PerfEnergySource&) = delete;
+    void operator=(const PerfEnergySource&) = delete;
+
+    std::string name() const;
+    const std::vector<Domain>& domains() const;
+    double energyUnit(std::size_t socket, std::size_t domain) const;
+    uint64_t counterRange(std::size_t socket, std::size_t domain) const;
+    bool read(std::size_t socket, uint64_t* counters);
+};
+
+} // namespace rapl
+
+#endif // PERFENERGYSOURCE_H_INCLUDED
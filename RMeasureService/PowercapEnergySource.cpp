@@ -0,0 +1,234 @@
+/*
+Copyright (c) 2014-2017 University of Szeged
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software without
+   specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <algorithm>
+#include <cstdlib>
+#include <dirent.h>
+#include <fcntl.h>
+#include <map>
+#include <unistd.h>
+
+#include "Log.h"
+#include "PowercapEnergySource.h"
+#include "Topology.h"
+
+namespace rapl {
+
+/** The prefix of the RAPL zones, the sub-zones are named intel-rapl:N:M. */
+static const std::string ZONE_PREFIX = "intel-rapl:";
+
+/* The entries of a directory starting with the prefix, in the order of their names. */
+static std::vector<std::string> listDirectory(const std::string& path, const std::string& prefix)
+{
+    std::vector<std::string> entries;
+    DIR* directory = opendir(path.c_str());
+    if (!directory)
+        return entries;
+    while (dirent* entry = readdir(directory)) {
+        const std::string entryName = entry->d_name;
+        if (entryName.compare(0, prefix.size(), prefix) == 0)
+            entries.push_back(entryName);
+    }
+    closedir(directory);
+    std::sort(entries.begin(), entries.end());
+    return entries;
+}
+
+/* The domain of a sub-zone of a package, DOMAIN_COUNT if it is not measured. */
+static Domain subZoneDomain(const std::string& zoneName)
+{
+    if (zoneName == "core")
+        return DOMAIN_PP0;
+    if (zoneName == "uncore")
+        return DOMAIN_PP1;
+    if (zoneName == "dram")
+        return DOMAIN_DRAM;
+    return DOMAIN_COUNT;
+}
+
+PowercapEnergySource::PowercapEnergySource(const std::string& root, const std::vector<int>& cores, const std::string& logFile) :
+    m_root(root),
+    m_logFile(logFile),
+    m_domains(),
+    m_zones(),
+    m_powerLimits(cores.size(), 0.0)
+{
+    // the zone directories of the packages by their package id, and of the psys zone
+    std::map<int, std::string> packages;
+    std::vector<std::string> packageOrder;
+    std::string psys;
+    const std::vector<std::string> zones = listDirectory(m_root, ZONE_PREFIX);
+    for (std::size_t i = 0; i < zones.size(); ++i) {
+        if (zones[i].find(':', ZONE_PREFIX.size()) != std::string::npos)
+            continue;
+        const std::string path = m_root + "/" + zones[i];
+        const std::string zoneName = readAttribute(path + "/name");
+        if (zoneName.compare(0, 8, "package-") == 0) {
+            packages[atoi(zoneName.c_str() + 8)] = path;
+            packageOrder.push_back(path);
+        }
+        else if (zoneName == "psys") {
+            psys = path;
+        }
+    }
+
+    // the domain directories of each socket, a socket without a package zone has none
+    std::vector<std::vector<std::string> > domainPaths(cores.size(), std::vector<std::string>(DOMAIN_COUNT));
+    for (std::size_t i = 0; i < cores.size(); ++i) {
+        // the cpu topology is at the same place relative to the powercap directory as in /sys
+        const std::string packageId = readAttribute(m_root + "/../../devices/system/cpu/cpu" + std::to_string(cores[i]) + "/topology/physical_package_id");
+        std::map<int, std::string>::const_iterator packageIt = packageId.empty() ? packages.end() : packages.find(atoi(packageId.c_str()));
+        const std::string package = packageIt != packages.end() ? packageIt->second : (i < packageOrder.size() ? packageOrder[i] : "");
+        if (package.empty())
+            continue;
+
+        domainPaths[i][DOMAIN_PACKAGE] = package;
+        // the long and the short term limits of the package (constraint_0, constraint_1, ...)
+        for (int constraint = 0; ; ++constraint) {
+            const std::string limit = readAttribute(package + "/constraint_" + std::to_string(constraint) + "_power_limit_uw");
+            if (limit.empty())
+                break;
+            m_powerLimits[i] = std::max(m_powerLimits[i], strtoull(limit.c_str(), NULL, 10) * 1e-6);
+        }
+        const std::string packageZone = package.substr(package.rfind('/') + 1);
+        const std::vector<std::string> subZones = listDirectory(package, packageZone + ":");
+        for (std::size_t j = 0; j < subZones.size(); ++j) {
+            const std::string path = package + "/" + subZones[j];
+            const Domain domain = subZoneDomain(readAttribute(path + "/name"));
+            if (domain != DOMAIN_COUNT)
+                domainPaths[i][domain] = path;
+        }
+    }
+    if (!cores.empty())
+        domainPaths[0][DOMAIN_PSYS] = psys;
+
+    // a domain is measured if the counter of every socket can be read, the platform only has one counter
+    std::vector<std::vector<Zone> > domainZones(DOMAIN_COUNT);
+    for (int domain = DOMAIN_PACKAGE; domain < DOMAIN_COUNT; ++domain) {
+        bool available = !cores.empty();
+        for (std::size_t i = 0; available && i < cores.size(); ++i) {
+            Zone zone = { -1, 0 };
+            if (domain != DOMAIN_PSYS || i == 0)
+                available = !domainPaths[i][domain].empty() && openZone(domainPaths[i][domain], zone);
+            if (available)
+                domainZones[domain].push_back(zone);
+        }
+        if (!available) {
+            for (std::size_t i = 0; i < domainZones[domain].size(); ++i) {
+                if (domainZones[domain][i].fd >= 0)
+                    close(domainZones[domain][i].fd);
+            }
+            if (domain == DOMAIN_PACKAGE) {
+                Log(m_logFile, "Couldn't read the powercap package zones of " + m_root);
+                break;
+            }
+            continue;
+        }
+        m_domains.push_back((Domain)domain);
+    }
+
+    m_zones.assign(cores.size(), std::vector<Zone>());
+    for (std::size_t i = 0; i < m_domains.size(); ++i) {
+        for (std::size_t j = 0; j < cores.size(); ++j)
+            m_zones[j].push_back(domainZones[m_domains[i]][j]);
+    }
+}
+
+PowercapEnergySource::~PowercapEnergySource()
+{
+    for (std::size_t i = 0; i < m_zones.size(); ++i) {
+        for (std::size_t j = 0; j < m_zones[i].size(); ++j) {
+            if (m_zones[i][j].fd >= 0)
+                close(m_zones[i][j].fd);
+        }
+    }
+}
+
+bool PowercapEnergySource::openZone(const std::string& path, Zone& zone) const
+{
+    zone.fd = open((path + "/energy_uj").c_str(), O_RDONLY | O_CLOEXEC);
+    if (zone.fd < 0)
+        return false;
+
+    char buffer[32];
+    if (pread(zone.fd, buffer, sizeof buffer - 1, 0) <= 0) {
+        close(zone.fd);
+        return false;
+    }
+    const std::string range = readAttribute(path + "/max_energy_range_uj");
+    zone.range = range.empty() ? 0 : strtoull(range.c_str(), NULL, 10) + 1;
+    return true;
+}
+
+std::string PowercapEnergySource::name() const
+{
+    return "powercap";
+}
+
+const std::vector<Domain>& PowercapEnergySource::domains() const
+{
+    return m_domains;
+}
+
+double PowercapEnergySource::energyUnit(std::size_t socket, std::size_t domain) const
+{
+    // the counters are in uJ
+    return 1e-6;
+}
+
+uint64_t PowercapEnergySource::counterRange(std::size_t socket, std::size_t domain) const
+{
+    return m_zones[socket][domain].range;
+}
+
+double PowercapEnergySource::powerLimit(std::size_t socket) const
+{
+    return m_powerLimits[socket];
+}
+
+bool PowercapEnergySource::read(std::size_t socket, uint64_t* counters)
+{
+    const std::vector<Zone>& zones = m_zones[socket];
+    for (std::size_t i = 0; i < zones.size(); ++i) {
+        if (zones[i].fd < 0) {
+            counters[i] = 0;
+            continue;
+        }
+        // a sysfs attribute is generated again by every read from offset 0
+        char buffer[32];
+        const ssize_t length = pread(zones[i].fd, buffer, sizeof buffer - 1, 0);
+        if (length <= 0)
+            return false;
+        buffer[length] = '\0';
+        counters[i] = strtoull(buffer, NULL, 10);
+    }
+    return true;
+}
+
+} // namespace rapl
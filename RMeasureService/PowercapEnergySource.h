@@ -0,0 +1,81 @@
+/*
+Copyright (c) 2014-2017 University of Szeged
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software without
+   specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef POWERCAPENERGYSOURCE_H_INCLUDED
+#define POWERCAPENERGYSOURCE_H_INCLUDED
+
+#include "EnergySource.h"
+
+namespace rapl {
+
+/**
+ * The RAPL energy counters of the powercap framework of the kernel
+ * (/sys/class/powercap/intel-rapl:*), it needs neither root nor the msr
+ * module, only the read permission of the energy_uj files.
+ *
+ * The zones are discovered at startup: the package-N zones belong to the
+ * sockets (by the physical package of their first core, or in the order of
+ * the zones), their core, uncore and dram sub-zones are the PP0, PP1 and
+ * DRAM domains, and the psys zone is the PSys domain of the first socket. The
+ * counters are in uJ, and they wrap around at max_energy_range_uj.
+ */
+class PowercapEnergySource : public EnergySource {
+    /** The energy counter of a zone. */
+    struct Zone {
+        int fd; ///< the open energy_uj file, -1 for the PSys domain of the other sockets than the first
+        uint64_t range; ///< max_energy_range_uj + 1
+    };
+
+    std::string m_root; ///< the powercap directory, /sys/class/powercap by default
+    std::string m_logFile; ///< the log of the service
+    std::vector<Domain> m_domains;
+    std::vector<std::vector<Zone> > m_zones; ///< the zone of each measured domain of each socket
+    std::vector<double> m_powerLimits; ///< the highest power limit of the package zone of each socket (in Watts)
+
+    /** Open the counter of a zone directory. Returns false if it can't be read. */
+    bool openZone(const std::string& path, Zone& zone) const;
+
+public:
+    /** The cores are the first cores of the sockets, the zones which can't be read are logged to the log file. */
+    PowercapEnergySource(const std::string& root, const std::vector<int>& cores, const std::string& logFile);
+    ~PowercapEnergySource();
+    PowercapEnergySource(const PowercapEnergySource&) = delete;
+    void operator=(const PowercapEnergySource&) = delete;
+
+    std::string name() const;
+    const std::vector<Domain>& domains() const;
+    double energyUnit(std::size_t socket, std::size_t domain) const;
+    uint64_t counterRange(std::size_t socket, std::size_t domain) const;
+    bool read(std::size_t socket, uint64_t* counters);
+    double powerLimit(std::size_t socket) const;
+};
+
+} // namespace rapl
+
+#endif // POWERCAPENERGYSOURCE_H_INCLUDED
@@ -27,13 +27,22 @@ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
 SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
 #include <cstring>
+#include <fcntl.h>
 #include <libconfig.h++>
-#include <signal.h>
+#include <limits.h>
+#include <set>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/stat.h>
+#include <sys/timerfd.h>
 #include <thread>
 #include <unistd.h>
 #include <fstream>
+#include "Log.h"
 #include "RMeasureServer.h"
 
 using namespace libconfig;
@@ -42,51 +51,34 @@ using namespace libconfig;
 #include <sys/io.h>
 #endif
 
+#define LISTEN_EVENTS 8 ///< number of the event sources of the listener loop
+#define RING_TIMEOUT_MS 10 ///< period of polling the ring, if its notifier could not be started
+#define SESSION_RESULTS 256 ///< number of the session results kept, the oldest ones are dropped
+
+/**
+ * The event sources of the listener loop, the low half of epoll_event.data.u64
+ * (the high half is the descriptor of a session).
+ */
+enum ListenerEvent {
+    LISTEN_FIFO,
+    LISTEN_RING,
+    LISTEN_WAKE,
+    LISTEN_RAPL_TICK,
+    LISTEN_SOCKET,
+    LISTEN_SESSION
+};
+
 #ifdef RAPL
 using namespace rapl;
-bool needToCalculate = false;
-void alarmHandler(int sig) {
-    needToCalculate = true;
-    alarm(60);
-}
 #endif
 
 #ifdef TIMER
 using namespace timer;
 #endif
 
-void RMeasureServer::callFifo(const char* msg)
-{
-    int result = access (m_fifoName.c_str(), F_OK);
-    if(result == 0) {
-        FILE *fp;
-        fp = fopen(m_fifoName.c_str(), "w");
-        if (fp == NULL) {
-            perror("fopen");
-            exit(1);
-        }
-        fputs(msg, fp);
-
-        fclose(fp);
-    }
-}
-
-
-void Log (const std::string& logfile,const std::string& message) {
-    FILE *file = fopen(logfile.c_str(), "a+");
-
-    if (file){
-        time_t rawtime;
-        struct tm * timeinfo;
-        char buffer[80];
-        time (&rawtime);
-        timeinfo = localtime(&rawtime);
-
-        strftime(buffer,80,"%d/%b/%Y:%H:%M:%S",timeinfo);
-        fprintf(file, "[%s]    %s\n", buffer, message.c_str());
-        fclose(file);
-    }
-}
+#ifdef PERF
+using perf::PerfCounter;
+#endif
 
 RMeasureServer* RMeasureServer::s_instance = NULL;
 
@@ -104,23 +96,52 @@ void RMeasureServer::deleteInstance()
 }
 
 RMeasureServer::RMeasureServer() :
+    m_kernelNames(),
+    m_kernelIds(),
+    m_registeredKernels(),
     m_measuredKernels(),
+    m_invocations(),
+    m_openKernels(),
+    m_openCount(0),
+    m_scopeInvocation(0),
+    m_listenStart(0),
     m_isListeningEnabled(false),
+    m_wakeFd(-1),
+    m_commandMutex(),
+    m_commandDone(),
+    m_commands(),
     m_scopeListening(false),
     m_raplListening(false),
     m_timerListening(false),
+    m_perfListening(false),
 #ifdef RAPL
     m_raplCounter(NULL),
 #endif
 #ifdef TIMER
     m_timerCounter(NULL),
 #endif
+#ifdef PERF
+    m_perfCounter(NULL),
+#endif
 #ifdef SCOPE
     m_parallelPortAddress(0xf100),
 #endif
     m_portNumber(8081),
     m_logFile("default.log"),
     m_fifoName("RMEASURE_FIFO"),
+    m_ringName("/rmeasure_ring"),
+    m_ringSize(4096),
+    m_markerRing(NULL),
+    m_socketName("RMEASURE_SOCKET"),
+    m_markerSocket(NULL),
+    m_sessions(),
+    m_lastSession(0),
+    m_sessionResults(),
+    m_resultsMutex(),
+    m_listenerStatistics(),
+    m_listenCpuStart(0),
+    m_droppedStart(0),
+    m_skippedStart(0),
     m_keepaliveTimeout(0),
     m_keepaliveMaxConn(0),
     m_timeout(15),
@@ -142,134 +163,924 @@ RMeasureServer::~RMeasureServer()
         delete m_timerCounter;
 #endif
 
+#ifdef PERF
+    if (m_perfCounter)
+        delete m_perfCounter;
+#endif
+
+    if (m_markerRing)
+        delete m_markerRing;
+
+    for (std::size_t i = 0; i < m_sessions.size(); ++i) {
+        if (m_sessions[i].fd >= 0)
+            close(m_sessions[i].fd);
+    }
+    if (m_markerSocket)
+        delete m_markerSocket;
+
     if (m_abyssServer)
         delete m_abyssServer;
 }
 
 
-void RMeasureServer::listenMacros()
+/*
+ * The kernel names are stored once, the invocations refer to them by their ids.
+ */
+uint32_t RMeasureServer::internKernel(const std::string& kernelName)
 {
-    m_isListeningEnabled = true;
-    m_measuredKernels.clear();
-    umask(0);
-    /* Create the FIFO if it does not exist */
-    mknod(m_fifoName.c_str(), S_IFIFO|0666, 0);
+    std::map<std::string, uint32_t>::iterator idIt = m_kernelIds.find(kernelName);
+    if (idIt != m_kernelIds.end())
+        return idIt->second;
+
+    const uint32_t kernel = m_kernelNames.size();
+    {
+        std::lock_guard<std::mutex> lock(m_resultsMutex);
+        m_kernelNames.push_back(kernelName);
+    }
+    m_kernelIds.insert(std::pair<std::string, uint32_t>(kernelName, kernel));
+    return kernel;
+}
+
+/*
+ * The registrations are kept between the measurements, since a process registers its kernels only once.
+ */
+void RMeasureServer::registerKernel(uint32_t pid, uint32_t kernel, const std::string& kernelName)
+{
+    const uint32_t interned = internKernel(kernelName);
+    std::pair<std::map<std::pair<uint32_t, uint32_t>, uint32_t>::iterator, bool> inserted =
+        m_registeredKernels.insert(std::make_pair(std::make_pair(pid, kernel), interned));
+    if (!inserted.second && inserted.first->second != interned) {
+        // a new process with a reused pid, or two names with the same id
+        if (m_kernelNames[inserted.first->second] != kernelName)
+            Log(m_logFile, "Kernel id " + std::to_string(kernel) + " of process " + std::to_string(pid) + " is registered again as " + kernelName);
+        inserted.first->second = interned;
+    }
+}
+
+uint32_t RMeasureServer::registeredKernel(uint32_t pid, uint32_t kernel)
+{
+    std::map<std::pair<uint32_t, uint32_t>, uint32_t>::iterator kernelIt = m_registeredKernels.find(std::make_pair(pid, kernel));
+    if (kernelIt != m_registeredKernels.end())
+        return kernelIt->second;
+
+    // the registration was lost (e.g. the process started before the service)
+    return internKernel("unregistered:" + std::to_string(kernel));
+}
+
+void RMeasureServer::beginKernel(uint32_t kernel, const marker::Producer& producer, marker::Timestamp time, double weight, bool batched, uint32_t session, const marker::CpuTimes* cpuTimes)
+{
+    std::vector<std::size_t>& openKernels = m_openKernels[producer];
+
+    marker::Invocation invocation;
+    invocation.parent = openKernels.empty() ? -1 : (int)openKernels.back();
+    invocation.producer = producer;
+    invocation.scopeMarked = (!batched && m_openCount == 0);
+    invocation.scopeBeginDelay = 0;
+    invocation.scopeEndDelay = 0;
+    invocation.weight = weight > 0.0 ? weight : 1.0;
+    invocation.batched = batched;
+    invocation.session = session;
+
+    openKernels.push_back(m_measuredKernels.size());
+    {
+        std::lock_guard<std::mutex> lock(m_resultsMutex);
+        m_invocations.push_back(invocation);
+        m_measuredKernels.push_back(kernel);
+    }
+    if (!batched)
+        ++m_openCount;
 
     #ifdef RAPL
-    signal(SIGALRM, alarmHandler);
-    alarm(60);
+    if (m_raplListening) {
+        if (batched)
+            m_raplCounter->skip(producer, kernel);
+        else
+            m_raplCounter->begin(producer, kernel, time);
+    }
     #endif
 
-    std::string kernelName = "unknown";
-    bool isMeasuring = false;
-    Log(m_logFile, "Service started to listening via named pipe");
+    #ifdef SCOPE
+    // the scope sees one pin, it marks the periods when any region is open
+    if (m_scopeListening && !batched && m_openCount == 1) {
+        if(ioperm(m_parallelPortAddress,1,1))
+            Log(m_logFile, "Couldn't open parallel port");
+        else
+            outb(0x01,m_parallelPortAddress); //set pin1 lo
+        // the pin is late by the delivery of the marker, the client corrects the scope results with it
+        m_scopeInvocation = m_invocations.size() - 1;
+        const marker::Timestamp delay = marker::now() - time;
+        std::lock_guard<std::mutex> lock(m_resultsMutex);
+        m_invocations.back().scopeBeginDelay = delay;
+    }
+    #endif
+    #ifdef TIMER
+    if (m_timerListening) {
+        m_timerCounter->begin(producer, time, batched, cpuTimes);
+    }
+    #endif
+    #ifdef PERF
+    if (m_perfListening) {
+        if (batched)
+            m_perfCounter->skip(producer);
+        else
+            m_perfCounter->begin(producer, time);
+    }
+    #endif
+}
 
-    while (m_isListeningEnabled)
-    {
-        if (!m_raplListening && !m_scopeListening && !m_timerListening) {
-            break;
+void RMeasureServer::endKernel(const marker::Producer& producer, marker::Timestamp time, const marker::CpuTimes* cpuTimes)
+{
+    std::map<marker::Producer, std::vector<std::size_t> >::iterator openIt = m_openKernels.find(producer);
+    if (openIt == m_openKernels.end() || openIt->second.empty())
+        return;
+    const bool batched = m_invocations[openIt->second.back()].batched;
+    openIt->second.pop_back();
+    if (!batched)
+        --m_openCount;
+
+    #ifdef RAPL
+    if (m_raplListening) {
+        m_raplCounter->end(producer, time);
+    }
+    #endif
+
+    #ifdef SCOPE
+        if (m_scopeListening && !batched && m_openCount == 0) {
+            if(ioperm(m_parallelPortAddress,1,1))
+                Log(m_logFile, "Couldn't open parallel port");
+            else
+                outb(0x00,m_parallelPortAddress); //set pin1 lo
+            if (m_scopeInvocation < m_invocations.size()) {
+                const marker::Timestamp delay = marker::now() - time;
+                std::lock_guard<std::mutex> lock(m_resultsMutex);
+                m_invocations[m_scopeInvocation].scopeEndDelay = delay;
+            }
+        }
+    #endif
+
+    #ifdef TIMER
+        if (m_timerListening) {
+            m_timerCounter->end(producer, time, batched, cpuTimes);
+        }
+    #endif
+
+    #ifdef PERF
+        if (m_perfListening) {
+            m_perfCounter->end(producer, time);
+        }
+    #endif
+}
+
+/*
+ * Parse the "pid.tid", "pid.tid@timestamp" or "pid.tid@timestamp*weight" tag of a pipe message.
+ */
+static bool parseTag(const std::string& tag, marker::Producer& producer, marker::Timestamp& time, double& weight)
+{
+    const char* begin = tag.c_str();
+    char* end = NULL;
+    unsigned long pid = strtoul(begin, &end, 10);
+    if (end == begin || *end != '.')
+        return false;
+
+    begin = end + 1;
+    unsigned long tid = strtoul(begin, &end, 10);
+    if (end == begin || (*end != '\0' && *end != '@'))
+        return false;
+
+    if (*end == '@') {
+        begin = end + 1;
+        unsigned long long timestamp = strtoull(begin, &end, 10);
+        if (end == begin || (*end != '\0' && *end != '*'))
+            return false;
+        time = timestamp;
+
+        if (*end == '*') {
+            begin = end + 1;
+            double sampleWeight = strtod(begin, &end);
+            if (end == begin || *end != '\0')
+                return false;
+            weight = sampleWeight;
+        }
+    }
+
+    producer = marker::Producer(pid, tid);
+    return true;
+}
+
+/*
+ * A marker can't be later than its arrival, unknown timestamps get the arrival time.
+ */
+static marker::Timestamp markerTime(marker::Timestamp timestamp)
+{
+    const marker::Timestamp arrival = marker::now();
+    return (timestamp == 0 || timestamp > arrival) ? arrival : timestamp;
+}
+
+void RMeasureServer::processMessage(const std::string& message)
+{
+    // tagged markers look like "pid.tid@timestamp/B:name", "pid.tid@timestamp/B#id",
+    // "pid.tid@timestamp/E" and "pid.tid@timestamp/R:id:name"
+    marker::Producer producer(0, 0);
+    marker::Timestamp timestamp = 0;
+    double weight = 1.0;
+    std::string msg = message;
+    ++m_listenerStatistics.records;
+    std::size_t slash = message.find('/');
+    if (slash != std::string::npos && message.compare(0, 2, "B:") != 0
+            && parseTag(message.substr(0, slash), producer, timestamp, weight))
+        msg = message.substr(slash + 1);
+
+    if (msg.compare("E") == 0) {
+        endKernel(producer, markerTime(timestamp));
+    }
+    #ifdef SCOPE
+    else if (msg.compare("SS") == 0) {
+        scopeListening(false);
+    }
+    #endif
+
+    #ifdef RAPL
+    else if (msg.compare("SR") == 0) {
+        raplListening(false);
+    }
+    #endif
+
+    #ifdef TIMER
+    else if (msg.compare("ST") == 0) {
+        timerListening(false);
+    }
+    #endif
+    else if (msg.compare(0, 2, "B#") == 0) {
+        beginKernel(registeredKernel(producer.first, strtoul(msg.c_str() + 2, NULL, 10)), producer, markerTime(timestamp), weight);
+    }
+    else if (msg.compare(0, 2, "R:") == 0) {
+        char* name = NULL;
+        const unsigned long kernel = strtoul(msg.c_str() + 2, &name, 10);
+        if (*name == ':')
+            registerKernel(producer.first, kernel, std::string(name + 1));
+    }
+    else if (!msg.empty()) {
+        std::size_t pos = msg.find("B:");
+        if (pos != std::string::npos) {
+            beginKernel(internKernel(msg.substr(pos+2)), producer, markerTime(timestamp), weight);
         }
+    }
+}
 
+void RMeasureServer::processRecord(const RMeasureRecord& record, uint32_t session)
+{
+    const marker::Producer producer(record.pid, record.tid);
+    const bool batched = (record.type & RMEASURE_RECORD_BATCHED) != 0;
+    // the CPU times of the producer thread at the call site
+    marker::CpuTimes times;
+    times.userTime = record.userTime;
+    times.kernelTime = record.kernelTime;
+    const marker::CpuTimes* cpuTimes = (record.type & RMEASURE_RECORD_CPU_TIMES) != 0 ? &times : NULL;
+    ++m_listenerStatistics.records;
+    // a batch may hold markers from before the start, their regions belong to no measurement
+    if (batched && record.timestamp < m_listenStart)
+        return;
+    switch (record.type & ~(RMEASURE_RECORD_BATCHED | RMEASURE_RECORD_CPU_TIMES)) {
+        case RMEASURE_MARKER_BEGIN :
+            if (record.kernel != 0)
+                beginKernel(registeredKernel(record.pid, record.kernel), producer, markerTime(record.timestamp), record.weight, batched, session, cpuTimes);
+            else
+                beginKernel(internKernel(std::string(record.name, strnlen(record.name, RMEASURE_NAME_SIZE))), producer, markerTime(record.timestamp), record.weight, batched, session, cpuTimes);
+            break;
+        case RMEASURE_REGISTER :
+            registerKernel(record.pid, record.kernel, std::string(record.name, strnlen(record.name, RMEASURE_NAME_SIZE)));
+            break;
+        case RMEASURE_MARKER_END :
+            endKernel(producer, markerTime(record.timestamp), cpuTimes);
+            break;
+        #ifdef SCOPE
+        case RMEASURE_STOP_SCOPE :
+            stopSession(session, 'S');
+            break;
+        #endif
         #ifdef RAPL
-        if (needToCalculate && m_raplListening && isMeasuring) {
-            m_raplCounter->calculate();
-            needToCalculate = false;
-            Log(m_logFile, "calculate() is called to avoid counter overflow!");
+        case RMEASURE_STOP_RAPL :
+            stopSession(session, 'R');
+            break;
+        #endif
+        #ifdef TIMER
+        case RMEASURE_STOP_TIMER :
+            stopSession(session, 'T');
+            break;
+        #endif
+        default :
+            break;
+    }
+}
+
+void RMeasureServer::readFifo(int fd, std::string& pending)
+{
+    char buffer[PIPE_BUF];
+    ssize_t length;
+    while ((length = read(fd, buffer, sizeof buffer)) > 0)
+        pending.append(buffer, length);
+
+    // the messages are ';'-terminated, an incomplete one waits for the next read
+    std::size_t start = 0;
+    std::size_t end;
+    while ((end = pending.find(';', start)) != std::string::npos) {
+        processMessage(pending.substr(start, end - start));
+        start = end + 1;
+    }
+    pending.erase(0, start);
+}
+
+static void addListenerEvent(int epollFd, int fd, ListenerEvent source)
+{
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.u64 = ((uint64_t)(uint32_t)fd << 32) | source;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+}
+
+/* CPU time of the calling thread (ns). */
+static marker::Timestamp threadCpuTime()
+{
+    timespec cpuTime;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuTime);
+    return (marker::Timestamp)cpuTime.tv_sec * 1000000000ull + (marker::Timestamp)cpuTime.tv_nsec;
+}
+
+/* Consume the counter of an eventfd or a timerfd. */
+static void readCounter(int fd)
+{
+    uint64_t counter;
+    if (read(fd, &counter, sizeof counter) < 0)
+        return;
+}
+
+void RMeasureServer::drainRing()
+{
+    RMeasureRecord record;
+    while (m_markerRing->pop(record))
+        processRecord(record);
+}
+
+void RMeasureServer::acceptSessions(int epollFd)
+{
+    marker::Session session;
+    while (m_markerSocket->accept(session) >= 0) {
+        session.id = ++m_lastSession;
+        session.isStopped = false;
+        session.isArchived = false;
+        {
+            std::lock_guard<std::mutex> lock(m_resultsMutex);
+            m_sessions.push_back(session);
         }
-        if (!m_raplListening && needToCalculate) {
-            needToCalculate = false;
+        if (epollFd >= 0)
+            addListenerEvent(epollFd, session.fd, LISTEN_SESSION);
+        Log(m_logFile, "Session " + std::to_string(session.id) + " is opened by process " + std::to_string(session.pid)
+            + " (uid " + std::to_string(session.uid) + ")");
+    }
+}
+
+void RMeasureServer::readSession(marker::Session& session, bool registrationsOnly)
+{
+    RMeasureRecord records[RMEASURE_PACKET_RECORDS];
+    int count;
+    while ((count = marker::MarkerSocket::receive(session.fd, records)) > 0) {
+        for (int i = 0; i < count; ++i) {
+            if (registrationsOnly && records[i].type != RMEASURE_REGISTER)
+                continue;
+            // a stopped session only closes its open regions
+            if (session.isStopped && (records[i].type & ~(RMEASURE_RECORD_BATCHED | RMEASURE_RECORD_CPU_TIMES)) == RMEASURE_MARKER_BEGIN)
+                continue;
+            // the pid of the producer may be in another pid namespace
+            records[i].pid = session.pid;
+            processRecord(records[i], session.id);
+        }
+    }
+    if (count == 0) {
+        // closing the descriptor removes it from the listener loop too
+        close(session.fd);
+        {
+            std::lock_guard<std::mutex> lock(m_resultsMutex);
+            session.fd = -1;
         }
+        Log(m_logFile, "Session " + std::to_string(session.id) + " is closed");
+        #ifdef PERF
+        // the process ended, its threads are not measured any more
+        if (m_perfCounter)
+            m_perfCounter->closeProcess(session.pid);
         #endif
+        if (!registrationsOnly)
+            archiveSession(session);
+    }
+}
 
-        std::ifstream is(m_fifoName.c_str(), std::ifstream::in);     // open file
-        std::string msg;
+void RMeasureServer::readSessions()
+{
+    for (std::size_t i = 0; i < m_sessions.size(); ++i) {
+        if (m_sessions[i].fd >= 0)
+            readSession(m_sessions[i]);
+    }
+}
 
-        char c = is.get();
-        while (is.good()) {
-            if (c == ';') {
+/* The kernel ids of the invocations as packed little-endian 32 bit integers. */
+static xmlrpc_c::value kernelIdsData(const std::vector<uint32_t>& kernels)
+{
+    std::vector<unsigned char> idsData;
+    idsData.reserve(kernels.size() * 4);
+    std::vector<uint32_t>::const_iterator kernelIt = kernels.begin();
+    for (; kernelIt != kernels.end(); ++kernelIt) {
+        idsData.push_back(*kernelIt & 0xff);
+        idsData.push_back((*kernelIt >> 8) & 0xff);
+        idsData.push_back((*kernelIt >> 16) & 0xff);
+        idsData.push_back((*kernelIt >> 24) & 0xff);
+    }
+    return xmlrpc_c::value_bytes(idsData);
+}
 
-                if (msg.compare("E") == 0) {
-                    if (isMeasuring) {
+/* An invocation, parent is its index among the sent invocations. */
+static xmlrpc_c::value invocationData(const marker::Invocation& kernelInvocation, int parent)
+{
+    std::map<std::string, xmlrpc_c::value> invocation;
+    invocation.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("parent"), xmlrpc_c::value_int(parent)));
+    invocation.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("pid"), xmlrpc_c::value_int(kernelInvocation.producer.first)));
+    invocation.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("tid"), xmlrpc_c::value_int(kernelInvocation.producer.second)));
+    invocation.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("scopeMarked"), xmlrpc_c::value_boolean(kernelInvocation.scopeMarked)));
+    invocation.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("scopeBeginDelay"), xmlrpc_c::value_double((double)kernelInvocation.scopeBeginDelay/1e9)));
+    invocation.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("scopeEndDelay"), xmlrpc_c::value_double((double)kernelInvocation.scopeEndDelay/1e9)));
+    invocation.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("weight"), xmlrpc_c::value_double(kernelInvocation.weight)));
+    invocation.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("batched"), xmlrpc_c::value_boolean(kernelInvocation.batched)));
+    invocation.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("session"), xmlrpc_c::value_int(kernelInvocation.session)));
+    return xmlrpc_c::value_struct(invocation);
+}
 
-                        #ifdef RAPL
-                        if (m_raplListening) {
-                            m_raplCounter->calculate();
-                        }
-                        #endif
-
-                        #ifdef SCOPE
-                            if (m_scopeListening) {
-                                if(ioperm(m_parallelPortAddress,1,1))
-                                    Log(m_logFile, "Couldn't open parallel port");
-                                else
-                                    outb(0x00,m_parallelPortAddress); //set pin1 lo
-                            }
-                        #endif
-
-                        #ifdef TIMER
-                            if (m_timerListening) {
-                                m_timerCounter->calculate();
-                            }
-                        #endif
-                        isMeasuring = false;
-                    }
-                }
-                #ifdef SCOPE
-                else if (msg.compare("SS") == 0) {
-                    scopeListening(false);
-                }
-                #endif
+#ifdef RAPL
+/* The RAPL measurements of an invocation, by the processors. */
+static xmlrpc_c::value raplData(const RaplCounter* raplCounter, const MeasurementMap& measurements)
+{
+    std::map<std::string, xmlrpc_c::value> capsResult;
+    MeasurementMap::const_iterator measurementsIt = measurements.begin();
+    for (; measurementsIt != measurements.end(); ++measurementsIt) {
+        std::map<std::string, xmlrpc_c::value> measurementValues;
+        measurementValues.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("energy"), xmlrpc_c::value_double(measurementsIt->second.packageEnergy())));
+        measurementValues.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("elapsedTime"), xmlrpc_c::value_double((double)(measurementsIt->second.elapsedTime())/BILLION)));
+        measurementValues.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("readSkew"), xmlrpc_c::value_double((double)(measurementsIt->second.readSkew())/BILLION)));
+        measurementValues.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("alignWait"), xmlrpc_c::value_double((double)(measurementsIt->second.alignWait())/BILLION)));
+        // the other measured domains as "pp0Energy", "pp1Energy", "dramEnergy" and "psysEnergy"
+        for (std::size_t i = 0; i < raplCounter->domains().size(); ++i) {
+            const Domain domain = raplCounter->domains()[i];
+            if (domain != DOMAIN_PACKAGE)
+                measurementValues.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string(std::string(domainName(domain)) + "Energy"), xmlrpc_c::value_double(measurementsIt->second.energy(domain))));
+        }
+        // the package power during the kernel, if the sampler has intervals overlapping it
+        if (raplCounter->sampler()) {
+            const std::size_t socket = std::find(raplCounter->processors().begin(), raplCounter->processors().end(), measurementsIt->first) - raplCounter->processors().begin();
+            const PowerStatistics power = raplCounter->sampler()->statistics(socket, measurementsIt->second.startTime(), measurementsIt->second.startTime() + measurementsIt->second.elapsedTime());
+            if (power.samples > 0) {
+                measurementValues.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("minPower"), xmlrpc_c::value_double(power.minimum)));
+                measurementValues.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("maxPower"), xmlrpc_c::value_double(power.maximum)));
+                measurementValues.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("medianPower"), xmlrpc_c::value_double(power.median)));
+                measurementValues.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("p95Power"), xmlrpc_c::value_double(power.percentile95)));
+                measurementValues.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("powerSamples"), xmlrpc_c::value_int(power.samples)));
+            }
+        }
+        capsResult.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string(measurementsIt->first.first), xmlrpc_c::value_struct(measurementValues)));
+    }
+    return xmlrpc_c::value_struct(capsResult);
+}
+#endif
 
-                #ifdef RAPL
-                else if (msg.compare("SR") == 0) {
-                    raplListening(false);
-                }
-                #endif
+#ifdef TIMER
+/* The times of an invocation, by the system id. */
+static xmlrpc_c::value timerData(const TimerResult& result)
+{
+    std::map<std::string, xmlrpc_c::value> capsResult;
+    std::map<std::string, xmlrpc_c::value> measurementValues;
+    measurementValues.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("elapsedTime"), xmlrpc_c::value_double((double)result.elapsedTime/BILLION)));
+    // the CPU times of the producer process, if they could be read at both markers
+    if (result.hasCpuTimes) {
+        measurementValues.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("userTime"), xmlrpc_c::value_double((double)result.userTime/BILLION)));
+        measurementValues.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("kernelTime"), xmlrpc_c::value_double((double)result.kernelTime/BILLION)));
+    }
+    capsResult.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string(result.systemId), xmlrpc_c::value_struct(measurementValues)));
+    return xmlrpc_c::value_struct(capsResult);
+}
+#endif
 
-                #ifdef TIMER
-                else if (msg.compare("ST") == 0) {
-                    timerListening(false);
-                }
-                #endif
-                else if (!msg.empty()) {
-                    std::size_t pos = msg.find("B:");
-                    if (pos != std::string::npos) {
-                        m_measuredKernels.push_back(msg.substr(pos+2));
-
-                        #ifdef RAPL
-                        if (m_raplListening) {
-                            m_raplCounter->calculate(true);
-                        }
-                        #endif
-
-                        #ifdef SCOPE
-                        if (m_scopeListening) {
-                            if(ioperm(m_parallelPortAddress,1,1))
-                                Log(m_logFile, "Couldn't open parallel port");
-                            else
-                                outb(0x01,m_parallelPortAddress); //set pin1 lo
-                        }
-                        #endif
-                        #ifdef TIMER
-                        if (m_timerListening) {
-                            m_timerCounter->calculate(true);
+#ifdef PERF
+/* The event counts of an invocation, by the components. */
+static xmlrpc_c::value perfData(const PerfCounter* perfCounter, const perf::MeasurementMap& measurements)
+{
+    std::map<std::string, xmlrpc_c::value> capsResult;
+    perf::MeasurementMap::const_iterator measurementsIt = measurements.begin();
+    for (; measurementsIt != measurements.end(); ++measurementsIt) {
+        // the kernels of the batched markers and of the threads without counters are not measured
+        if (!measurementsIt->second.isMeasured())
+            continue;
+        std::map<std::string, xmlrpc_c::value> measurementValues;
+        for (std::size_t i = 0; i < perfCounter->events().size(); ++i) {
+            const perf::Event event = perfCounter->events()[i];
+            measurementValues.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string(perf::eventName(event)), xmlrpc_c::value_double(measurementsIt->second.count(event))));
+        }
+        measurementValues.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("runningRatio"), xmlrpc_c::value_double(measurementsIt->second.runningRatio())));
+        measurementValues.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("readDelay"), xmlrpc_c::value_double((double)measurementsIt->second.readDelay()/1e9)));
+        capsResult.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string(measurementsIt->first), xmlrpc_c::value_struct(measurementValues)));
+    }
+    return xmlrpc_c::value_struct(capsResult);
+}
+#endif
+
+void RMeasureServer::stopSession(uint32_t session, char method)
+{
+    std::vector<marker::Session>::iterator sessionIt = m_sessions.begin();
+    while (sessionIt != m_sessions.end() && sessionIt->id != session)
+        ++sessionIt;
+    if (sessionIt == m_sessions.end()) {
+        // the markers of the ring and of the named pipe belong to no session
+        applyCommand(method);
+        return;
+    }
+
+    if (!sessionIt->isStopped) {
+        {
+            std::lock_guard<std::mutex> lock(m_resultsMutex);
+            sessionIt->isStopped = true;
+        }
+        Log(m_logFile, "Session " + std::to_string(session) + " stopped its measurement");
+        archiveSession(*sessionIt);
+    }
+
+    for (std::size_t i = 0; i < m_sessions.size(); ++i) {
+        if (m_sessions[i].fd >= 0 && !m_sessions[i].isStopped) {
+            Log(m_logFile, "The measurement goes on for session " + std::to_string(m_sessions[i].id));
+            return;
+        }
+    }
+    applyCommand(method);
+}
+
+/*
+ * The session results refer to the invocations of the session only: the
+ * names table, the invocations and the measured data of the methods are
+ * indexed like the invocations of the session.
+ */
+void RMeasureServer::archiveSession(marker::Session& session)
+{
+    if (session.isArchived)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(m_resultsMutex);
+        session.isArchived = true;
+    }
+
+    std::vector<std::size_t> indices;
+    std::map<std::size_t, int> localIndices;
+    for (std::size_t i = 0; i < m_invocations.size(); ++i) {
+        if (m_invocations[i].session == session.id) {
+            localIndices[i] = indices.size();
+            indices.push_back(i);
+        }
+    }
+    if (indices.empty())
+        return;
+
+    std::map<uint32_t, uint32_t> localKernels;
+    std::vector<xmlrpc_c::value> namesData;
+    std::vector<uint32_t> kernels;
+    std::vector<xmlrpc_c::value> invocationsData;
+    for (std::size_t i = 0; i < indices.size(); ++i) {
+        const uint32_t kernel = m_measuredKernels[indices[i]];
+        std::pair<std::map<uint32_t, uint32_t>::iterator, bool> inserted =
+            localKernels.insert(std::make_pair(kernel, (uint32_t)namesData.size()));
+        if (inserted.second)
+            namesData.push_back(xmlrpc_c::value_string(m_kernelNames[kernel]));
+        kernels.push_back(inserted.first->second);
+
+        // the parent is an invocation of the same producer, so of the same session
+        const marker::Invocation& invocation = m_invocations[indices[i]];
+        int parent = -1;
+        if (invocation.parent >= 0) {
+            std::map<std::size_t, int>::const_iterator parentIt = localIndices.find(invocation.parent);
+            if (parentIt != localIndices.end())
+                parent = parentIt->second;
+        }
+        invocationsData.push_back(invocationData(invocation, parent));
+    }
+
+    std::map<std::string, xmlrpc_c::value> results;
+    results.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("session"), xmlrpc_c::value_int(session.id)));
+    results.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("pid"), xmlrpc_c::value_int(session.pid)));
+    results.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("names"), xmlrpc_c::value_array(namesData)));
+    results.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("ids"), kernelIdsData(kernels)));
+    results.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("invocations"), xmlrpc_c::value_array(invocationsData)));
+
+    // a method stopped before the end of the session measured the first invocations only
+    #ifdef RAPL
+    if (m_raplCounter) {
+        std::vector<xmlrpc_c::value> raplArray;
+        const KernelList& kernelList = m_raplCounter->kernelList();
+        for (std::size_t i = 0; i < indices.size() && indices[i] < kernelList.size(); ++i)
+            raplArray.push_back(raplData(m_raplCounter, kernelList[indices[i]]));
+        results.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("rapl"), xmlrpc_c::value_array(raplArray)));
+    }
+    #endif
+    #ifdef TIMER
+    if (m_timerCounter) {
+        std::vector<xmlrpc_c::value> timerArray;
+        const ResultList& resultList = m_timerCounter->resultList();
+        for (std::size_t i = 0; i < indices.size() && indices[i] < resultList.size(); ++i)
+            timerArray.push_back(timerData(resultList[indices[i]]));
+        results.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("timer"), xmlrpc_c::value_array(timerArray)));
+    }
+    #endif
+    #ifdef PERF
+    if (m_perfCounter) {
+        std::vector<xmlrpc_c::value> perfArray;
+        const perf::KernelList& kernelList = m_perfCounter->kernelList();
+        for (std::size_t i = 0; i < indices.size() && indices[i] < kernelList.size(); ++i)
+            perfArray.push_back(perfData(m_perfCounter, kernelList[indices[i]]));
+        results.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("perf"), xmlrpc_c::value_array(perfArray)));
+    }
+    #endif
+
+    {
+        std::lock_guard<std::mutex> lock(m_resultsMutex);
+        m_sessionResults[session.id] = xmlrpc_c::value_struct(results);
+        if (m_sessionResults.size() > SESSION_RESULTS)
+            m_sessionResults.erase(m_sessionResults.begin());
+    }
+    Log(m_logFile, "The results of session " + std::to_string(session.id) + " are stored (" + std::to_string(indices.size()) + " invocations)");
+}
+
+void RMeasureServer::applyCommand(char method)
+{
+    switch (method) {
+        #ifdef SCOPE
+        case 'S' :
+            scopeListening(false);
+            break;
+        #endif
+        #ifdef RAPL
+        case 'R' :
+            raplListening(false);
+            break;
+        #endif
+        #ifdef TIMER
+        case 'T' :
+            timerListening(false);
+            break;
+        #endif
+        #ifdef PERF
+        case 'P' :
+            perfListening(false);
+            break;
+        #endif
+        default :
+            break;
+    }
+}
+
+void RMeasureServer::updateListenerStatistics()
+{
+    m_listenerStatistics.elapsedTime = marker::now() - m_listenStart;
+    m_listenerStatistics.cpuTime = threadCpuTime() - m_listenCpuStart;
+    if (m_markerRing) {
+        m_listenerStatistics.dropped = m_markerRing->dropped() - m_droppedStart;
+        m_listenerStatistics.skipped = m_markerRing->skipped() - m_skippedStart;
+    }
+}
+
+void RMeasureServer::applyCommands()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_commandMutex);
+        updateListenerStatistics();
+        for (std::size_t i = 0; i < m_commands.size(); ++i)
+            applyCommand(m_commands[i]);
+        m_commands.clear();
+    }
+    m_commandDone.notify_all();
+}
+
+void RMeasureServer::stopListening(char method)
+{
+    std::unique_lock<std::mutex> lock(m_commandMutex);
+    if (!m_isListeningEnabled || m_wakeFd < 0) {
+        applyCommand(method);
+        return;
+    }
+
+    m_commands.push_back(method);
+    uint64_t one = 1;
+    if (write(m_wakeFd, &one, sizeof one) < 0)
+        Log(m_logFile, "Couldn't wake the listener");
+    m_commandDone.wait(lock, [this]() { return m_commands.empty(); });
+}
+
+void RMeasureServer::listenMacros()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_commandMutex);
+        m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        m_isListeningEnabled = true;
+    }
+    {
+        // the session results are kept, they are dropped by their number only
+        std::lock_guard<std::mutex> lock(m_resultsMutex);
+        m_measuredKernels.clear();
+        m_invocations.clear();
+    }
+    m_openKernels.clear();
+    m_openCount = 0;
+    m_listenStart = marker::now();
+    m_listenCpuStart = threadCpuTime();
+    m_listenerStatistics = marker::ListenerStatistics();
+    umask(0);
+    /* Create the FIFO if it does not exist */
+    mknod(m_fifoName.c_str(), S_IFIFO|0666, 0);
+
+    /*
+     * Both ends of the FIFO stay open while listening, so the reader doesn't
+     * get EOF between the writer sessions and the writers never block in open().
+     */
+    int fifoFd = open(m_fifoName.c_str(), O_RDONLY | O_NONBLOCK);
+    int fifoWriteFd = open(m_fifoName.c_str(), O_WRONLY | O_NONBLOCK);
+    if (fifoFd < 0)
+        Log(m_logFile, "Couldn't open the named pipe");
+    std::string pending;
+
+    m_droppedStart = 0;
+    m_skippedStart = 0;
+    if (m_markerRing) {
+        // markers sent while nobody was listening belong to no measurement, but the registrations stay valid
+        RMeasureRecord record;
+        while (m_markerRing->pop(record)) {
+            if (record.type == RMEASURE_REGISTER)
+                processRecord(record);
+        }
+        m_droppedStart = m_markerRing->dropped();
+        m_skippedStart = m_markerRing->skipped();
+    }
+
+    if (m_markerSocket) {
+        // the closed sessions belong to the previous measurement
+        std::vector<marker::Session> openSessions;
+        for (std::size_t i = 0; i < m_sessions.size(); ++i) {
+            if (m_sessions[i].fd >= 0) {
+                openSessions.push_back(m_sessions[i]);
+                openSessions.back().isStopped = false;
+                openSessions.back().isArchived = false;
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_resultsMutex);
+            m_sessions.swap(openSessions);
+        }
+        acceptSessions(-1);
+        for (std::size_t i = 0; i < m_sessions.size(); ++i)
+            readSession(m_sessions[i], true);
+    }
+
+    /*
+     * The markers, the commands and the RAPL overflow tick are the events of
+     * one loop, the listener sleeps until any of them arrives.
+     */
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (fifoFd >= 0)
+        addListenerEvent(epollFd, fifoFd, LISTEN_FIFO);
+    if (m_wakeFd >= 0)
+        addListenerEvent(epollFd, m_wakeFd, LISTEN_WAKE);
+
+    if (m_markerSocket) {
+        addListenerEvent(epollFd, m_markerSocket->fd(), LISTEN_SOCKET);
+        for (std::size_t i = 0; i < m_sessions.size(); ++i) {
+            if (m_sessions[i].fd >= 0)
+                addListenerEvent(epollFd, m_sessions[i].fd, LISTEN_SESSION);
+        }
+    }
+
+    bool ringPolled = false;
+    if (m_markerRing) {
+        if (m_markerRing->startNotifier()) {
+            addListenerEvent(epollFd, m_markerRing->readyFd(), LISTEN_RING);
+        }
+        else {
+            Log(m_logFile, "Couldn't start the notifier of the marker ring, the ring is polled");
+            ringPolled = true;
+        }
+    }
+
+    #ifdef RAPL
+    // the overflow guard of the RAPL counters, its period follows their energy units and power limits
+    int raplTickFd = -1;
+    const marker::Timestamp raplPeriod = m_raplCounter ? m_raplCounter->updatePeriod() : 0;
+    if (raplPeriod > 0)
+        raplTickFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (raplTickFd >= 0) {
+        itimerspec period;
+        period.it_interval.tv_sec = raplPeriod / BILLION;
+        period.it_interval.tv_nsec = raplPeriod % BILLION;
+        period.it_value = period.it_interval;
+        timerfd_settime(raplTickFd, 0, &period, NULL);
+        addListenerEvent(epollFd, raplTickFd, LISTEN_RAPL_TICK);
+        Log(m_logFile, "The RAPL counters are read every " + std::to_string(raplPeriod / 1000000) + " ms to avoid their overflow");
+    }
+    #endif
+
+    Log(m_logFile, std::string("Service started to listening via ") + (m_markerRing ? "marker ring, " : "")
+        + (m_markerSocket ? "marker socket, " : "") + "named pipe");
+
+    while (m_raplListening || m_scopeListening || m_timerListening || m_perfListening)
+    {
+        epoll_event events[LISTEN_EVENTS];
+        int count = epoll_wait(epollFd, events, LISTEN_EVENTS, ringPolled ? RING_TIMEOUT_MS : -1);
+        if (count < 0 && errno != EINTR) {
+            Log(m_logFile, "The listener loop failed: " + std::string(strerror(errno)));
+            break;
+        }
+
+        bool commandsWaiting = false;
+        for (int i = 0; i < count; ++i) {
+            switch ((uint32_t)events[i].data.u64) {
+                case LISTEN_FIFO :
+                    readFifo(fifoFd, pending);
+                    break;
+                case LISTEN_RING :
+                    readCounter(m_markerRing->readyFd());
+                    drainRing();
+                    m_markerRing->drained();
+                    break;
+                case LISTEN_WAKE :
+                    readCounter(m_wakeFd);
+                    commandsWaiting = true;
+                    break;
+                case LISTEN_SOCKET :
+                    acceptSessions(epollFd);
+                    break;
+                case LISTEN_SESSION : {
+                    const int fd = (int)(events[i].data.u64 >> 32);
+                    for (std::size_t j = 0; j < m_sessions.size(); ++j) {
+                        if (m_sessions[j].fd == fd) {
+                            readSession(m_sessions[j]);
+                            break;
                         }
-                        #endif
-                        isMeasuring = true;
                     }
+                    break;
                 }
-                else { }
-                msg.clear();
-            }
-            else {
-                msg+=c;
+                #ifdef RAPL
+                case LISTEN_RAPL_TICK :
+                    readCounter(raplTickFd);
+                    if (m_raplListening)
+                        m_raplCounter->update();
+                    break;
+                #endif
+                default :
+                    break;
             }
-            c = is.get();
         }
-        is.close();
 
+        if (ringPolled)
+            drainRing();
+
+        if (commandsWaiting) {
+            // the markers received before the command still belong to the measurement
+            if (m_markerRing)
+                drainRing();
+            if (fifoFd >= 0)
+                readFifo(fifoFd, pending);
+            if (m_markerSocket)
+                readSessions();
+            applyCommands();
+        }
     }
-    m_isListeningEnabled = false;
+
+    #ifdef RAPL
+    if (raplTickFd >= 0)
+        close(raplTickFd);
+    #endif
+    close(epollFd);
+    if (fifoWriteFd >= 0)
+        close(fifoWriteFd);
+    if (fifoFd >= 0)
+        close(fifoFd);
+
+    {
+        std::lock_guard<std::mutex> lock(m_commandMutex);
+        updateListenerStatistics();
+        for (std::size_t i = 0; i < m_commands.size(); ++i)
+            applyCommand(m_commands[i]);
+        m_commands.clear();
+        m_isListeningEnabled = false;
+        if (m_wakeFd >= 0)
+            close(m_wakeFd);
+        m_wakeFd = -1;
+    }
+    m_commandDone.notify_all();
+    // the sessions still connected keep their results of this listening
+    for (std::size_t i = 0; i < m_sessions.size(); ++i)
+        archiveSession(m_sessions[i]);
+    if (m_listenerStatistics.dropped > 0)
+        Log(m_logFile, std::to_string(m_listenerStatistics.dropped) + " markers were dropped, because the marker ring was full");
+    if (m_listenerStatistics.skipped > 0)
+        Log(m_logFile, std::to_string(m_listenerStatistics.skipped) + " slots of the marker ring were skipped, because their producers didn't publish them");
     Log(m_logFile, "Service stopped to listening via named pipe");
 }
 
@@ -290,17 +1101,62 @@ bool RMeasureServer::isListening()
     return m_isListeningEnabled;
 }
 
-const std::vector<std::string>& RMeasureServer::measuredKernels()
+std::vector<std::string> RMeasureServer::kernelNames() const
 {
+    std::lock_guard<std::mutex> lock(m_resultsMutex);
+    return m_kernelNames;
+}
+
+std::vector<uint32_t> RMeasureServer::measuredKernels() const
+{
+    std::lock_guard<std::mutex> lock(m_resultsMutex);
     return m_measuredKernels;
 }
 
+std::vector<marker::Invocation> RMeasureServer::invocations() const
+{
+    std::lock_guard<std::mutex> lock(m_resultsMutex);
+    return m_invocations;
+}
+
+std::size_t RMeasureServer::invocationCount() const
+{
+    std::lock_guard<std::mutex> lock(m_resultsMutex);
+    return m_invocations.size();
+}
+
+std::vector<marker::Session> RMeasureServer::sessions() const
+{
+    std::lock_guard<std::mutex> lock(m_resultsMutex);
+    return m_sessions;
+}
+
+xmlrpc_c::value RMeasureServer::sessionResults(uint32_t session) const
+{
+    std::lock_guard<std::mutex> lock(m_resultsMutex);
+    std::map<uint32_t, xmlrpc_c::value>::const_iterator resultsIt = m_sessionResults.find(session);
+    if (resultsIt == m_sessionResults.end())
+        return xmlrpc_c::value_struct(std::map<std::string, xmlrpc_c::value>());
+    return resultsIt->second;
+}
+
+const marker::ListenerStatistics& RMeasureServer::listenerStatistics()
+{
+    return m_listenerStatistics;
+}
+
 #ifdef RAPL
 void RMeasureServer::raplListening(const bool enabled)
 {
     m_raplListening = enabled;
-    if (enabled)
+    if (enabled) {
         m_raplCounter->startMeasurement();
+    }
+    else {
+        m_raplCounter->stopMeasurement();
+        if (m_raplCounter->droppedReadings() > 0)
+            Log(m_logFile, "The RAPL counters couldn't be read at " + std::to_string(m_raplCounter->droppedReadings()) + " kernel boundaries, the kernels are not measured on those sockets");
+    }
 }
 
 const bool& RMeasureServer::isRaplListening()
@@ -324,14 +1180,65 @@ const bool& RMeasureServer::isTimerListening()
 }
 #endif
 
+#ifdef PERF
+void RMeasureServer::perfListening(const bool enabled)
+{
+    if (enabled) {
+        m_perfListening = m_perfCounter->startMeasurement();
+        if (!m_perfListening)
+            Log(m_logFile, "Couldn't open the performance counters of the sockets");
+    }
+    else {
+        m_perfListening = false;
+        m_perfCounter->stopMeasurement();
+        if (m_perfCounter->failedThreads() > 0)
+            Log(m_logFile, "The performance counters of " + std::to_string(m_perfCounter->failedThreads()) + " producer threads couldn't be opened, their kernels are not measured");
+        if (m_perfCounter->delayedRegions() > 0)
+            Log(m_logFile, "The performance counters of " + std::to_string(m_perfCounter->delayedRegions()) + " kernels were read too late after their markers, they are not measured");
+    }
+}
+
+const bool& RMeasureServer::isPerfListening()
+{
+    return m_perfListening;
+}
+#endif
+
 bool RMeasureServer::create(const std::string& configFile)
 {
 #ifdef RAPL
     std::vector<Processor> v_processors;
+    std::map<int, std::string> packageNames; // the hppdl ids of the packages named in the config file
+    std::vector<Processor> configuredCores; // the sockets given by their firstCore in the config file
+    std::string sysfsRoot = "/sys";
+    std::string platformId = "platform:0";
+    std::string raplBackend = "msr";
+    std::string msrPath = "/dev/cpu/%d/msr";
+    std::string msrVendor = "auto";
+    bool coreEnergy = false;
+    bool pinnedReaders = true;
+    bool precise = false;
+    double repeatedBlockTime = 0.01;
+    unsigned int bootstrapResamples = 1000;
+    std::string powercapRoot = "/sys/class/powercap";
+    std::string perfRoot = "/sys/bus/event_source/devices/power";
+    unsigned int samplingRate = 0;
+    unsigned int traceSize = 65536;
+    unsigned int powerWindow = 0; // ms, derived from the sampling rate
 #endif
 
 #ifdef TIMER
     std::string systemId;
+    bool cpuTimes = true;
+    std::string procRoot = "/proc";
+#endif
+
+#ifdef PERF
+    std::string perfTarget = "thread";
+    std::string perfPlatformId = "platform:0";
+    std::string perfSysfsRoot = "/sys";
+    unsigned int perfMaxReadDelay = 1000; // us
+    std::vector<std::vector<perf::Event> > perfGroups;
 #endif
     try {
         if (!configFile.empty()) {
@@ -348,28 +1255,86 @@ bool RMeasureServer::create(const std::string& configFile)
             cfg.lookupValue("server.portNumber", m_portNumber);
             cfg.lookupValue("server.logFile", m_logFile);
             cfg.lookupValue("server.fifoName", m_fifoName);
+            cfg.lookupValue("server.ringName", m_ringName);
+            cfg.lookupValue("server.ringSize", m_ringSize);
+            cfg.lookupValue("server.socketName", m_socketName);
             cfg.lookupValue("server.keepaliveTimeout", m_keepaliveTimeout);
             cfg.lookupValue("server.keepaliveMaxConn", m_keepaliveMaxConn);
             cfg.lookupValue("server.timeout", m_timeout);
             cfg.lookupValue("server.dontAdvertise", m_dontAdvertise);
 
 #ifdef RAPL
-            const Setting& root = cfg.getRoot();
-            const Setting &sockets = root["rapl"]["sockets"];
-            const int count = sockets.getLength();
-            for(int i = 0; i < count; ++i) {
-                Processor processor;
-                // received socket settings from the config file
-                const Setting &socket = sockets[i];
-                if(!( socket.lookupValue("hppdl",processor.first)
-                       && socket.lookupValue("firstCore", processor.second)))
-                    continue;
-                v_processors.push_back(processor);
+            // the packages are discovered, the sockets of the config file only name them
+            if (cfg.exists("rapl.sockets")) {
+                const Setting &sockets = cfg.lookup("rapl.sockets");
+                const int count = sockets.getLength();
+                for(int i = 0; i < count; ++i) {
+                    Processor processor;
+                    int package;
+                    // received socket settings from the config file
+                    const Setting &socket = sockets[i];
+                    if (!socket.lookupValue("hppdl", processor.first))
+                        continue;
+                    if (socket.lookupValue("package", package))
+                        packageNames[package] = processor.first;
+                    else if (socket.lookupValue("firstCore", processor.second))
+                        configuredCores.push_back(processor);
+                }
             }
+            cfg.lookupValue("rapl.sysfsRoot", sysfsRoot);
+            cfg.lookupValue("rapl.platformId", platformId);
+            cfg.lookupValue("rapl.backend", raplBackend);
+            cfg.lookupValue("rapl.msrPath", msrPath);
+            cfg.lookupValue("rapl.msrVendor", msrVendor);
+            cfg.lookupValue("rapl.coreEnergy", coreEnergy);
+            cfg.lookupValue("rapl.pinnedReaders", pinnedReaders);
+            cfg.lookupValue("rapl.precise", precise);
+            cfg.lookupValue("rapl.repeatedBlockTime", repeatedBlockTime);
+            cfg.lookupValue("rapl.bootstrapResamples", bootstrapResamples);
+            cfg.lookupValue("rapl.powercapRoot", powercapRoot);
+            cfg.lookupValue("rapl.perfRoot", perfRoot);
+            cfg.lookupValue("rapl.samplingRate", samplingRate);
+            cfg.lookupValue("rapl.traceSize", traceSize);
+            cfg.lookupValue("rapl.powerWindow", powerWindow);
 #endif
 
 #ifdef TIMER
             cfg.lookupValue("timer.systemId", systemId);
+            cfg.lookupValue("timer.cpuTimes", cpuTimes);
+            cfg.lookupValue("timer.procRoot", procRoot);
+#endif
+
+#ifdef PERF
+            cfg.lookupValue("perf.target", perfTarget);
+            cfg.lookupValue("perf.platformId", perfPlatformId);
+            cfg.lookupValue("perf.sysfsRoot", perfSysfsRoot);
+            cfg.lookupValue("perf.maxReadDelay", perfMaxReadDelay);
+            // a list of groups, each of them an array of event names, the unknown and the repeated names are ignored
+            if (cfg.exists("perf.groups")) {
+                const Setting &groups = cfg.lookup("perf.groups");
+                bool isConfigured[perf::EVENT_COUNT] = { false };
+                for (int i = 0; i < groups.getLength(); ++i) {
+                    std::vector<perf::Event> events;
+                    for (int j = 0; j < groups[i].getLength(); ++j) {
+                        const std::string name = groups[i][j];
+                        int event = 0;
+                        while (event < perf::EVENT_COUNT && name != perf::eventName(perf::Event(event)))
+                            ++event;
+                        if (event == perf::EVENT_COUNT) {
+                            Log(m_logFile, "Unknown performance event " + name + ", it is not measured");
+                        }
+                        else if (isConfigured[event]) {
+                            Log(m_logFile, "The performance event " + name + " is in more groups, it is measured in the first one");
+                        }
+                        else {
+                            isConfigured[event] = true;
+                            events.push_back(perf::Event(event));
+                        }
+                    }
+                    if (!events.empty())
+                        perfGroups.push_back(events);
+                }
+            }
 #endif
 
 #ifdef SCOPE
@@ -386,24 +1351,55 @@ bool RMeasureServer::create(const std::string& configFile)
         xmlrpc_c::methodPtr const StopRaplListeningP(new StopRaplListening);
         xmlrpc_c::methodPtr const GetRaplMeasuredDataP(new GetRaplMeasuredData);
         xmlrpc_c::methodPtr const GetMeasuredProcessorsP(new GetMeasuredProcessors);
+        xmlrpc_c::methodPtr const GetMeasuredDomainsP(new GetMeasuredDomains);
+        xmlrpc_c::methodPtr const GetPowerTraceP(new GetPowerTrace);
+        xmlrpc_c::methodPtr const GetSamplingRateP(new GetSamplingRate);
 
         m_registry.addMethod("rapl.startListening", StartRaplListeningP);
         m_registry.addMethod("rapl.stopListening", StopRaplListeningP);
         m_registry.addMethod("rapl.getMeasuredData", GetRaplMeasuredDataP);
         m_registry.addMethod("rapl.getMeasuredProcessors", GetMeasuredProcessorsP);
+        m_registry.addMethod("rapl.getMeasuredDomains", GetMeasuredDomainsP);
+        m_registry.addMethod("rapl.getPowerTrace", GetPowerTraceP);
+        m_registry.addMethod("rapl.getSamplingRate", GetSamplingRateP);
 
         xmlrpc_c::methodPtr const StartTimerListeningP(new StartTimerListening);
         xmlrpc_c::methodPtr const StopTimerListeningP(new StopTimerListening);
         xmlrpc_c::methodPtr const GetTimerMeasuredDataP(new GetTimerMeasuredData);
         xmlrpc_c::methodPtr const GetMeasuredSystemIdP(new GetMeasuredSystemId);
+        xmlrpc_c::methodPtr const GetMeasuredTimesP(new GetMeasuredTimes);
         m_registry.addMethod("timer.startListening", StartTimerListeningP);
         m_registry.addMethod("timer.stopListening", StopTimerListeningP);
         m_registry.addMethod("timer.getMeasuredData", GetTimerMeasuredDataP);
         m_registry.addMethod("timer.getMeasuredSystemId", GetMeasuredSystemIdP);
+        m_registry.addMethod("timer.getMeasuredTimes", GetMeasuredTimesP);
+
+        xmlrpc_c::methodPtr const StartPerfListeningP(new StartPerfListening);
+        xmlrpc_c::methodPtr const StopPerfListeningP(new StopPerfListening);
+        xmlrpc_c::methodPtr const GetPerfMeasuredDataP(new GetPerfMeasuredData);
+        xmlrpc_c::methodPtr const GetPerfMeasuredComponentsP(new GetPerfMeasuredComponents);
+        xmlrpc_c::methodPtr const GetPerfMeasuredEventsP(new GetPerfMeasuredEvents);
+        m_registry.addMethod("perf.startListening", StartPerfListeningP);
+        m_registry.addMethod("perf.stopListening", StopPerfListeningP);
+        m_registry.addMethod("perf.getMeasuredData", GetPerfMeasuredDataP);
+        m_registry.addMethod("perf.getMeasuredComponents", GetPerfMeasuredComponentsP);
+        m_registry.addMethod("perf.getMeasuredEvents", GetPerfMeasuredEventsP);
 
         xmlrpc_c::methodPtr const GetMeasuredKernelsP(new GetMeasuredKernels);
         m_registry.addMethod("rmeasure.getMeasuredKernels", GetMeasuredKernelsP);
 
+        xmlrpc_c::methodPtr const GetKernelInvocationsP(new GetKernelInvocations);
+        m_registry.addMethod("rmeasure.getKernelInvocations", GetKernelInvocationsP);
+
+        xmlrpc_c::methodPtr const GetSessionsP(new GetSessions);
+        xmlrpc_c::methodPtr const GetSessionInvocationsP(new GetSessionInvocations);
+        m_registry.addMethod("rmeasure.getSessions", GetSessionsP);
+        m_registry.addMethod("rmeasure.getSessionInvocations", GetSessionInvocationsP);
+        xmlrpc_c::methodPtr const GetSessionResultsP(new GetSessionResults);
+        m_registry.addMethod("rmeasure.getSessionResults", GetSessionResultsP);
+        xmlrpc_c::methodPtr const GetListenerStatisticsP(new GetListenerStatistics);
+        m_registry.addMethod("rmeasure.getListenerStatistics", GetListenerStatisticsP);
+
         if (!m_abyssServer) {
             /*
              * xmlrpc_c::serverAbyss is an XML-RPC server based on the Abyss HTTP server
@@ -427,9 +1423,122 @@ bool RMeasureServer::create(const std::string& configFile)
             Log(m_logFile, "Server is already configured, restart the service to use new configuration for the Server!");
         }
 
+        if (!m_markerRing && !m_ringName.empty()) {
+            m_markerRing = new marker::MarkerRing(m_ringName, m_ringSize);
+            if (!m_markerRing->create()) {
+                Log(m_logFile, "Couldn't create the marker ring, markers are received via named pipe only");
+                delete m_markerRing;
+                m_markerRing = NULL;
+            }
+        }
+
+        if (!m_markerSocket && !m_socketName.empty()) {
+            m_markerSocket = new marker::MarkerSocket(m_socketName);
+            if (!m_markerSocket->create()) {
+                Log(m_logFile, "Couldn't create the marker socket, markers are received without sessions only");
+                delete m_markerSocket;
+                m_markerSocket = NULL;
+            }
+        }
+
 #ifdef RAPL
         if (!m_raplCounter) {
-            m_raplCounter = new RaplCounter(v_processors);
+            const std::vector<Package> packages = discoverPackages(sysfsRoot);
+            if (packages.empty()) {
+                Log(m_logFile, "Couldn't discover the processor packages in " + sysfsRoot + ", the configured firstCores are measured");
+                v_processors = configuredCores;
+            }
+            // a firstCore of the config file names the package which has that core
+            for (std::size_t i = 0; i < configuredCores.size() && !packages.empty(); ++i) {
+                std::size_t j = 0;
+                while (j < packages.size() && std::find(packages[j].cores.begin(), packages[j].cores.end(), configuredCores[i].second) == packages[j].cores.end())
+                    ++j;
+                if (j == packages.size())
+                    Log(m_logFile, "Core " + std::to_string(configuredCores[i].second) + " of " + configuredCores[i].first + " is not online, the name is not used");
+                else if (!packageNames.count(packages[j].id))
+                    packageNames[packages[j].id] = configuredCores[i].first;
+            }
+            for (std::size_t i = 0; i < packages.size(); ++i) {
+                std::map<int, std::string>::const_iterator nameIt = packageNames.find(packages[i].id);
+                const std::string name = nameIt != packageNames.end() ? nameIt->second : platformId + ".processor:" + std::to_string(i);
+                v_processors.push_back(Processor(name, packages[i].cores.front()));
+                Log(m_logFile, "Package " + std::to_string(packages[i].id) + " is measured as " + name + ", cores " + formatCpuList(packages[i].cores)
+                    + (packages[i].nodes.empty() ? "" : ", NUMA nodes " + formatCpuList(packages[i].nodes)));
+            }
+
+            std::vector<int> cores;
+            for (std::size_t i = 0; i < v_processors.size(); ++i)
+                cores.push_back(v_processors[i].second);
+            // the components read by the thread of each socket, the cores are read by the thread of their package
+            std::vector<std::vector<std::size_t> > readerGroups;
+            for (std::size_t i = 0; i < v_processors.size(); ++i)
+                readerGroups.push_back(std::vector<std::size_t>(1, i));
+
+            EnergySource* source = NULL;
+            if (raplBackend == "powercap") {
+                source = new PowercapEnergySource(powercapRoot, cores, m_logFile);
+            }
+            else if (raplBackend == "perf") {
+                source = new PerfEnergySource(perfRoot, cores, m_logFile);
+            }
+            else if (raplBackend != "msr") {
+                Log(m_logFile, "Unknown RAPL backend " + raplBackend + ", the MSRs are read");
+            }
+            if (source && source->domains().empty()) {
+                Log(m_logFile, "No RAPL domain can be read via " + source->name() + ", the MSRs are read");
+                delete source;
+                source = NULL;
+            }
+            if (!source) {
+                MsrEnergySource* msrSource = new MsrEnergySource(cores, msrPath, msrVendor);
+                if (coreEnergy) {
+                    // the physical cores of each package are its child components
+                    std::vector<int> coreList;
+                    std::vector<Processor> coreProcessors;
+                    for (std::size_t i = 0; i < packages.size(); ++i) {
+                        for (std::size_t j = 0; j < packages[i].physicalCores.size(); ++j) {
+                            readerGroups[i].push_back(v_processors.size() + coreList.size());
+                            coreList.push_back(packages[i].physicalCores[j]);
+                            coreProcessors.push_back(Processor(v_processors[i].first + ".core:" + std::to_string(j), packages[i].physicalCores[j]));
+                        }
+                    }
+                    if (!coreList.empty() && msrSource->addCores(coreList)) {
+                        v_processors.insert(v_processors.end(), coreProcessors.begin(), coreProcessors.end());
+                        Log(m_logFile, "The energy of " + std::to_string(coreList.size()) + " cores is measured");
+                    }
+                    else {
+                        Log(m_logFile, "The energy of the cores can't be read, the AMD processors count it only");
+                        for (std::size_t i = 0; i < readerGroups.size(); ++i)
+                            readerGroups[i].resize(1);
+                    }
+                }
+                source = msrSource;
+            }
+            m_raplCounter = new RaplCounter(v_processors, source);
+
+            std::string domains;
+            for (std::size_t i = 0; i < m_raplCounter->domains().size(); ++i)
+                domains += std::string(i > 0 ? ", " : "") + domainName(m_raplCounter->domains()[i]);
+            if (domains.empty())
+                Log(m_logFile, "No RAPL domain can be read via " + source->name());
+            else
+                Log(m_logFile, "Measured RAPL domains via " + source->name() + ": " + domains);
+
+            // a single socket is read by the listener itself
+            if (pinnedReaders && readerGroups.size() > 1) {
+                m_raplCounter->setReaders(readerGroups, m_logFile);
+                Log(m_logFile, "The RAPL counters of the " + std::to_string(readerGroups.size()) + " sockets are read by pinned threads");
+            }
+
+            m_raplCounter->setPrecise(precise);
+            m_raplCounter->setRepeated(repeatedBlockTime, bootstrapResamples);
+            if (precise)
+                Log(m_logFile, "The RAPL counters are read at their updates at the kernel boundaries");
+
+            m_raplCounter->setSampling(samplingRate, traceSize, (marker::Timestamp)powerWindow * 1000000);
+            if (m_raplCounter->sampler())
+                Log(m_logFile, "The RAPL counters are sampled at " + std::to_string(samplingRate) + " Hz, the power statistics resolve "
+                    + std::to_string(m_raplCounter->sampler()->window() / 1000000) + " ms");
         }
         else {
             Log(m_logFile, "RaplCounter is already configured, restart the service to use new configuration for the RaplCounter!");
@@ -439,11 +1548,54 @@ bool RMeasureServer::create(const std::string& configFile)
 #ifdef TIMER
         if (!m_timerCounter) {
             m_timerCounter = new TimerCounter(systemId);
+            if (cpuTimes) {
+                m_timerCounter->setCpuTimes(procRoot);
+                Log(m_logFile, "The CPU times of the producers are read from " + procRoot);
+            }
         }
         else {
              Log(m_logFile, "TimerCounter is already configured, restart the service to use new configuration for the TimerCounter!");
         }
 #endif
+
+#ifdef PERF
+        if (!m_perfCounter) {
+            // one group of every event, if they are not configured
+            if (perfGroups.empty()) {
+                perfGroups.push_back(std::vector<perf::Event>());
+                for (int event = 0; event < perf::EVENT_COUNT; ++event)
+                    perfGroups.back().push_back(perf::Event(event));
+            }
+            std::vector<std::string> components;
+            std::vector<std::vector<int> > cpus;
+            perf::Target target = perf::TARGET_THREAD;
+            if (perfTarget == "socket") {
+                target = perf::TARGET_SOCKET;
+                const std::vector<rapl::Package> packages = rapl::discoverPackages(perfSysfsRoot);
+                for (std::size_t i = 0; i < packages.size(); ++i) {
+                    components.push_back(perfPlatformId + ".processor:" + std::to_string(i));
+                    cpus.push_back(packages[i].cores);
+                }
+                if (packages.empty())
+                    Log(m_logFile, "Couldn't discover the processor packages in " + perfSysfsRoot + ", the performance counters can't be started");
+            }
+            else {
+                if (perfTarget != "thread")
+                    Log(m_logFile, "Unknown performance counter target " + perfTarget + ", the producer threads are measured");
+                components.push_back(perfPlatformId);
+            }
+            m_perfCounter = new PerfCounter(perfGroups, target, components, cpus, (marker::Timestamp)perfMaxReadDelay * 1000);
+
+            std::string events;
+            for (std::size_t i = 0; i < m_perfCounter->events().size(); ++i)
+                events += std::string(i > 0 ? ", " : "") + perf::eventName(m_perfCounter->events()[i]);
+            Log(m_logFile, "Measured performance events of the " + std::string(target == perf::TARGET_SOCKET ? "sockets" : "producer threads")
+                + " in " + std::to_string(perfGroups.size()) + " groups: " + events);
+        }
+        else {
+            Log(m_logFile, "PerfCounter is already configured, restart the service to use new configuration for the PerfCounter!");
+        }
+#endif
     }
     catch(const FileIOException &fioex)
     {
@@ -489,6 +1641,13 @@ const TimerCounter* RMeasureServer::timerCounter() const
 }
 #endif
 
+#ifdef PERF
+const PerfCounter* RMeasureServer::perfCounter() const
+{
+    return m_perfCounter;
+}
+#endif
+
 StartScopeListening::StartScopeListening()
 {
     this->_signature = "b:";
@@ -578,10 +1737,8 @@ void StopScopeListening::execute(xmlrpc_c::paramList const& paramList, xmlrpc_c:
     bool isSucced = false;
 #ifdef SCOPE
     RMeasureServer* rMeasureServer = RMeasureServer::instance();
-    rMeasureServer->scopeListening(false);
-
+    rMeasureServer->stopListening('S');
     isSucced = true;
-    rMeasureServer->callFifo("SS;");
     Log(rMeasureServer->logFile(), "Scope stopped to listening via named pipe");
 #endif
     *retvalP = xmlrpc_c::value_boolean(isSucced);
@@ -598,9 +1755,8 @@ void StopRaplListening::execute(xmlrpc_c::paramList const& paramList, xmlrpc_c::
     bool isSucced = false;
 #ifdef RAPL
     RMeasureServer* rMeasureServer = RMeasureServer::instance();
-    rMeasureServer->raplListening(false);
+    rMeasureServer->stopListening('R');
     isSucced = true;
-    rMeasureServer->callFifo("SR;");
     Log(rMeasureServer->logFile(), "Rapl stopped to listening via named pipe");
 #endif
     *retvalP = xmlrpc_c::value_boolean(isSucced);
@@ -617,9 +1773,8 @@ void StopTimerListening::execute(xmlrpc_c::paramList const& paramList, xmlrpc_c:
     bool isSucced = false;
 #ifdef TIMER
     RMeasureServer* rMeasureServer = RMeasureServer::instance();
-    rMeasureServer->timerListening(false);
+    rMeasureServer->stopListening('T');
     isSucced = true;
-    rMeasureServer->callFifo("ST;");
     Log(rMeasureServer->logFile(), "Timer stopped to listening via named pipe");
 #endif
     *retvalP = xmlrpc_c::value_boolean(isSucced);
@@ -628,31 +1783,68 @@ void StopTimerListening::execute(xmlrpc_c::paramList const& paramList, xmlrpc_c:
 
 GetRaplMeasuredData::GetRaplMeasuredData()
 {
-    this->_signature = "A:";
-    this->_help = "This method will get the measured data list from the rapl counters";
+    this->_signature = "A:,S:s";
+    this->_help = "This method will get the measured data list from the rapl counters, "
+                  "or with \"repeated\" the energy per invocation of each kernel estimated from its repeated invocations";
+}
+
+#ifdef RAPL
+/*
+ * The repeated-invocation estimates of every kernel on every socket, by the
+ * kernel names and the processors.
+ */
+static xmlrpc_c::value repeatedData(const RaplCounter* raplCounter, const std::vector<std::string>& kernelNames)
+{
+    // the counter records the kernel of each of its regions
+    const std::set<uint32_t> kernels(raplCounter->kernels().begin(), raplCounter->kernels().end());
+
+    std::map<std::string, xmlrpc_c::value> kernelsData;
+    std::set<uint32_t>::const_iterator kernelIt = kernels.begin();
+    for (; kernelIt != kernels.end(); ++kernelIt) {
+        if (*kernelIt >= kernelNames.size())
+            continue;
+        std::map<std::string, xmlrpc_c::value> capsResult;
+        for (std::size_t i = 0; i < raplCounter->processors().size(); ++i) {
+            const RepeatedEnergy repeated = raplCounter->repeatedEnergy(*kernelIt, i);
+            if (repeated.invocations == 0)
+                continue;
+            std::map<std::string, xmlrpc_c::value> estimateValues;
+            estimateValues.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("energy"), xmlrpc_c::value_double(repeated.energy)));
+            // the confidence interval needs at least two blocks of invocations
+            if (repeated.blocks > 1) {
+                estimateValues.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("energyLow"), xmlrpc_c::value_double(repeated.low)));
+                estimateValues.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("energyHigh"), xmlrpc_c::value_double(repeated.high)));
+            }
+            estimateValues.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("totalEnergy"), xmlrpc_c::value_double(repeated.totalEnergy)));
+            estimateValues.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("elapsedTime"), xmlrpc_c::value_double((double)repeated.elapsedTime / BILLION)));
+            estimateValues.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("invocations"), xmlrpc_c::value_int(repeated.invocations)));
+            estimateValues.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("blocks"), xmlrpc_c::value_int(repeated.blocks)));
+            capsResult.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string(raplCounter->processors()[i].first), xmlrpc_c::value_struct(estimateValues)));
+        }
+        kernelsData.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string(kernelNames[*kernelIt]), xmlrpc_c::value_struct(capsResult)));
+    }
+    return xmlrpc_c::value_struct(kernelsData);
 }
+#endif
 
 void GetRaplMeasuredData::execute(xmlrpc_c::paramList const& paramList, xmlrpc_c::value * const retvalP)
 {
     std::vector<xmlrpc_c::value> arrayData;
     RMeasureServer* rMeasureServer = RMeasureServer::instance();
+    const bool isRepeated = paramList.size() > 0 && paramList.getString(0) == "repeated";
 
 #ifdef RAPL
     const RaplCounter* raplCounter = rMeasureServer->raplCounter();
+    if (raplCounter && isRepeated) {
+        Log(rMeasureServer->logFile(), "Send the repeated-invocation estimates from the RAPL counters");
+        *retvalP = repeatedData(raplCounter, rMeasureServer->kernelNames());
+        return;
+    }
     if (raplCounter) {
-        const KernelList kernelList = raplCounter->kernelList();
+        const KernelList& kernelList = raplCounter->kernelList();
         KernelList::const_iterator kernelResultsIt = kernelList.begin();
-        for (; kernelResultsIt != kernelList.end(); ++kernelResultsIt) {
-            std::map<std::string, xmlrpc_c::value> capsResult;
-            MeasurementMap::const_iterator measurementsIt = kernelResultsIt->begin();
-            for (; measurementsIt != kernelResultsIt->end(); ++measurementsIt) {
-                std::map<std::string, xmlrpc_c::value> measurementValues;
-                measurementValues.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("energy"), xmlrpc_c::value_double(measurementsIt->second.packageEnergy())));
-                measurementValues.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("elapsedTime"), xmlrpc_c::value_double((double)(measurementsIt->second.elapsedTime())/BILLION)));
-                capsResult.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string(measurementsIt->first.first), xmlrpc_c::value_struct(measurementValues)));
-            }
-            arrayData.push_back(xmlrpc_c::value_struct(capsResult));
-        }
+        for (; kernelResultsIt != kernelList.end(); ++kernelResultsIt)
+            arrayData.push_back(raplData(raplCounter, *kernelResultsIt));
 
         Log(rMeasureServer->logFile(), "Send measured data from the RAPL counters");
     }
@@ -662,7 +1854,10 @@ void GetRaplMeasuredData::execute(xmlrpc_c::paramList const& paramList, xmlrpc_c
 #else
         Log(rMeasureServer->logFile(), "Send empty measured data from the RAPL counters, because RAPL is undefined");
 #endif
-     *retvalP = xmlrpc_c::value_array(arrayData);
+    if (isRepeated)
+        *retvalP = xmlrpc_c::value_struct(std::map<std::string, xmlrpc_c::value>());
+    else
+        *retvalP = xmlrpc_c::value_array(arrayData);
 
 }
 
@@ -682,15 +1877,10 @@ void GetTimerMeasuredData::execute(xmlrpc_c::paramList const& paramList, xmlrpc_
     const TimerCounter* timerCounter = rMeasureServer->timerCounter();
     if (timerCounter) {
 
-        const ResultList kernelResults = timerCounter->resultList();
+        const ResultList& kernelResults = timerCounter->resultList();
         ResultList::const_iterator kernelResultsIt = kernelResults.begin();
-        for (; kernelResultsIt != kernelResults.end(); ++kernelResultsIt) {
-            std::map<std::string, xmlrpc_c::value> capsResult;
-            std::map<std::string, xmlrpc_c::value> measurementValues;
-            measurementValues.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("elapsedTime"), xmlrpc_c::value_double((double)kernelResultsIt->second/BILLION)));
-            capsResult.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string(kernelResultsIt->first), xmlrpc_c::value_struct(measurementValues)));
-            arrayData.push_back(xmlrpc_c::value_struct(capsResult));
-        }
+        for (; kernelResultsIt != kernelResults.end(); ++kernelResultsIt)
+            arrayData.push_back(timerData(*kernelResultsIt));
         Log(rMeasureServer->logFile(), "Send measured data from the Timer counters");
     }
     else {
@@ -735,6 +1925,102 @@ void GetMeasuredProcessors::execute(xmlrpc_c::paramList const& paramList, xmlrpc
 
 }
 
+GetMeasuredDomains::GetMeasuredDomains()
+{
+    this->_signature = "A:";
+    this->_help = "This method will send the measured RAPL domains of the processors (package, pp0, pp1, dram, psys)";
+}
+
+void GetMeasuredDomains::execute(xmlrpc_c::paramList const& paramList, xmlrpc_c::value* const retvalP)
+{
+    std::vector<xmlrpc_c::value> arrayData;
+    RMeasureServer* rMeasureServer = RMeasureServer::instance();
+#ifdef RAPL
+    const RaplCounter* raplCounter = rMeasureServer->raplCounter();
+    if (raplCounter) {
+        const std::vector<Domain>& domains = raplCounter->domains();
+        for (std::size_t i = 0; i < domains.size(); ++i)
+            arrayData.push_back(xmlrpc_c::value_string(domainName(domains[i])));
+
+        Log(rMeasureServer->logFile(), "Send the measured RAPL domains");
+    }
+    else {
+        Log(rMeasureServer->logFile(), "Failed to send the measured RAPL domains. RaplCounter is not available");
+    }
+#else
+        Log(rMeasureServer->logFile(), "Send empty measured domains data from the RAPL counters, because RAPL is undefined");
+#endif
+    *retvalP = xmlrpc_c::value_array(arrayData);
+}
+
+GetPowerTrace::GetPowerTrace()
+{
+    this->_signature = "S:";
+    this->_help = "This method will send the power trace of the RAPL sampler: the end of each sampling interval (time, in seconds since the start of the sampling) and the power of the measured domains of each processor during the intervals (in Watts)";
+}
+
+void GetPowerTrace::execute(xmlrpc_c::paramList const& paramList, xmlrpc_c::value* const retvalP)
+{
+    std::map<std::string, xmlrpc_c::value> trace;
+    RMeasureServer* rMeasureServer = RMeasureServer::instance();
+#ifdef RAPL
+    const RaplCounter* raplCounter = rMeasureServer->raplCounter();
+    if (raplCounter && raplCounter->sampler()) {
+        std::vector<marker::Timestamp> times;
+        std::vector<double> powers;
+        raplCounter->sampler()->trace(times, powers);
+        const marker::Timestamp start = raplCounter->sampler()->startTime();
+
+        std::vector<xmlrpc_c::value> timeValues;
+        for (std::size_t i = 0; i < times.size(); ++i)
+            timeValues.push_back(xmlrpc_c::value_double((double)(times[i] - start) / BILLION));
+        trace.insert(std::pair<std::string, xmlrpc_c::value>("time", xmlrpc_c::value_array(timeValues)));
+
+        // processor -> domain -> power of each interval
+        const std::vector<Processor>& processors = raplCounter->processors();
+        const std::vector<Domain>& domains = raplCounter->domains();
+        std::map<std::string, xmlrpc_c::value> processorValues;
+        for (std::size_t i = 0; i < processors.size(); ++i) {
+            std::map<std::string, xmlrpc_c::value> domainValues;
+            for (std::size_t j = 0; j < domains.size(); ++j) {
+                std::vector<xmlrpc_c::value> powerValues;
+                for (std::size_t k = 0; k < times.size(); ++k)
+                    powerValues.push_back(xmlrpc_c::value_double(powers[(k * processors.size() + i) * domains.size() + j]));
+                domainValues.insert(std::pair<std::string, xmlrpc_c::value>(domainName(domains[j]), xmlrpc_c::value_array(powerValues)));
+            }
+            processorValues.insert(std::pair<std::string, xmlrpc_c::value>(processors[i].first, xmlrpc_c::value_struct(domainValues)));
+        }
+        trace.insert(std::pair<std::string, xmlrpc_c::value>("processors", xmlrpc_c::value_struct(processorValues)));
+        trace.insert(std::pair<std::string, xmlrpc_c::value>("overwritten", xmlrpc_c::value_double((double)raplCounter->sampler()->overwritten())));
+
+        Log(rMeasureServer->logFile(), "Send the power trace of the RAPL sampler");
+    }
+    else {
+        Log(rMeasureServer->logFile(), "Failed to send the power trace. The RAPL sampler is not enabled");
+    }
+#else
+        Log(rMeasureServer->logFile(), "Send empty power trace, because RAPL is undefined");
+#endif
+    *retvalP = xmlrpc_c::value_struct(trace);
+}
+
+GetSamplingRate::GetSamplingRate()
+{
+    this->_signature = "d:";
+    this->_help = "This method will send the sampling rate of the RAPL sampler (in Hz), 0 if it is disabled";
+}
+
+void GetSamplingRate::execute(xmlrpc_c::paramList const& paramList, xmlrpc_c::value* const retvalP)
+{
+    double rate = 0.0;
+#ifdef RAPL
+    const RaplCounter* raplCounter = RMeasureServer::instance()->raplCounter();
+    if (raplCounter && raplCounter->sampler())
+        rate = raplCounter->sampler()->rate();
+#endif
+    *retvalP = xmlrpc_c::value_double(rate);
+}
+
 GetMeasuredSystemId::GetMeasuredSystemId()
 {
     this->_signature = "s:";
@@ -764,22 +2050,298 @@ void GetMeasuredSystemId::execute(xmlrpc_c::paramList const& paramList, xmlrpc_c
 }
 
 
-GetMeasuredKernels::GetMeasuredKernels()
+GetMeasuredTimes::GetMeasuredTimes()
 {
     this->_signature = "A:";
-    this->_help = "This method will send the measured kernel names";
+    this->_help = "This method will send the times measured by the timer (elapsedTime, userTime, kernelTime)";
 }
 
-void GetMeasuredKernels::execute(xmlrpc_c::paramList const& paramList, xmlrpc_c::value* const retvalP)
+void GetMeasuredTimes::execute(xmlrpc_c::paramList const& paramList, xmlrpc_c::value* const retvalP)
+{
+    std::vector<xmlrpc_c::value> arrayData;
+    RMeasureServer* rMeasureServer = RMeasureServer::instance();
+#ifdef TIMER
+    const TimerCounter* timerCounter = rMeasureServer->timerCounter();
+    if (timerCounter) {
+        arrayData.push_back(xmlrpc_c::value_string("elapsedTime"));
+        if (timerCounter->isCpuTimeMeasured()) {
+            arrayData.push_back(xmlrpc_c::value_string("userTime"));
+            arrayData.push_back(xmlrpc_c::value_string("kernelTime"));
+        }
+        Log(rMeasureServer->logFile(), "Send the measured times of the timer");
+    }
+    else {
+        Log(rMeasureServer->logFile(), "Failed to send the measured times. TimerCounter is not available");
+    }
+#else
+        Log(rMeasureServer->logFile(), "Send empty measured times from the TimerCounter, because TIMER is undefined");
+#endif
+    *retvalP = xmlrpc_c::value_array(arrayData);
+}
+
+StartPerfListening::StartPerfListening()
+{
+    this->_signature = "b:";
+    this->_help = "This method will start the performance counter listening";
+}
+
+void StartPerfListening::execute(xmlrpc_c::paramList const& paramList, xmlrpc_c::value * const retvalP)
+{
+    bool isSucced = false;
+#ifdef PERF
+    RMeasureServer* rMeasureServer = RMeasureServer::instance();
+    // this check ensure only one measurement at once
+    if (!rMeasureServer->isPerfListening()) {
+        rMeasureServer->perfListening(true);
+        if (rMeasureServer->isPerfListening()) {
+            if (!rMeasureServer->isListening())
+            {
+                 std::thread t1 = std::thread(&RMeasureServer::listenMacros, RMeasureServer::instance());
+                 t1.detach();
+            }
+            isSucced = true;
+            Log(rMeasureServer->logFile(), "Perf started to listening via named pipe");
+        }
+    }
+#endif
+    *retvalP = xmlrpc_c::value_boolean(isSucced);
+}
+
+StopPerfListening::StopPerfListening()
+{
+    this->_signature = "b:";
+    this->_help = "This method will stop the performance counter listening";
+}
+
+void StopPerfListening::execute(xmlrpc_c::paramList const& paramList, xmlrpc_c::value * const retvalP)
+{
+    bool isSucced = false;
+#ifdef PERF
+    RMeasureServer* rMeasureServer = RMeasureServer::instance();
+    rMeasureServer->stopListening('P');
+    isSucced = true;
+    Log(rMeasureServer->logFile(), "Perf stopped to listening via named pipe");
+#endif
+    *retvalP = xmlrpc_c::value_boolean(isSucced);
+}
+
+GetPerfMeasuredData::GetPerfMeasuredData()
+{
+    this->_signature = "A:";
+    this->_help = "This method will get the measured data list from the performance counters: the event counts of each component, "
+                  "scaled to the whole kernel if the groups were multiplexed, the smallest ratio of the time the groups were counting (runningRatio) "
+                  "and the longer time from a marker to the read of its counters (readDelay, in sec)";
+}
+
+void GetPerfMeasuredData::execute(xmlrpc_c::paramList const& paramList, xmlrpc_c::value * const retvalP)
+{
+    std::vector<xmlrpc_c::value> arrayData;
+    RMeasureServer* rMeasureServer = RMeasureServer::instance();
+
+#ifdef PERF
+    const PerfCounter* perfCounter = rMeasureServer->perfCounter();
+    if (perfCounter) {
+        const perf::KernelList& kernelList = perfCounter->kernelList();
+        perf::KernelList::const_iterator kernelResultsIt = kernelList.begin();
+        for (; kernelResultsIt != kernelList.end(); ++kernelResultsIt)
+            arrayData.push_back(perfData(perfCounter, *kernelResultsIt));
+        Log(rMeasureServer->logFile(), "Send measured data from the performance counters");
+    }
+    else {
+        Log(rMeasureServer->logFile(), "PerfCounter is not defined.");
+    }
+#else
+        Log(rMeasureServer->logFile(), "Send empty measured data from the performance counters, because PERF is undefined");
+#endif
+    *retvalP = xmlrpc_c::value_array(arrayData);
+}
+
+GetPerfMeasuredComponents::GetPerfMeasuredComponents()
+{
+    this->_signature = "A:";
+    this->_help = "This method will send the HPP-DL component refs measured by the performance counters (the platform or its processors)";
+}
+
+void GetPerfMeasuredComponents::execute(xmlrpc_c::paramList const& paramList, xmlrpc_c::value* const retvalP)
+{
+    std::vector<xmlrpc_c::value> arrayData;
+    RMeasureServer* rMeasureServer = RMeasureServer::instance();
+#ifdef PERF
+    const PerfCounter* perfCounter = rMeasureServer->perfCounter();
+    if (perfCounter) {
+        for (std::size_t i = 0; i < perfCounter->components().size(); ++i)
+            arrayData.push_back(xmlrpc_c::value_string(perfCounter->components()[i]));
+        Log(rMeasureServer->logFile(), "Send the components of the performance counters");
+    }
+    else {
+        Log(rMeasureServer->logFile(), "Failed to send the components of the performance counters. PerfCounter is not available");
+    }
+#else
+        Log(rMeasureServer->logFile(), "Send empty components of the performance counters, because PERF is undefined");
+#endif
+    *retvalP = xmlrpc_c::value_array(arrayData);
+}
+
+GetPerfMeasuredEvents::GetPerfMeasuredEvents()
+{
+    this->_signature = "A:";
+    this->_help = "This method will send the measured performance events (cycles, instructions, llcMisses, branchMisses)";
+}
+
+void GetPerfMeasuredEvents::execute(xmlrpc_c::paramList const& paramList, xmlrpc_c::value* const retvalP)
 {
     std::vector<xmlrpc_c::value> arrayData;
     RMeasureServer* rMeasureServer = RMeasureServer::instance();
+#ifdef PERF
+    const PerfCounter* perfCounter = rMeasureServer->perfCounter();
+    if (perfCounter) {
+        for (std::size_t i = 0; i < perfCounter->events().size(); ++i)
+            arrayData.push_back(xmlrpc_c::value_string(perf::eventName(perfCounter->events()[i])));
+        Log(rMeasureServer->logFile(), "Send the measured performance events");
+    }
+    else {
+        Log(rMeasureServer->logFile(), "Failed to send the measured performance events. PerfCounter is not available");
+    }
+#else
+        Log(rMeasureServer->logFile(), "Send empty measured performance events, because PERF is undefined");
+#endif
+    *retvalP = xmlrpc_c::value_array(arrayData);
+}
+
+GetMeasuredKernels::GetMeasuredKernels()
+{
+    this->_signature = "S:";
+    this->_help = "This method will send the measured kernels: the table of the kernel names (names) and the index of the name of each invocation (ids, packed little-endian 32 bit integers)";
+}
+
+void GetMeasuredKernels::execute(xmlrpc_c::paramList const& paramList, xmlrpc_c::value* const retvalP)
+{
+    std::vector<xmlrpc_c::value> namesData;
+    RMeasureServer* rMeasureServer = RMeasureServer::instance();
+
+    const std::vector<std::string> names = rMeasureServer->kernelNames();
+    std::vector<std::string>::const_iterator nameIt = names.begin();
+    for (; nameIt != names.end(); ++nameIt)
+        namesData.push_back(xmlrpc_c::value_string(*nameIt));
 
-    std::vector<std::string> kernels = rMeasureServer->measuredKernels();
-    std::vector<std::string>::iterator kernelIt = kernels.begin();
-    for (; kernelIt != kernels.end(); ++kernelIt)
-        arrayData.push_back(xmlrpc_c::value_string(*kernelIt));
+    std::map<std::string, xmlrpc_c::value> measuredKernels;
+    measuredKernels.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("names"), xmlrpc_c::value_array(namesData)));
+    measuredKernels.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("ids"), kernelIdsData(rMeasureServer->measuredKernels())));
 
     Log(rMeasureServer->logFile(), "Send a list about the measured kernels name");
+    *retvalP = xmlrpc_c::value_struct(measuredKernels);
+}
+
+GetKernelInvocations::GetKernelInvocations()
+{
+    this->_signature = "A:";
+    this->_help = "This method will send the nesting, the producer (pid, tid), the parallel port delays (in sec) and the sampling weight, the batching and the socket session of the measured kernel invocations (in the order of rmeasure.getMeasuredKernels)";
+}
+
+void GetKernelInvocations::execute(xmlrpc_c::paramList const& paramList, xmlrpc_c::value* const retvalP)
+{
+    std::vector<xmlrpc_c::value> arrayData;
+    RMeasureServer* rMeasureServer = RMeasureServer::instance();
+
+    const std::vector<marker::Invocation> invocations = rMeasureServer->invocations();
+    std::vector<marker::Invocation>::const_iterator invocationIt = invocations.begin();
+    for (; invocationIt != invocations.end(); ++invocationIt)
+        arrayData.push_back(invocationData(*invocationIt, invocationIt->parent));
+
+    Log(rMeasureServer->logFile(), "Send the nesting and the producers of the measured kernels");
+    *retvalP = xmlrpc_c::value_array(arrayData);
+}
+
+GetSessions::GetSessions()
+{
+    this->_signature = "A:";
+    this->_help = "This method will send the sessions of the marker socket (id, pid, uid, gid of the peer, whether it is connected and whether it sent a stop command)";
+}
+
+void GetSessions::execute(xmlrpc_c::paramList const& paramList, xmlrpc_c::value* const retvalP)
+{
+    std::vector<xmlrpc_c::value> arrayData;
+    RMeasureServer* rMeasureServer = RMeasureServer::instance();
+
+    const std::vector<marker::Session> sessions = rMeasureServer->sessions();
+    std::vector<marker::Session>::const_iterator sessionIt = sessions.begin();
+    for (; sessionIt != sessions.end(); ++sessionIt) {
+        std::map<std::string, xmlrpc_c::value> session;
+        session.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("session"), xmlrpc_c::value_int(sessionIt->id)));
+        session.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("pid"), xmlrpc_c::value_int(sessionIt->pid)));
+        session.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("uid"), xmlrpc_c::value_int(sessionIt->uid)));
+        session.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("gid"), xmlrpc_c::value_int(sessionIt->gid)));
+        session.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("connected"), xmlrpc_c::value_boolean(sessionIt->fd >= 0)));
+        session.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("stopped"), xmlrpc_c::value_boolean(sessionIt->isStopped)));
+        arrayData.push_back(xmlrpc_c::value_struct(session));
+    }
+
+    Log(rMeasureServer->logFile(), "Send the sessions of the marker socket");
+    *retvalP = xmlrpc_c::value_array(arrayData);
+}
+
+GetSessionInvocations::GetSessionInvocations()
+{
+    this->_signature = "A:i";
+    this->_help = "This method will send the indices of the invocations of a session (in the order of rmeasure.getMeasuredKernels and of the measured data of the methods)";
+}
+
+void GetSessionInvocations::execute(xmlrpc_c::paramList const& paramList, xmlrpc_c::value* const retvalP)
+{
+    const int session = paramList.getInt(0);
+    paramList.verifyEnd(1);
+
+    std::vector<xmlrpc_c::value> arrayData;
+    RMeasureServer* rMeasureServer = RMeasureServer::instance();
+
+    const std::vector<marker::Invocation> invocations = rMeasureServer->invocations();
+    for (std::size_t i = 0; i < invocations.size(); ++i) {
+        if ((int)invocations[i].session == session)
+            arrayData.push_back(xmlrpc_c::value_int(i));
+    }
+
+    Log(rMeasureServer->logFile(), "Send the invocations of session " + std::to_string(session));
     *retvalP = xmlrpc_c::value_array(arrayData);
 }
+
+GetSessionResults::GetSessionResults()
+{
+    this->_signature = "S:i";
+    this->_help = "This method will send the results of a stopped or closed session, kept after the next listenings: "
+                  "the kernel names (names), the name index of each invocation (ids), the invocations and the measured data of the methods (rapl, timer, perf), "
+                  "in the order of the invocations of the session";
+}
+
+void GetSessionResults::execute(xmlrpc_c::paramList const& paramList, xmlrpc_c::value* const retvalP)
+{
+    const int session = paramList.getInt(0);
+    paramList.verifyEnd(1);
+
+    RMeasureServer* rMeasureServer = RMeasureServer::instance();
+    Log(rMeasureServer->logFile(), "Send the results of session " + std::to_string(session));
+    *retvalP = rMeasureServer->sessionResults(session);
+}
+
+GetListenerStatistics::GetListenerStatistics()
+{
+    this->_signature = "S:";
+    this->_help = "This method will send the cost of the last listening (records, invocations, dropped markers, skipped ring slots, elapsed and CPU time of the listener in ns)";
+}
+
+void GetListenerStatistics::execute(xmlrpc_c::paramList const& paramList, xmlrpc_c::value* const retvalP)
+{
+    RMeasureServer* rMeasureServer = RMeasureServer::instance();
+    const marker::ListenerStatistics& statistics = rMeasureServer->listenerStatistics();
+
+    // the counters may not fit into the 32 bit integers of XML-RPC
+    std::map<std::string, xmlrpc_c::value> statisticsData;
+    statisticsData.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("records"), xmlrpc_c::value_double(statistics.records)));
+    statisticsData.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("invocations"), xmlrpc_c::value_double(rMeasureServer->invocationCount())));
+    statisticsData.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("dropped"), xmlrpc_c::value_double(statistics.dropped)));
+    statisticsData.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("skipped"), xmlrpc_c::value_double(statistics.skipped)));
+    statisticsData.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("elapsedTime"), xmlrpc_c::value_double(statistics.elapsedTime)));
+    statisticsData.insert(std::pair<std::string, xmlrpc_c::value>(xmlrpc_c::value_string("cpuTime"), xmlrpc_c::value_double(statistics.cpuTime)));
+
+    Log(rMeasureServer->logFile(), "Send the statistics of the listener");
+    *retvalP = xmlrpc_c::value_struct(statisticsData);
+}
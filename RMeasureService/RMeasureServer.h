@@ -33,9 +33,21 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <xmlrpc-c/base.hpp>
 #include <xmlrpc-c/registry.hpp>
 #include <xmlrpc-c/server_abyss.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
 #include <vector>
 
+#include "Marker.h"
+#include "MarkerRing.h"
+#include "MarkerSocket.h"
+
 #ifdef RAPL
+#include "MsrEnergySource.h"
+#include "PowercapEnergySource.h"
+#include "PerfEnergySource.h"
+#include "Topology.h"
 #include "RaplCounter.h"
 #endif
 
@@ -43,6 +55,11 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "TimerCounter.h"
 #endif
 
+#ifdef PERF
+#include "Topology.h"
+#include "PerfCounter.h"
+#endif
+
 class StartRaplListening : public xmlrpc_c::method {
 public:
     StartRaplListening();
@@ -79,6 +96,24 @@ class GetMeasuredProcessors : public xmlrpc_c::method {
         void execute(xmlrpc_c::paramList const& paramList, xmlrpc_c::value* const retvalP);
 };
 
+class GetMeasuredDomains : public xmlrpc_c::method {
+    public:
+        GetMeasuredDomains();
+        void execute(xmlrpc_c::paramList const& paramList, xmlrpc_c::value* const retvalP);
+};
+
+class GetPowerTrace : public xmlrpc_c::method {
+    public:
+        GetPowerTrace();
+        void execute(xmlrpc_c::paramList const& paramList, xmlrpc_c::value* const retvalP);
+};
+
+class GetSamplingRate : public xmlrpc_c::method {
+    public:
+        GetSamplingRate();
+        void execute(xmlrpc_c::paramList const& paramList, xmlrpc_c::value* const retvalP);
+};
+
 class StartTimerListening : public xmlrpc_c::method {
 public:
     StartTimerListening();
@@ -104,30 +139,129 @@ class GetMeasuredSystemId : public xmlrpc_c::method {
         void execute(xmlrpc_c::paramList const& paramList, xmlrpc_c::value* const retvalP);
 };
 
+class GetMeasuredTimes : public xmlrpc_c::method {
+    public:
+        GetMeasuredTimes();
+        void execute(xmlrpc_c::paramList const& paramList, xmlrpc_c::value* const retvalP);
+};
+
+class StartPerfListening : public xmlrpc_c::method {
+public:
+    StartPerfListening();
+    void execute(xmlrpc_c::paramList const& paramList, xmlrpc_c::value* const retvalP);
+};
+
+class StopPerfListening: public xmlrpc_c::method {
+public:
+    StopPerfListening();
+    void execute(xmlrpc_c::paramList const& paramList, xmlrpc_c::value* const retvalP);
+};
+
+class GetPerfMeasuredData : public xmlrpc_c::method {
+public:
+    GetPerfMeasuredData();
+    void execute(xmlrpc_c::paramList const& paramList, xmlrpc_c::value* const retvalP);
+};
+
+class GetPerfMeasuredComponents : public xmlrpc_c::method {
+    public:
+        GetPerfMeasuredComponents();
+        void execute(xmlrpc_c::paramList const& paramList, xmlrpc_c::value* const retvalP);
+};
+
+class GetPerfMeasuredEvents : public xmlrpc_c::method {
+    public:
+        GetPerfMeasuredEvents();
+        void execute(xmlrpc_c::paramList const& paramList, xmlrpc_c::value* const retvalP);
+};
+
 class GetMeasuredKernels : public xmlrpc_c::method {
     public:
         GetMeasuredKernels();
         void execute(xmlrpc_c::paramList const& paramList, xmlrpc_c::value* const retvalP);
 };
 
+class GetKernelInvocations : public xmlrpc_c::method {
+    public:
+        GetKernelInvocations();
+        void execute(xmlrpc_c::paramList const& paramList, xmlrpc_c::value* const retvalP);
+};
+
+class GetSessions : public xmlrpc_c::method {
+    public:
+        GetSessions();
+        void execute(xmlrpc_c::paramList const& paramList, xmlrpc_c::value* const retvalP);
+};
+
+class GetSessionInvocations : public xmlrpc_c::method {
+    public:
+        GetSessionInvocations();
+        void execute(xmlrpc_c::paramList const& paramList, xmlrpc_c::value* const retvalP);
+};
+
+class GetSessionResults : public xmlrpc_c::method {
+    public:
+        GetSessionResults();
+        void execute(xmlrpc_c::paramList const& paramList, xmlrpc_c::value* const retvalP);
+};
+
+class GetListenerStatistics : public xmlrpc_c::method {
+    public:
+        GetListenerStatistics();
+        void execute(xmlrpc_c::paramList const& paramList, xmlrpc_c::value* const retvalP);
+};
+
 class RMeasureServer {
-    std::vector<std::string> m_measuredKernels;
-    bool m_isListeningEnabled;
+    std::vector<std::string> m_kernelNames; ///< the interned kernel names, indexed by the kernel ids of the service
+    std::map<std::string, uint32_t> m_kernelIds; ///< the kernel id of each interned name
+    std::map<std::pair<uint32_t, uint32_t>, uint32_t> m_registeredKernels; ///< (pid, kernel id of the producer) -> kernel id of the service
+    std::vector<uint32_t> m_measuredKernels; ///< the kernel id of each measured invocation
+    std::vector<marker::Invocation> m_invocations; ///< nesting and producer of each measured kernel
+    std::map<marker::Producer, std::vector<std::size_t> > m_openKernels; ///< stacks of the open kernel regions of each producer
+    std::size_t m_openCount; ///< number of the open kernel regions of all producers
+    std::size_t m_scopeInvocation; ///< the invocation which raised the parallel port pin
+    marker::Timestamp m_listenStart; ///< start of the listening, older batched markers are dropped
+    std::atomic<bool> m_isListeningEnabled;
+    int m_wakeFd; ///< eventfd of the listener loop, signalled when a command is waiting
+    std::mutex m_commandMutex; ///< guards m_commands, m_wakeFd and the start and the end of the listening
+    std::condition_variable m_commandDone; ///< notified when the listener processed m_commands
+    std::vector<char> m_commands; ///< stop commands waiting for the listener ('S'cope, 'R'apl, 'T'imer, 'P'erf)
     bool m_scopeListening;
     bool m_raplListening;
     bool m_timerListening;
+    bool m_perfListening;
 #ifdef RAPL
     rapl::RaplCounter* m_raplCounter;
 #endif
 #ifdef TIMER
     timer::TimerCounter* m_timerCounter;
 #endif
+#ifdef PERF
+    perf::PerfCounter* m_perfCounter;
+#endif
 #ifdef SCOPE
     unsigned int m_parallelPortAddress;
 #endif
     unsigned int m_portNumber;
     std::string m_logFile;
     std::string m_fifoName;
+    std::string m_ringName; ///< shm_open() name of the marker ring, empty disables the ring
+    unsigned int m_ringSize; ///< number of slots in the marker ring
+    marker::MarkerRing* m_markerRing;
+    std::string m_socketName; ///< path of the marker socket, empty disables the socket
+    marker::MarkerSocket* m_markerSocket;
+    std::vector<marker::Session> m_sessions; ///< the sessions of the marker socket (the closed ones until the next listening)
+    uint32_t m_lastSession; ///< the id of the last accepted session
+    std::map<uint32_t, xmlrpc_c::value> m_sessionResults; ///< the results of the stopped and the closed sessions, by their ids
+    /**
+     * Guards the kernel names, the invocations, the sessions and the session
+     * results: the listener adds to them while the xmlrpc methods read them.
+     */
+    mutable std::mutex m_resultsMutex;
+    marker::ListenerStatistics m_listenerStatistics;
+    marker::Timestamp m_listenCpuStart; ///< CPU time of the listener thread at the start of the listening
+    uint64_t m_droppedStart; ///< the markers dropped by the ring before the listening
+    uint64_t m_skippedStart; ///< the slots skipped by the ring before the listening
     unsigned int m_keepaliveTimeout;
     unsigned int m_keepaliveMaxConn;
     unsigned int m_timeout;
@@ -141,11 +275,57 @@ class RMeasureServer {
     RMeasureServer(const RMeasureServer&) = delete;
     void operator=(const RMeasureServer&)  = delete;
 
+    uint32_t internKernel(const std::string& kernelName);
+    void registerKernel(uint32_t pid, uint32_t kernel, const std::string& kernelName);
+    uint32_t registeredKernel(uint32_t pid, uint32_t kernel);
+    /**
+     * Open a kernel invocation of the producer. Batched markers arrive late,
+     * so they are measured by the timer only, they don't touch the parallel
+     * port pin and the RAPL readings. cpuTimes are the CPU times of the
+     * producer thread carried by the marker, NULL if it has none.
+     */
+    void beginKernel(uint32_t kernel, const marker::Producer& producer, marker::Timestamp time, double weight, bool batched = false, uint32_t session = 0, const marker::CpuTimes* cpuTimes = NULL);
+    void endKernel(const marker::Producer& producer, marker::Timestamp time, const marker::CpuTimes* cpuTimes = NULL);
+    void processMessage(const std::string& msg);
+    void processRecord(const RMeasureRecord& record, uint32_t session = 0);
+    void readFifo(int fd, std::string& pending);
+    void drainRing();
+    /** Accept the waiting connections of the marker socket, and add them to the listener loop (epollFd >= 0). */
+    void acceptSessions(int epollFd);
+    /**
+     * Process the waiting records of a session, only the registrations if
+     * registrationsOnly is set. A closed session is marked with fd -1.
+     */
+    void readSession(marker::Session& session, bool registrationsOnly = false);
+    void readSessions();
+    /**
+     * A stop command of a session stops its measurement only: the method is
+     * stopped when no other connected session is measured.
+     */
+    void stopSession(uint32_t session, char method);
+    /** Store the results of a session in m_sessionResults, they are kept after the next listening. */
+    void archiveSession(marker::Session& session);
+    void applyCommand(char method);
+    void applyCommands();
+    /** Update the times and the drops of m_listenerStatistics, called by the listener thread. */
+    void updateListenerStatistics();
+
 public:
     static RMeasureServer* instance();
     static void deleteInstance();
 
-    const std::vector<std::string>& measuredKernels();
+    /*
+     * The listener adds to the kernels, the invocations and the sessions
+     * while they are read, so they are copied under m_resultsMutex.
+     */
+    std::vector<std::string> kernelNames() const;
+    std::vector<uint32_t> measuredKernels() const;
+    std::vector<marker::Invocation> invocations() const;
+    std::size_t invocationCount() const;
+    std::vector<marker::Session> sessions() const;
+    /** The results of a stopped or closed session, an empty struct for an unknown one. */
+    xmlrpc_c::value sessionResults(uint32_t session) const;
+    const marker::ListenerStatistics& listenerStatistics();
     bool isListening();
     const std::string& logFile();
     bool create(const std::string& configName = "");
@@ -165,9 +345,18 @@ public:
     const bool& isTimerListening();
     const timer::TimerCounter* timerCounter() const;
 #endif
-
-void callFifo(const char* msg);
-
+#ifdef PERF
+    /** Start or stop the performance counters, they are not started if their groups can't be opened. */
+    void perfListening(const bool enabled);
+    const bool& isPerfListening();
+    const perf::PerfCounter* perfCounter() const;
+#endif
+    /**
+     * Stop the measurement of a method ('S'cope, 'R'apl, 'T'imer or 'P'erf). While
+     * listening, the command is an event of the listener loop: the markers
+     * received before it are processed first, and the call waits for it.
+     */
+    void stopListening(char method);
 };
 
 #endif //RMEASURESERVER_H_INCLUDED
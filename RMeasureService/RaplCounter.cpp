@@ -27,44 +27,78 @@ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
 SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
-#include <fcntl.h>
-#include <math.h>
-#include <unistd.h>
-#include <stdlib.h>
+#include <algorithm>
 
 #include "RaplCounter.h"
 
 namespace rapl {
 
+static const char* const DOMAIN_NAMES[DOMAIN_COUNT] = { "package", "pp0", "pp1", "dram", "psys" };
+
+/** Marks the regions of m_openKernels which are not measured (see RaplCounter::skip()). */
+static const std::size_t SKIPPED_REGION = (std::size_t)-1;
+
+#define UPDATE_MIN_PERIOD_NS 10000000ull ///< the counters are not read more often than 100 Hz by the overflow guard
+#define UPDATE_MAX_PERIOD_NS 60000000000ull ///< nor less often than once a minute
+#define UNKNOWN_POWER_LIMIT_W 1000.0 ///< the power assumed if the source doesn't know the limit of a package
+#define WRAP_SAFETY_FACTOR 4 ///< the counters are read this many times during the shortest wraparound time
+#define ALIGN_TIMEOUT_NS 5000000ull ///< a boundary of the precise mode doesn't wait longer for a counter update
+#define UPDATE_POINT_COUNT 64 ///< the precise mode keeps this many counter updates of each socket for the late markers
+
+const char* domainName(Domain domain)
+{
+    return domain < DOMAIN_COUNT ? DOMAIN_NAMES[domain] : "";
+}
+
 MeasurementData::MeasurementData() :
-    m_lastPackageEnergyRaw(0.0),
-    m_lastTime(),
-    m_calculatedPackageEnergy(0.0),
-    m_calculatedElapsedTime(0)
+    m_startTime(0),
+    m_calculatedElapsedTime(0),
+    m_readSkew(0),
+    m_alignWait(0)
 {
+    for (int i = 0; i < DOMAIN_COUNT; ++i) {
+        m_startEnergy[i] = 0.0;
+        m_calculatedEnergy[i] = 0.0;
+    }
 }
 
-uint64_t diff_ms(timespec end, timespec start)
+void MeasurementData::begin(const double* energies, marker::Timestamp time, uint64_t readSkew, uint64_t alignWait)
 {
-    // return in nanosec
-    return BILLION * (end.tv_sec - start.tv_sec) + end.tv_nsec - start.tv_nsec;
+    for (int i = 0; i < DOMAIN_COUNT; ++i)
+        m_startEnergy[i] = energies[i];
+    m_startTime = time;
+    m_readSkew = readSkew;
+    m_alignWait = alignWait;
+}
 
+void MeasurementData::end(const double* energies, marker::Timestamp time, uint64_t readSkew, uint64_t alignWait)
+{
+    // in nanosec
+    m_calculatedElapsedTime = time > m_startTime ? time - m_startTime : 0;
+    for (int i = 0; i < DOMAIN_COUNT; ++i)
+        m_calculatedEnergy[i] = energies[i] - m_startEnergy[i];
+    m_readSkew = std::max(m_readSkew, readSkew);
+    m_alignWait += alignWait;
 }
 
-void MeasurementData::gainCapabilites(const long long& pkgEnergyStatus, const double& energyUnits, const timespec& currentTime)
+const double& MeasurementData::packageEnergy() const
 {
-    double packageEnergyRaw = (double)pkgEnergyStatus*energyUnits;
-    if (m_lastPackageEnergyRaw > packageEnergyRaw)
-        m_calculatedPackageEnergy += (((double)(pow(2,32)-1)*energyUnits)-m_lastPackageEnergyRaw)+packageEnergyRaw;
-    else
-        m_calculatedPackageEnergy += packageEnergyRaw - m_lastPackageEnergyRaw;
+    return m_calculatedEnergy[DOMAIN_PACKAGE];
+}
 
-    m_calculatedElapsedTime += diff_ms(currentTime, m_lastTime);
+const double& MeasurementData::packageStartEnergy() const
+{
+    return m_startEnergy[DOMAIN_PACKAGE];
 }
 
-const double& MeasurementData::packageEnergy() const
+const double& MeasurementData::energy(Domain domain) const
 {
-    return m_calculatedPackageEnergy;
+    return m_calculatedEnergy[domain];
+}
+
+const marker::Timestamp& MeasurementData::startTime() const
+{
+    return m_startTime;
 }
 
 const uint64_t& MeasurementData::elapsedTime() const
@@ -72,107 +106,374 @@ const uint64_t& MeasurementData::elapsedTime() const
     return m_calculatedElapsedTime;
 }
 
-RaplCounter::RaplCounter(std::vector<Processor> processors) :
-    m_kernelList(),
-    m_processors(processors)
+const uint64_t& MeasurementData::readSkew() const
+{
+    return m_readSkew;
+}
+
+const uint64_t& MeasurementData::alignWait() const
 {
+    return m_alignWait;
 }
 
-void MeasurementData::setLastTime(const timespec& time)
+double DomainEnergy::countsAt(marker::Timestamp at) const
 {
-    m_lastTime = time;
+    if (at >= time || time <= previousTime)
+        return (double)extendedCounter;
+    if (at <= previousTime)
+        return (double)previousCounter;
+    return (double)previousCounter + (double)(extendedCounter - previousCounter) * (double)(at - previousTime) / (double)(time - previousTime);
 }
 
-void MeasurementData::setLastPackageEnergy(const double& energy)
+RaplCounter::RaplCounter(std::vector<Processor> processors, EnergySource* source) :
+    m_kernelList(),
+    m_kernels(),
+    m_processors(processors),
+    m_source(source),
+    m_sourceMutex(),
+    m_sampler(NULL),
+    m_readers(NULL),
+    m_counters(processors.size() * DOMAIN_COUNT),
+    m_readTimes(processors.size()),
+    m_readSkew(0),
+    m_droppedReadings(0),
+    m_isPrecise(false),
+    m_alignCounters(processors.size() * DOMAIN_COUNT),
+    m_alignTimes(processors.size()),
+    m_sockets(processors.size(), std::vector<DomainEnergy>(source->domains().size(), DomainEnergy())),
+    m_updatePoints(processors.size()),
+    m_openKernels(),
+    m_openCount(0),
+    m_isStarted(false),
+    m_blockTime(10000000),
+    m_resamples(1000)
 {
-    m_lastPackageEnergyRaw = energy;
 }
 
-void RaplCounter::calculate(bool isBegin)
+void RaplCounter::readComponents(uint64_t* counters, marker::Timestamp* times)
 {
-    if (isBegin) {
-        MeasurementMap measurements;
-        std::vector<Processor>::iterator procIt = m_processors.begin();
-        for (; procIt != m_processors.end(); ++procIt) {
-            MeasurementData measurementData;
-            measurements.insert(std::pair<Processor, MeasurementData>(*procIt, measurementData));
+    std::lock_guard<std::mutex> lock(m_sourceMutex);
+    if (m_readers) {
+        m_readers->read(counters, times);
+    }
+    else {
+        for (std::size_t i = 0; i < m_processors.size(); ++i) {
+            const bool isRead = m_source->read(i, &counters[i * DOMAIN_COUNT]);
+            times[i] = isRead ? marker::now() : 0;
         }
-        m_kernelList.push_back(measurements);
     }
+}
 
-    MeasurementMap::iterator measurementIt = m_kernelList.back().begin();
-    for (; measurementIt != m_kernelList.back().end(); ++measurementIt) {
-        int core = measurementIt->first.second;
-        long long msrResult = readMSR(core, MSR_RAPL_POWER_UNIT);
-        double energyUnits = pow(0.5,(double)((msrResult>>8)&0x1f));
-        msrResult = readMSR(core, MSR_PKG_ENERGY_STATUS);
+void RaplCounter::extend(std::size_t socket, const uint64_t* counters, marker::Timestamp time)
+{
+    for (std::size_t i = 0; i < m_source->domains().size(); ++i) {
+        const uint64_t counter = counters[i];
+        DomainEnergy& domain = m_sockets[socket][i];
+
+        // one wraparound of the counter of each domain is handled, see updatePeriod()
+        if (m_isStarted && domain.time != 0) {
+            const uint64_t range = m_source->counterRange(socket, i);
+            uint64_t delta = counter - domain.lastCounter;
+            if (range != 0 && counter < domain.lastCounter)
+                delta = counter + (range - domain.lastCounter);
+            domain.previousCounter = domain.extendedCounter;
+            domain.previousTime = domain.time;
+            domain.extendedCounter += delta;
+        }
+        else {
+            domain.extendedCounter = 0;
+            domain.previousCounter = 0;
+            domain.previousTime = time;
+        }
+        domain.time = time;
+        domain.lastCounter = counter;
+    }
+}
 
-        timespec currentTime;
-        clock_gettime(CLOCK_MONOTONIC, &currentTime);  /* mark start time */
+uint64_t RaplCounter::readAligned(marker::Timestamp time)
+{
+    const marker::Timestamp start = marker::now();
+
+    // a socket needs an update after the marker, and two updates to interpolate between,
+    // the late markers (e.g. the end of a kernel shorter than the update interval) are already covered
+    std::vector<std::size_t> missing(m_processors.size(), 0);
+    std::size_t pending = 0;
+    for (std::size_t i = 0; i < m_processors.size(); ++i) {
+        const std::deque<UpdatePoint>& points = m_updatePoints[i];
+        if (points.empty() || points.back().time <= time)
+            missing[i] = 1;
+        if (points.size() + missing[i] < 2)
+            missing[i] = 2 - points.size();
+        if (missing[i] > 0)
+            ++pending;
+    }
 
-        if (!isBegin)
-            measurementIt->second.gainCapabilites(msrResult, energyUnits, currentTime);
+    // the first reading of a component after its package counter (the first domain) changed belongs to the time of the update
+    while (pending > 0 && marker::now() - start < ALIGN_TIMEOUT_NS) {
+        readComponents(&m_alignCounters[0], &m_alignTimes[0]);
+        for (std::size_t i = 0; i < m_processors.size(); ++i) {
+            const uint64_t* counters = &m_alignCounters[i * DOMAIN_COUNT];
+            if (missing[i] == 0 || m_alignTimes[i] == 0 || counters[0] == m_sockets[i][0].lastCounter)
+                continue;
+            extend(i, counters, m_alignTimes[i]);
+
+            UpdatePoint point;
+            point.time = m_alignTimes[i];
+            for (std::size_t j = 0; j < m_sockets[i].size(); ++j)
+                point.counters[j] = m_sockets[i][j].extendedCounter;
+            m_updatePoints[i].push_back(point);
+            if (m_updatePoints[i].size() > UPDATE_POINT_COUNT)
+                m_updatePoints[i].pop_front();
+            if (--missing[i] == 0)
+                --pending;
+        }
+    }
+    return marker::now() - start;
+}
 
-        measurementIt->second.setLastPackageEnergy((double)msrResult*energyUnits);
-        measurementIt->second.setLastTime(currentTime);
+uint64_t RaplCounter::sample(bool aligned, marker::Timestamp time)
+{
+    if (m_processors.empty())
+        return 0;
+    readComponents(&m_counters[0], &m_readTimes[0]);
+    marker::Timestamp first = 0;
+    marker::Timestamp last = 0;
+    for (std::size_t i = 0; i < m_processors.size(); ++i) {
+        // the reading of a socket which couldn't be read is dropped
+        if (m_readTimes[i] == 0)
+            continue;
+        extend(i, &m_counters[i * DOMAIN_COUNT], m_readTimes[i]);
+        first = first == 0 ? m_readTimes[i] : std::min(first, m_readTimes[i]);
+        last = std::max(last, m_readTimes[i]);
     }
+    m_readSkew = last - first;
+    m_isStarted = true;
+
+    if (aligned && !m_source->domains().empty())
+        return readAligned(time);
+    return 0;
 }
 
-void RaplCounter::startMeasurement()
+double RaplCounter::countsAt(std::size_t socket, std::size_t domain, marker::Timestamp time) const
 {
-    m_kernelList.clear();
+    const std::deque<UpdatePoint>& points = m_updatePoints[socket];
+    if (!m_isPrecise || points.size() < 2 || time >= points.back().time)
+        return m_sockets[socket][domain].countsAt(time);
+
+    // between the updates around the time, before the oldest one the power of the first interval is taken
+    std::size_t after = 1;
+    while (after + 1 < points.size() && points[after].time <= time)
+        ++after;
+    const UpdatePoint& previous = points[after - 1];
+    const UpdatePoint& next = points[after];
+    if (next.time <= previous.time)
+        return (double)next.counters[domain];
+    const double counts = (double)(next.counters[domain] - previous.counters[domain]);
+    return (double)previous.counters[domain] + counts * ((double)time - (double)previous.time) / (double)(next.time - previous.time);
 }
 
-const KernelList& RaplCounter::kernelList() const
+void RaplCounter::energiesAt(std::size_t socket, marker::Timestamp time, double* energies) const
 {
-    return m_kernelList;
+    const std::vector<Domain>& domains = m_source->domains();
+    for (int i = 0; i < DOMAIN_COUNT; ++i)
+        energies[i] = 0.0;
+    for (std::size_t i = 0; i < domains.size(); ++i)
+        energies[domains[i]] = countsAt(socket, i, time) * m_source->energyUnit(socket, i);
 }
 
-const std::vector<Processor>& RaplCounter::processors() const
+void RaplCounter::begin(const marker::Producer& producer, uint32_t kernel, marker::Timestamp time)
 {
-    return m_processors;
+    const uint64_t alignWait = sample(m_isPrecise, time);
+
+    MeasurementMap measurements;
+    for (std::size_t i = 0; i < m_processors.size(); ++i) {
+        if (m_readTimes[i] == 0) {
+            ++m_droppedReadings;
+            continue;
+        }
+        double energies[DOMAIN_COUNT];
+        energiesAt(i, time, energies);
+        MeasurementData measurementData;
+        measurementData.begin(energies, time, m_readSkew, alignWait);
+        measurements.insert(std::pair<Processor, MeasurementData>(m_processors[i], measurementData));
+    }
+    m_openKernels[producer].push_back(m_kernelList.size());
+    ++m_openCount;
+    m_kernelList.push_back(measurements);
+    m_kernels.push_back(kernel);
 }
 
-RaplCounter::~RaplCounter()
+void RaplCounter::skip(const marker::Producer& producer, uint32_t kernel)
 {
+    m_openKernels[producer].push_back(SKIPPED_REGION);
+    m_kernelList.push_back(MeasurementMap());
+    m_kernels.push_back(kernel);
 }
 
-int RaplCounter::openMSR(int core)
+void RaplCounter::end(const marker::Producer& producer, marker::Timestamp time)
 {
-    char msr_filename[BUFSIZ];
-    int fd = -1;
+    std::vector<std::size_t>& openKernels = m_openKernels[producer];
+    if (openKernels.empty())
+        return;
+    if (openKernels.back() == SKIPPED_REGION) {
+        openKernels.pop_back();
+        return;
+    }
 
-    sprintf(msr_filename, "/dev/cpu/%d/msr", core);
-    fd = open(msr_filename, O_RDONLY);
-    if ( fd < 0 ) {
-        if ( errno == ENXIO ) {
-              fprintf(stderr, "rdmsr: No CPU %d\n", core);
-        } else if ( errno == EIO ) {
-              fprintf(stderr, "rdmsr: CPU %d doesn't support MSRs\n", core);
-        } else {
-              perror("rdmsr:open");
-              fprintf(stderr,"Trying to open %s\n",msr_filename);
+    const uint64_t alignWait = sample(m_isPrecise, time);
+
+    MeasurementMap& measurements = m_kernelList[openKernels.back()];
+    openKernels.pop_back();
+    --m_openCount;
+    for (std::size_t i = 0; i < m_processors.size(); ++i) {
+        MeasurementMap::iterator measurementIt = measurements.find(m_processors[i]);
+        if (measurementIt == measurements.end())
+            continue;
+        if (m_readTimes[i] == 0) {
+            ++m_droppedReadings;
+            measurements.erase(measurementIt);
+            continue;
         }
+        double energies[DOMAIN_COUNT];
+        energiesAt(i, time, energies);
+        measurementIt->second.end(energies, time, m_readSkew, alignWait);
     }
-
-    return fd;
 }
 
+void RaplCounter::update()
+{
+    // the counters are extended from the first region of the measurement
+    if (m_isStarted)
+        sample();
+}
 
-long long RaplCounter::readMSR(int core, int which)
+marker::Timestamp RaplCounter::updatePeriod() const
 {
-    uint64_t data = 0;
-    int fd = openMSR(core);
-    if (fd > -1)
-    {
-        if ( pread(fd, &data, sizeof data, which) != sizeof data ) {
-            perror("rdmsr:pread");
-            close(fd);
-            exit(EXIT_FAILURE);
+    marker::Timestamp period = 0;
+    for (std::size_t i = 0; i < m_processors.size(); ++i) {
+        const double powerLimit = m_source->powerLimit(i) > 0.0 ? m_source->powerLimit(i) : UNKNOWN_POWER_LIMIT_W;
+        for (std::size_t j = 0; j < m_source->domains().size(); ++j) {
+            const uint64_t range = m_source->counterRange(i, j);
+            if (range == 0)
+                continue;
+            // the other domains are assumed not to draw more than their package
+            const double wrapTime = (double)range * m_source->energyUnit(i, j) / powerLimit * BILLION;
+            const marker::Timestamp domainPeriod = (marker::Timestamp)std::min(std::max(wrapTime / WRAP_SAFETY_FACTOR, (double)UPDATE_MIN_PERIOD_NS), (double)UPDATE_MAX_PERIOD_NS);
+            if (period == 0 || domainPeriod < period)
+                period = domainPeriod;
         }
-        close(fd);
     }
-    return (long long)data;
+    return period;
+}
+
+void RaplCounter::setSampling(double rate, std::size_t traceSize, marker::Timestamp window)
+{
+    delete m_sampler;
+    m_sampler = NULL;
+    if (rate > 0.0 && !m_source->domains().empty())
+        m_sampler = new RaplSampler(m_source, m_sourceMutex, m_processors.size(), rate, traceSize, window);
+}
+
+const RaplSampler* RaplCounter::sampler() const
+{
+    return m_sampler;
+}
+
+void RaplCounter::setRepeated(double blockTime, std::size_t resamples)
+{
+    m_blockTime = (uint64_t)(blockTime * BILLION);
+    m_resamples = resamples;
+}
+
+RepeatedEnergy RaplCounter::repeatedEnergy(uint32_t kernel, std::size_t socket) const
+{
+    std::vector<RepeatedInvocation> invocations;
+    for (std::size_t i = 0; i < m_kernelList.size(); ++i) {
+        if (m_kernels[i] != kernel)
+            continue;
+        MeasurementMap::const_iterator measurementIt = m_kernelList[i].find(m_processors[socket]);
+        if (measurementIt == m_kernelList[i].end())
+            continue;
+        const MeasurementData& measurement = measurementIt->second;
+        RepeatedInvocation invocation;
+        invocation.startTime = measurement.startTime();
+        invocation.elapsedTime = measurement.elapsedTime();
+        invocation.startEnergy = measurement.packageStartEnergy();
+        invocation.endEnergy = measurement.packageStartEnergy() + measurement.packageEnergy();
+        invocations.push_back(invocation);
+    }
+    return estimateRepeated(invocations, m_blockTime, m_resamples);
+}
+
+void RaplCounter::setReaders(const std::vector<std::vector<std::size_t> >& groups, const std::string& logFile)
+{
+    delete m_readers;
+    m_readers = NULL;
+    std::vector<int> cpus;
+    for (std::size_t i = 0; i < groups.size(); ++i)
+        cpus.push_back(groups[i].empty() ? 0 : m_processors[groups[i].front()].second);
+    if (!groups.empty())
+        m_readers = new RaplReaders(m_source, groups, cpus, logFile);
+}
+
+void RaplCounter::setPrecise(bool precise)
+{
+    m_isPrecise = precise;
+}
+
+void RaplCounter::startMeasurement()
+{
+    m_kernelList.clear();
+    m_kernels.clear();
+    m_openKernels.clear();
+    m_openCount = 0;
+    m_droppedReadings = 0;
+    m_isStarted = false;
+    // a socket which can't be read at the first reading starts at its first good one
+    for (std::size_t i = 0; i < m_sockets.size(); ++i)
+        std::fill(m_sockets[i].begin(), m_sockets[i].end(), DomainEnergy());
+    for (std::size_t i = 0; i < m_updatePoints.size(); ++i)
+        m_updatePoints[i].clear();
+    if (m_sampler)
+        m_sampler->start();
+}
+
+void RaplCounter::stopMeasurement()
+{
+    if (m_sampler)
+        m_sampler->stop();
+}
+
+const KernelList& RaplCounter::kernelList() const
+{
+    return m_kernelList;
+}
+
+std::size_t RaplCounter::droppedReadings() const
+{
+    return m_droppedReadings;
+}
+
+const std::vector<uint32_t>& RaplCounter::kernels() const
+{
+    return m_kernels;
+}
+
+const std::vector<Processor>& RaplCounter::processors() const
+{
+    return m_processors;
+}
+
+const std::vector<Domain>& RaplCounter::domains() const
+{
+    return m_source->domains();
+}
+
+RaplCounter::~RaplCounter()
+{
+    delete m_sampler;
+    delete m_readers;
+    delete m_source;
 }
 
 } // namespace rapl
@@ -30,35 +30,88 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef RAPLCOUNTER_H_INCLUDED
 #define RAPLCOUNTER_H_INCLUDED
 
+#include <deque>
 #include <map>
+#include <mutex>
+#include <string>
 #include <vector>
 #include <stdint.h> /* for uint64 definition */
-#include <time.h>   /* for clock_gettime */
 
-#define BILLION 1000000000L
+#include "Marker.h"
+#include "EnergySource.h"
+#include "RaplEstimator.h"
+#include "RaplReaders.h"
+#include "RaplSampler.h"
 
-#define MSR_RAPL_POWER_UNIT     0x606
-/* Package RAPL Domain */
-#define MSR_PKG_ENERGY_STATUS   0x611
+#define BILLION 1000000000L
 
 /**
  * Namespace for the Rapl implementation
  */
 namespace rapl {
 
+/**
+ * The energy and time of one kernel region on one socket.
+ */
 class MeasurementData {
-    double m_lastPackageEnergyRaw;
-    timespec m_lastTime;
-    double m_calculatedPackageEnergy;
+    double m_startEnergy[DOMAIN_COUNT];
+    marker::Timestamp m_startTime;
+    double m_calculatedEnergy[DOMAIN_COUNT];
     uint64_t m_calculatedElapsedTime;
+    uint64_t m_readSkew;
+    uint64_t m_alignWait;
 
 public:
     MeasurementData();
-    void gainCapabilites(const long long& pkgEnergyStatus, const double& energyUnits, const timespec& currentTime);
-    void setLastTime(const timespec& time);
-    void setLastPackageEnergy(const double& energy);
+    /**
+     * The energies are indexed by Domain, the ones of the domains which are
+     * not measured are 0. The read skew is the time between the first and
+     * the last reading of the components for this boundary, the align wait
+     * is the time spent waiting for a counter update (in nanosec).
+     */
+    void begin(const double* energies, marker::Timestamp time, uint64_t readSkew, uint64_t alignWait);
+    void end(const double* energies, marker::Timestamp time, uint64_t readSkew, uint64_t alignWait);
     const double& packageEnergy() const;
+    /** The package energy at the begin, counted from the start of the measurement. */
+    const double& packageStartEnergy() const;
+    const double& energy(Domain domain) const;
+    const marker::Timestamp& startTime() const;
     const uint64_t& elapsedTime() const;
+    /** The larger read skew of the two boundaries (in nanosec). */
+    const uint64_t& readSkew() const;
+    /** The time spent waiting for the counter updates at the two boundaries (in nanosec, 0 without the precise mode). */
+    const uint64_t& alignWait() const;
+};
+
+/**
+ * The energy counter of a RAPL domain of a socket, extended to 64 bits. The
+ * hardware counters wrap around, so they have to be read more often than
+ * they wrap (see RaplCounter::update()), the extended counter counts since
+ * the first reading of the measurement. The previous reading is kept to
+ * interpolate the counter at the marker timestamps.
+ */
+struct DomainEnergy {
+    uint64_t lastCounter; ///< the last raw value of the energy counter
+    uint64_t extendedCounter; ///< the counts since the first reading
+    marker::Timestamp time; ///< the time of the last reading
+    uint64_t previousCounter; ///< the extended counter at the previous reading
+    marker::Timestamp previousTime; ///< the time of the previous reading
+
+    /**
+     * The estimated extended counter at the given time. It is interpolated
+     * between the last two readings, and clamped to them outside of that interval.
+     */
+    double countsAt(marker::Timestamp at) const;
+};
+
+/**
+ * The extended counters of the measured domains of a socket (in the order of
+ * the source) right after an update of its package counter, see
+ * RaplCounter::setPrecise().
+ */
+struct UpdatePoint {
+    marker::Timestamp time;
+    uint64_t counters[DOMAIN_COUNT];
 };
 
 typedef std::pair<std::string, int> Processor;
@@ -67,20 +120,142 @@ typedef std::vector<MeasurementMap> KernelList;
 
 class RaplCounter {
     KernelList m_kernelList;
+    std::vector<uint32_t> m_kernels; ///< the kernel id of each region of m_kernelList
     std::vector<Processor> m_processors;
+    EnergySource* m_source; ///< the energy counters of the sockets, owned by the counter
+    std::mutex m_sourceMutex; ///< serializes the reads of the source with the sampler thread
+    RaplSampler* m_sampler; ///< the background sampler, NULL if it is disabled
+    RaplReaders* m_readers; ///< the pinned reader threads, NULL if the components are read one by one
+    std::vector<uint64_t> m_counters; ///< the counters of the last reading, [component][DOMAIN_COUNT]
+    std::vector<marker::Timestamp> m_readTimes; ///< the time of the last reading of each component
+    uint64_t m_readSkew; ///< the time between the first and the last component of the last reading
+    std::size_t m_droppedReadings; ///< the boundaries of the sockets whose counters couldn't be read
+    bool m_isPrecise; ///< specifies whether the boundaries wait for an update of the counters
+    std::vector<uint64_t> m_alignCounters; ///< the readings of the components while waiting for the update
+    std::vector<marker::Timestamp> m_alignTimes;
+    std::vector<std::vector<DomainEnergy> > m_sockets; ///< running energy of each measured domain of each processor (in the order of m_processors)
+    std::vector<std::deque<UpdatePoint> > m_updatePoints; ///< the last counter updates of each processor seen by the precise mode, oldest first
+    std::map<marker::Producer, std::vector<std::size_t> > m_openKernels; ///< stacks of the open regions of each producer (indices of m_kernelList)
+    std::size_t m_openCount; ///< number of the open regions of all producers
+    bool m_isStarted; ///< specifies whether m_sockets holds a valid reading
+    uint64_t m_blockTime; ///< the shortest block of the repeated-invocation estimator (in nanosec)
+    std::size_t m_resamples; ///< the number of the bootstrap resamples of the estimator
 
-    int openMSR(int core);
-    long long readMSR(int fd, int which);
+    /** Read the counters of every component, timestamped one by one (0 if a component couldn't be read). */
+    void readComponents(uint64_t* counters, marker::Timestamp* times);
+    /** Extend the counters of the domains of a socket in m_sockets with a reading of them. */
+    void extend(std::size_t socket, const uint64_t* counters, marker::Timestamp time);
+    /**
+     * Wait for the updates of the package counters of the sockets which have
+     * no update point after the marker time yet (or less than two of them),
+     * and record them in m_updatePoints. Returns the time spent waiting (in
+     * nanosec).
+     */
+    uint64_t readAligned(marker::Timestamp time);
+    /**
+     * Read the energy counters of the domains of every socket and extend them
+     * in m_sockets, then wait for the counter updates around the marker time
+     * if requested. Returns the time spent waiting for the updates. The
+     * sockets which couldn't be read keep their previous reading, their
+     * m_readTimes is 0.
+     */
+    uint64_t sample(bool aligned = false, marker::Timestamp time = 0);
+    /**
+     * The extended counter of a domain (index of the source) of a socket at
+     * the given time. The precise mode interpolates it between the update
+     * points around the time, otherwise it is DomainEnergy::countsAt().
+     */
+    double countsAt(std::size_t socket, std::size_t domain, marker::Timestamp time) const;
+    /** The energy of every domain of a socket at the given time, indexed by Domain. */
+    void energiesAt(std::size_t socket, marker::Timestamp time, double* energies) const;
 
 public:
-    RaplCounter(std::vector<Processor> processors);
+    /** The source reads the sockets in the order of the processors, the counter takes its ownership. */
+    RaplCounter(std::vector<Processor> processors, EnergySource* source);
     ~RaplCounter();
+    RaplCounter(const RaplCounter&) = delete;
+    void operator=(const RaplCounter&) = delete;
 
     const KernelList& kernelList() const;
+    /** The kernel id of each region of the kernel list. */
+    const std::vector<uint32_t>& kernels() const;
     const std::vector<Processor>& processors() const;
+    const std::vector<Domain>& domains() const;
+
+    /**
+     * Open a new (possibly nested) kernel region. The regions of different
+     * producers may overlap, each of them gets the whole energy of the
+     * sockets during its own time.
+     */
+    void begin(const marker::Producer& producer, uint32_t kernel, marker::Timestamp time);
+
+    /**
+     * Open a kernel region which is not measured, because its markers arrived
+     * in a batch, after the readings it would need. Its measurements are
+     * empty, the kernel list stays aligned with the invocations.
+     */
+    void skip(const marker::Producer& producer, uint32_t kernel);
+
+    /** Close the innermost open kernel region of the producer. */
+    void end(const marker::Producer& producer, marker::Timestamp time);
+
+    /**
+     * The boundaries of the sockets left out of the regions since the start
+     * of the measurement, because the counters of the socket couldn't be
+     * read: the region has no measurement on that socket.
+     */
+    std::size_t droppedReadings() const;
+
+    /** Read the sockets to keep the extended counters from missing a wraparound. */
+    void update();
+
+    /**
+     * The period of update() (in nanosec): a quarter of the time the fastest
+     * counter needs to wrap around at the power limit of its package, 0 if
+     * the counters don't wrap.
+     */
+    marker::Timestamp updatePeriod() const;
+
+    /**
+     * Sample the sockets at the rate (in Hz) on a background thread while
+     * measuring, keeping the last traceSize samples. 0 disables the sampler.
+     * The power statistics resolve the window (in nanosec, see RaplSampler).
+     */
+    void setSampling(double rate, std::size_t traceSize, marker::Timestamp window = 0);
+    /** The background sampler, NULL if it is disabled. */
+    const RaplSampler* sampler() const;
+
+    /**
+     * Read the components in parallel, each group (indices of the processors)
+     * by a thread pinned to the core of its first processor. The threads
+     * which can't be pinned are logged to the log file.
+     */
+    void setReaders(const std::vector<std::vector<std::size_t> >& groups, const std::string& logFile);
+
+    /**
+     * Take the energy at the marker times from the counter updates (about
+     * every millisecond) just before and just after them, instead of from
+     * readings at an arbitrary phase of the update interval. A boundary whose
+     * marker is newer than the last update seen waits for the next one, up
+     * to an update interval, without reading the other markers meanwhile.
+     * It improves the energy of the short kernels.
+     */
+    void setPrecise(bool precise);
+
+    /**
+     * The parameters of repeatedEnergy(): the shortest time spanned by a
+     * block of invocations (in sec), and the number of the resamples.
+     */
+    void setRepeated(double blockTime, std::size_t resamples);
+    /**
+     * The energy per invocation of a kernel (id) on a socket, estimated from
+     * all of its regions in the kernel list. The regions which are not
+     * measured are left out.
+     */
+    RepeatedEnergy repeatedEnergy(uint32_t kernel, std::size_t socket) const;
 
-    void calculate(bool isBegin = false);
     void startMeasurement();
+    void stopMeasurement();
 };
 
 } // namespace rapl
@@ -0,0 +1,150 @@
+/*
+Copyright (c) 2014-2017 University of Szeged
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software without
+   specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <algorithm>
+#include <random>
+
+#include "RaplEstimator.h"
+
+namespace rapl {
+
+#define BOOTSTRAP_SEED 5489u ///< the resampling is repeatable, the same invocations get the same interval
+#define CONFIDENCE_TAIL 0.025 ///< the probability of each tail outside of the confidence interval
+
+RepeatedEnergy::RepeatedEnergy() :
+    energy(0.0),
+    low(0.0),
+    high(0.0),
+    totalEnergy(0.0),
+    elapsedTime(0),
+    invocations(0),
+    blocks(0)
+{
+}
+
+/** The invocations of a block: its first begin and its last end, and the time spent in its invocations. */
+struct Block {
+    marker::Timestamp startTime;
+    double startEnergy;
+    marker::Timestamp endTime;
+    double endEnergy;
+    uint64_t busyTime;
+    std::size_t invocations;
+
+    double energy() const
+    {
+        const double energy = endEnergy - startEnergy;
+        if (endTime <= startTime)
+            return energy;
+        return energy * (double)busyTime / (double)(endTime - startTime);
+    }
+};
+
+static void addInvocation(Block& block, const RepeatedInvocation& invocation)
+{
+    const marker::Timestamp endTime = invocation.startTime + invocation.elapsedTime;
+    if (endTime >= block.endTime) {
+        block.endTime = endTime;
+        block.endEnergy = invocation.endEnergy;
+    }
+    block.busyTime += invocation.elapsedTime;
+    ++block.invocations;
+}
+
+RepeatedEnergy estimateRepeated(const std::vector<RepeatedInvocation>& invocations, uint64_t blockTime, std::size_t resamples)
+{
+    RepeatedEnergy result;
+    result.invocations = invocations.size();
+    if (invocations.empty())
+        return result;
+
+    // a short last block is added to the previous one
+    std::vector<Block> blocks;
+    bool isOpen = false;
+    for (std::size_t i = 0; i < invocations.size(); ++i) {
+        if (!isOpen) {
+            Block block;
+            block.startTime = invocations[i].startTime;
+            block.startEnergy = invocations[i].startEnergy;
+            block.endTime = block.startTime;
+            block.endEnergy = block.startEnergy;
+            block.busyTime = 0;
+            block.invocations = 0;
+            blocks.push_back(block);
+            isOpen = true;
+        }
+        addInvocation(blocks.back(), invocations[i]);
+        result.elapsedTime += invocations[i].elapsedTime;
+        if (blocks.back().endTime - blocks.back().startTime >= blockTime)
+            isOpen = false;
+    }
+    if (isOpen && blocks.size() > 1) {
+        Block& previous = blocks[blocks.size() - 2];
+        const Block& last = blocks.back();
+        if (last.endTime >= previous.endTime) {
+            previous.endTime = last.endTime;
+            previous.endEnergy = last.endEnergy;
+        }
+        previous.busyTime += last.busyTime;
+        previous.invocations += last.invocations;
+        blocks.pop_back();
+    }
+
+    std::vector<double> blockEnergies(blocks.size());
+    for (std::size_t i = 0; i < blocks.size(); ++i) {
+        blockEnergies[i] = blocks[i].energy();
+        result.totalEnergy += blockEnergies[i];
+    }
+    result.blocks = blocks.size();
+    result.energy = result.totalEnergy / result.invocations;
+    result.low = result.energy;
+    result.high = result.energy;
+    if (result.blocks < 2 || resamples == 0)
+        return result;
+
+    std::mt19937 generator(BOOTSTRAP_SEED);
+    std::uniform_int_distribution<std::size_t> block(0, result.blocks - 1);
+    std::vector<double> estimates(resamples);
+    for (std::size_t i = 0; i < resamples; ++i) {
+        double energy = 0.0;
+        std::size_t invocations = 0;
+        for (std::size_t j = 0; j < result.blocks; ++j) {
+            const std::size_t drawn = block(generator);
+            energy += blockEnergies[drawn];
+            invocations += blocks[drawn].invocations;
+        }
+        estimates[i] = energy / invocations;
+    }
+    std::sort(estimates.begin(), estimates.end());
+    result.low = estimates[(std::size_t)(CONFIDENCE_TAIL * (resamples - 1))];
+    result.high = estimates[(std::size_t)((1.0 - CONFIDENCE_TAIL) * (resamples - 1))];
+    return result;
+}
+
+} // namespace rapl
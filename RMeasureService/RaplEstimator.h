@@ -0,0 +1,85 @@
+/*
+Copyright (c) 2014-2017 University of Szeged
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software without
+   specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef RAPLESTIMATOR_H_INCLUDED
+#define RAPLESTIMATOR_H_INCLUDED
+
+#include <vector>
+#include <stdint.h>
+
+#include "Marker.h"
+
+namespace rapl {
+
+/** An invocation of a kernel on a socket, with the package energy read at its boundaries. */
+struct RepeatedInvocation {
+    marker::Timestamp startTime;
+    uint64_t elapsedTime; ///< in nanosec
+    double startEnergy; ///< the package energy at the begin marker, counted from the start of the measurement (in Joules)
+    double endEnergy; ///< the package energy at the end marker (in Joules)
+};
+
+/** The energy of one invocation of a kernel, estimated from its repeated invocations on a socket. */
+struct RepeatedEnergy {
+    double energy; ///< the energy per invocation (in Joules)
+    double low; ///< the lower bound of the 95% confidence interval of the energy (in Joules)
+    double high; ///< the upper bound of the interval (in Joules)
+    double totalEnergy; ///< the energy of all the invocations (in Joules)
+    uint64_t elapsedTime; ///< the time of all the invocations (in nanosec)
+    std::size_t invocations;
+    std::size_t blocks; ///< the number of the resampled blocks, the interval needs at least 2
+
+    RepeatedEnergy();
+};
+
+/**
+ * Estimate the energy of one invocation of a kernel which is much shorter
+ * than the update interval of the energy counters. The energy of a single
+ * invocation is either 0 or the energy of a whole update interval, so the
+ * invocations are measured together: the consecutive invocations are grouped
+ * into blocks spanning at least the block time (several counter updates), and
+ * the energy of a block is read at the begin of its first invocation and at
+ * the last end of its invocations. It has the error of these two readings,
+ * while the sum of the energies of the single invocations would add up the
+ * errors of all of their boundaries. The energy of the block is scaled by the
+ * time of its invocations over its span, which leaves out the gaps between
+ * the invocations at the average power of the block. The energy per
+ * invocation is the energy of the blocks divided by their invocations.
+ *
+ * The blocks are nearly independent, the confidence interval is the 2.5th and
+ * the 97.5th percentile of the energy per invocation of the blocks resampled
+ * with replacement.
+ *
+ * The invocations are in the order of their start times.
+ */
+RepeatedEnergy estimateRepeated(const std::vector<RepeatedInvocation>& invocations, uint64_t blockTime, std::size_t resamples);
+
+} // namespace rapl
+
+#endif // RAPLESTIMATOR_H_INCLUDED
@@ -0,0 +1,122 @@
+/*
+Copyright (c) 2014-2017 University of Szeged
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software without
+   specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "Log.h"
+#include "RaplReaders.h"
+
+namespace rapl {
+
+#define READER_SPIN_NS 50000ull ///< a thread spins this long for the next read() before it sleeps
+
+RaplReaders::RaplReaders(EnergySource* source, const std::vector<std::vector<std::size_t> >& groups, const std::vector<int>& cpus, const std::string& logFile) :
+    m_source(source),
+    m_groups(groups),
+    m_cpus(cpus),
+    m_logFile(logFile),
+    m_threads(),
+    m_mutex(),
+    m_wake(),
+    m_generation(0),
+    m_pending(0),
+    m_arrived(0),
+    m_isRunning(true),
+    m_counters(NULL),
+    m_times(NULL)
+{
+    for (std::size_t i = 0; i < m_groups.size(); ++i)
+        m_threads.push_back(std::thread(&RaplReaders::run, this, i));
+}
+
+RaplReaders::~RaplReaders()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_isRunning = false;
+    }
+    m_wake.notify_all();
+    for (std::size_t i = 0; i < m_threads.size(); ++i)
+        m_threads[i].join();
+}
+
+void RaplReaders::run(std::size_t reader)
+{
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(m_cpus[reader], &cpus);
+    if (pthread_setaffinity_np(pthread_self(), sizeof cpus, &cpus) != 0)
+        Log(m_logFile, "Couldn't pin the RAPL reader thread to cpu " + std::to_string(m_cpus[reader]));
+
+    const std::vector<std::size_t>& components = m_groups[reader];
+    uint64_t seen = 0;
+    while (true) {
+        uint64_t generation = m_generation.load(std::memory_order_acquire);
+        const marker::Timestamp spinEnd = marker::now() + READER_SPIN_NS;
+        while (generation == seen && m_isRunning && marker::now() < spinEnd)
+            generation = m_generation.load(std::memory_order_acquire);
+        if (generation == seen) {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&]() { return m_generation.load() != seen || !m_isRunning; });
+            generation = m_generation.load(std::memory_order_acquire);
+        }
+        if (!m_isRunning)
+            break;
+
+        // the barrier keeps the wake-up latency of the sleeping threads out of the read skew
+        seen = generation;
+        m_arrived.fetch_add(1, std::memory_order_acq_rel);
+        while (m_arrived.load(std::memory_order_acquire) != m_groups.size() && m_isRunning)
+            ;
+        for (std::size_t i = 0; i < components.size(); ++i) {
+            const bool isRead = m_source->read(components[i], m_counters + components[i] * DOMAIN_COUNT);
+            m_times[components[i]] = isRead ? marker::now() : 0;
+        }
+        m_pending.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+void RaplReaders::read(uint64_t* counters, marker::Timestamp* times)
+{
+    m_counters = counters;
+    m_times = times;
+    m_pending.store(m_threads.size(), std::memory_order_relaxed);
+    m_arrived.store(0, std::memory_order_relaxed);
+    {
+        // the sleeping threads check the generation under the mutex, they can't miss it
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_generation.fetch_add(1, std::memory_order_release);
+    }
+    m_wake.notify_all();
+    while (m_pending.load(std::memory_order_acquire) != 0)
+        sched_yield();
+}
+
+} // namespace rapl
@@ -0,0 +1,95 @@
+/*
+Copyright (c) 2014-2017 University of Szeged
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software without
+   specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef RAPLREADERS_H_INCLUDED
+#define RAPLREADERS_H_INCLUDED
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Marker.h"
+#include "EnergySource.h"
+
+namespace rapl {
+
+/**
+ * Reads the components of an EnergySource in parallel, with one thread
+ * pinned to a core of each package, so the counters of the packages are
+ * read at nearly the same moment and without cross-socket reads.
+ *
+ * The threads are released together by read() and report the time of each
+ * of their readings. They spin for a while after a reading, the readings of
+ * close kernel boundaries don't wait for the scheduler. The threads woken
+ * from sleep don't wake at once, so each of them waits at a spin barrier
+ * until all of them are ready, and they read together.
+ */
+class RaplReaders {
+    EnergySource* m_source; ///< not owned
+    std::vector<std::vector<std::size_t> > m_groups; ///< the components read by each thread
+    std::vector<int> m_cpus; ///< the cpu of each thread
+    std::string m_logFile; ///< the log of the service, for the threads which can't be pinned
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_mutex; ///< guards the sleeping of the threads
+    std::condition_variable m_wake;
+    std::atomic<uint64_t> m_generation; ///< incremented by every read()
+    std::atomic<std::size_t> m_pending; ///< the threads which have not finished the current read()
+    std::atomic<std::size_t> m_arrived; ///< the threads which are ready to read in the current read()
+    std::atomic<bool> m_isRunning;
+    uint64_t* m_counters; ///< the output of the current read()
+    marker::Timestamp* m_times;
+
+    void run(std::size_t reader);
+
+public:
+    /**
+     * Each group is read by a thread pinned to the cpu of the group, the
+     * components are indices of the source. A thread which can't be pinned
+     * is logged to the log file and reads unpinned.
+     */
+    RaplReaders(EnergySource* source, const std::vector<std::vector<std::size_t> >& groups, const std::vector<int>& cpus, const std::string& logFile);
+    ~RaplReaders();
+    RaplReaders(const RaplReaders&) = delete;
+    void operator=(const RaplReaders&) = delete;
+
+    /**
+     * Read every component at once: the counters are [component][DOMAIN_COUNT]
+     * (in the order of the domains of the source), the times are the time of
+     * the reading of each component, 0 if it couldn't be read.
+     */
+    void read(uint64_t* counters, marker::Timestamp* times);
+};
+
+} // namespace rapl
+
+#endif // RAPLREADERS_H_INCLUDED
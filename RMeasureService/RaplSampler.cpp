@@ -0,0 +1,253 @@
+/*
+Copyright (c) 2014-2017 University of Szeged
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software without
+   specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <algorithm>
+#include <time.h>
+
+#include "RaplSampler.h"
+
+namespace rapl {
+
+#define COUNTER_UPDATE_NS 1000000ull ///< the energy counters are updated about every millisecond
+#define WINDOW_UPDATES 10 ///< the derived window holds this many counter updates, an update more or less at its edges is 10%
+
+PowerStatistics::PowerStatistics() :
+    minimum(0.0),
+    maximum(0.0),
+    median(0.0),
+    percentile95(0.0),
+    samples(0)
+{
+}
+
+RaplSampler::RaplSampler(EnergySource* source, std::mutex& sourceMutex, std::size_t socketCount, double rate, std::size_t capacity, marker::Timestamp window) :
+    m_source(source),
+    m_sourceMutex(sourceMutex),
+    m_socketCount(socketCount),
+    m_period(rate > 0.0 ? (marker::Timestamp)(1e9 / rate) : 1000000),
+    m_window(window),
+    m_capacity(std::max<std::size_t>(capacity, 2)),
+    m_mutex(),
+    m_times(m_capacity),
+    m_energies(m_capacity * socketCount * source->domains().size()),
+    m_first(0),
+    m_count(0),
+    m_overwritten(0),
+    m_startTime(0),
+    m_lastCounters(socketCount * source->domains().size()),
+    m_hasBaseline(false),
+    m_accumulated(socketCount * source->domains().size()),
+    m_isRunning(false),
+    m_thread()
+{
+    if (m_period == 0)
+        m_period = 1;
+    // an interval of the sampling rate, but at least the counter updates of the error bound
+    if (m_window == 0)
+        m_window = std::max<marker::Timestamp>(m_period, WINDOW_UPDATES * COUNTER_UPDATE_NS);
+}
+
+RaplSampler::~RaplSampler()
+{
+    stop();
+}
+
+void RaplSampler::start()
+{
+    stop();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_first = 0;
+        m_count = 0;
+        m_overwritten = 0;
+        std::fill(m_accumulated.begin(), m_accumulated.end(), 0.0);
+        m_startTime = 0;
+    }
+    m_hasBaseline = false;
+    sample();
+    m_isRunning = true;
+    m_thread = std::thread(&RaplSampler::run, this);
+}
+
+void RaplSampler::stop()
+{
+    if (!m_thread.joinable())
+        return;
+    m_isRunning = false;
+    m_thread.join();
+    // the end of the last region is covered by a last sample
+    sample();
+}
+
+void RaplSampler::run()
+{
+    timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (m_isRunning) {
+        // absolute deadlines, the reading time doesn't shift the rate
+        next.tv_nsec += m_period % 1000000000;
+        next.tv_sec += m_period / 1000000000 + next.tv_nsec / 1000000000;
+        next.tv_nsec %= 1000000000;
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        sample();
+    }
+}
+
+void RaplSampler::sample()
+{
+    const bool first = !m_hasBaseline;
+    const std::size_t domainCount = m_source->domains().size();
+    uint64_t counters[DOMAIN_COUNT];
+    std::vector<double> energies(m_socketCount * domainCount);
+    marker::Timestamp time;
+    bool isRead = true;
+    {
+        std::lock_guard<std::mutex> lock(m_sourceMutex);
+        for (std::size_t i = 0; i < m_socketCount; ++i) {
+            // the energy of a dropped sample goes to the next one
+            if (!m_source->read(i, counters)) {
+                isRead = false;
+                continue;
+            }
+            for (std::size_t j = 0; j < domainCount; ++j) {
+                const std::size_t index = i * domainCount + j;
+                if (!first) {
+                    // the counters are read often enough to wrap around once at most
+                    const uint64_t range = m_source->counterRange(i, j);
+                    uint64_t delta = counters[j] - m_lastCounters[index];
+                    if (range != 0 && counters[j] < m_lastCounters[index])
+                        delta = counters[j] + (range - m_lastCounters[index]);
+                    m_accumulated[index] += (double)delta * m_source->energyUnit(i, j);
+                }
+                m_lastCounters[index] = counters[j];
+                energies[index] = m_accumulated[index];
+            }
+        }
+        time = marker::now();
+    }
+    if (!isRead)
+        return;
+    m_hasBaseline = true;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (first)
+        m_startTime = time;
+    std::size_t slot = (m_first + m_count) % m_capacity;
+    if (m_count == m_capacity) {
+        m_first = (m_first + 1) % m_capacity;
+        ++m_overwritten;
+    }
+    else {
+        ++m_count;
+    }
+    m_times[slot] = time;
+    std::copy(energies.begin(), energies.end(), m_energies.begin() + slot * energies.size());
+}
+
+double RaplSampler::energy(std::size_t i, std::size_t socket, std::size_t domain) const
+{
+    const std::size_t domainCount = m_source->domains().size();
+    const std::size_t slot = (m_first + i) % m_capacity;
+    return m_energies[(slot * m_socketCount + socket) * domainCount + domain];
+}
+
+double RaplSampler::rate() const
+{
+    return 1e9 / (double)m_period;
+}
+
+marker::Timestamp RaplSampler::startTime() const
+{
+    return m_startTime;
+}
+
+marker::Timestamp RaplSampler::window() const
+{
+    return m_window;
+}
+
+uint64_t RaplSampler::overwritten() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_overwritten;
+}
+
+PowerStatistics RaplSampler::statistics(std::size_t socket, marker::Timestamp begin, marker::Timestamp end) const
+{
+    PowerStatistics statistics;
+    if (m_source->domains().empty())
+        return statistics;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<double> powers;
+    // a sampling interval holds a whole number of counter updates, at the rates around the update rate
+    // it would be 0, 1 or 2 of them: the intervals are merged until they end right after an update and
+    // span the window, the partial update intervals at their edges are small against them
+    std::size_t first = 0;
+    for (std::size_t i = 1; i < m_count; ++i) {
+        const marker::Timestamp intervalBegin = m_times[(m_first + first) % m_capacity];
+        const marker::Timestamp intervalEnd = m_times[(m_first + i) % m_capacity];
+        // the package is the first domain of the source
+        if (intervalEnd < intervalBegin + m_window || energy(i, socket, 0) == energy(i - 1, socket, 0))
+            continue;
+        if (intervalEnd > begin && intervalBegin < end)
+            powers.push_back((energy(i, socket, 0) - energy(first, socket, 0)) * 1e9 / (double)(intervalEnd - intervalBegin));
+        first = i;
+    }
+    if (powers.empty())
+        return statistics;
+
+    std::sort(powers.begin(), powers.end());
+    statistics.minimum = powers.front();
+    statistics.maximum = powers.back();
+    statistics.median = powers[(powers.size() - 1) / 2];
+    statistics.percentile95 = powers[(std::size_t)(0.95 * (powers.size() - 1) + 0.5)];
+    statistics.samples = powers.size();
+    return statistics;
+}
+
+void RaplSampler::trace(std::vector<marker::Timestamp>& times, std::vector<double>& powers) const
+{
+    const std::size_t domainCount = m_source->domains().size();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    times.clear();
+    powers.clear();
+    for (std::size_t i = 1; i < m_count; ++i) {
+        const marker::Timestamp intervalBegin = m_times[(m_first + i - 1) % m_capacity];
+        const marker::Timestamp intervalEnd = m_times[(m_first + i) % m_capacity];
+        const double length = intervalEnd > intervalBegin ? (double)(intervalEnd - intervalBegin) / 1e9 : 0.0;
+        times.push_back(intervalEnd);
+        for (std::size_t j = 0; j < m_socketCount; ++j) {
+            for (std::size_t k = 0; k < domainCount; ++k)
+                powers.push_back(length > 0.0 ? (energy(i, j, k) - energy(i - 1, j, k)) / length : 0.0);
+        }
+    }
+}
+
+} // namespace rapl
@@ -0,0 +1,134 @@
+/*
+Copyright (c) 2014-2017 University of Szeged
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software without
+   specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef RAPLSAMPLER_H_INCLUDED
+#define RAPLSAMPLER_H_INCLUDED
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Marker.h"
+#include "EnergySource.h"
+
+namespace rapl {
+
+/** The power statistics of a socket during a kernel region, resolved against the sampled timeline. */
+struct PowerStatistics {
+    double minimum; ///< the lowest power of the sampling intervals overlapping the region (in Watts)
+    double maximum; ///< the highest power of the intervals (in Watts)
+    double median; ///< the median power of the intervals (in Watts)
+    double percentile95; ///< the 95th percentile of the power of the intervals (in Watts)
+    std::size_t samples; ///< the number of the overlapping intervals, the statistics are 0 without them
+
+    PowerStatistics();
+};
+
+/**
+ * Reads the energy counters of every socket at a fixed rate on its own
+ * thread, and keeps the accumulated energies with their timestamps in a
+ * ring (the oldest samples are overwritten). The kernel regions measured by
+ * the RaplCounter are resolved against this timeline: the power of a
+ * sampling interval is its energy divided by its length, the statistics of
+ * a region are taken over the intervals which overlap it.
+ *
+ * The energy counters are updated about every millisecond, so rates above
+ * 1 kHz repeat the same readings. The statistics merge the intervals until
+ * each of them spans the window and ends right after a counter update, a
+ * single interval would hold a varying number of updates. The window is the
+ * resolution of the statistics, by default the sampling period, but at least
+ * 10 counter updates (10 ms).
+ */
+class RaplSampler {
+    EnergySource* m_source; ///< not owned
+    std::mutex& m_sourceMutex; ///< serializes the reads of the source with the RaplCounter
+    std::size_t m_socketCount;
+    marker::Timestamp m_period; ///< in nanosec
+    marker::Timestamp m_window; ///< the shortest merged interval of the statistics (in nanosec)
+    std::size_t m_capacity; ///< the number of the samples in the ring
+
+    mutable std::mutex m_mutex; ///< guards the timeline
+    std::vector<marker::Timestamp> m_times; ///< the ring of the sample times
+    std::vector<double> m_energies; ///< the ring of the accumulated energies, [sample][socket][domain] (in Joules)
+    std::size_t m_first; ///< the index of the oldest sample in the ring
+    std::size_t m_count; ///< the number of the samples in the ring
+    uint64_t m_overwritten; ///< the number of the samples overwritten since the start
+    marker::Timestamp m_startTime; ///< the time of the first sample
+
+    std::vector<uint64_t> m_lastCounters; ///< the previous counters, [socket][domain]
+    bool m_hasBaseline; ///< specifies whether m_lastCounters holds a reading of every socket since the start
+    std::vector<double> m_accumulated; ///< the energies since the start, [socket][domain]
+    std::atomic<bool> m_isRunning;
+    std::thread m_thread;
+
+    /**
+     * Read the sockets and append a sample to the ring. The first sample
+     * which can be read on every socket is the baseline of the counters, a
+     * sample with a socket which can't be read is dropped.
+     */
+    void sample();
+    void run();
+    /** The accumulated energy of a domain of a socket in the i-th oldest sample. */
+    double energy(std::size_t i, std::size_t socket, std::size_t domain) const;
+
+public:
+    /**
+     * The rate is in Hz, the capacity is the number of the samples kept, the
+     * window is in nanosec (0 derives it from the rate).
+     */
+    RaplSampler(EnergySource* source, std::mutex& sourceMutex, std::size_t socketCount, double rate, std::size_t capacity, marker::Timestamp window = 0);
+    ~RaplSampler();
+    RaplSampler(const RaplSampler&) = delete;
+    void operator=(const RaplSampler&) = delete;
+
+    /** Clear the timeline and start the sampler thread. */
+    void start();
+    /** Stop the sampler thread, the timeline is kept until the next start. */
+    void stop();
+
+    double rate() const;
+    marker::Timestamp window() const;
+    marker::Timestamp startTime() const;
+    uint64_t overwritten() const;
+
+    /** The power statistics of the package of a socket between the two times. */
+    PowerStatistics statistics(std::size_t socket, marker::Timestamp begin, marker::Timestamp end) const;
+
+    /**
+     * The power trace: the end time of each sampling interval, and the power
+     * of every domain of every socket during it, [interval][socket][domain]
+     * (the domains of the source, in Watts).
+     */
+    void trace(std::vector<marker::Timestamp>& times, std::vector<double>& powers) const;
+};
+
+} // namespace rapl
+
+#endif // RAPLSAMPLER_H_INCLUDED
@@ -27,22 +27,31 @@ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
 SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+
 #include "TimerCounter.h"
 
 namespace timer {
 
+/** The user and kernel CPU times (utime, stime) are the 14th and the 15th field of /proc/<pid>/task/<tid>/stat. */
+#define STAT_TIMES_FIELD 14
 
-uint64_t diff_ms(timespec end, timespec start)
+TimerResult::TimerResult(const std::string& systemId) :
+    systemId(systemId),
+    elapsedTime(0),
+    userTime(0),
+    kernelTime(0),
+    hasCpuTimes(false)
 {
-    // return in nanosec
-    return BILLION * (end.tv_sec - start.tv_sec) + end.tv_nsec - start.tv_nsec;
-
 }
 
-
 TimerCounter::TimerCounter(const std::string& systemId) :
     m_systemId(systemId),
-    m_start(),
+    m_procRoot(),
+    m_tickLength(BILLION / sysconf(_SC_CLK_TCK)),
+    m_openRegions(),
     m_resultList()
 {
 
@@ -51,23 +60,86 @@ TimerCounter::~TimerCounter()
 {
 }
 
-void TimerCounter::calculate(bool isBegin)
+bool TimerCounter::cpuTimes(const marker::Producer& producer, const marker::CpuTimes* markerTimes, bool batched, uint64_t& userTime, uint64_t& kernelTime) const
 {
-    timespec currentTime;
-    clock_gettime(CLOCK_MONOTONIC, &currentTime);  /* mark start time */
-    if (isBegin)
-    {
-        m_start = currentTime;
+    if (m_procRoot.empty())
+        return false;
+    if (markerTimes) {
+        userTime = markerTimes->userTime;
+        kernelTime = markerTimes->kernelTime;
+        return true;
     }
-    else {
-        TimerResult timerResult(m_systemId, diff_ms(currentTime, m_start));
-        m_resultList.push_back(timerResult);
+    if (batched || producer.first == 0 || producer.second == 0)
+        return false;
+    FILE* file = fopen((m_procRoot + "/" + std::to_string(producer.first) + "/task/" + std::to_string(producer.second) + "/stat").c_str(), "r");
+    if (!file)
+        return false;
+    char line[1024];
+    const bool isRead = fgets(line, sizeof(line), file) != NULL;
+    fclose(file);
+    if (!isRead)
+        return false;
+
+    // the command name (2nd field) may contain spaces and parentheses, the other fields follow the last ')'
+    const char* fields = strrchr(line, ')');
+    if (!fields)
+        return false;
+    unsigned long long user, kernel;
+    int field = 3;
+    for (++fields; fields && field < STAT_TIMES_FIELD; ++field)
+        fields = strchr(fields + 1, ' ');
+    if (!fields || sscanf(fields, " %llu %llu", &user, &kernel) != 2)
+        return false;
+    userTime = user * m_tickLength;
+    kernelTime = kernel * m_tickLength;
+    return true;
+}
+
+void TimerCounter::setCpuTimes(const std::string& procRoot)
+{
+    m_procRoot = procRoot;
+}
+
+bool TimerCounter::isCpuTimeMeasured() const
+{
+    return !m_procRoot.empty();
+}
+
+void TimerCounter::begin(const marker::Producer& producer, marker::Timestamp time, bool batched, const marker::CpuTimes* cpuTimes)
+{
+    OpenRegion region;
+    region.index = m_resultList.size();
+    region.time = time;
+    region.userTime = 0;
+    region.kernelTime = 0;
+    region.hasCpuTimes = this->cpuTimes(producer, cpuTimes, batched, region.userTime, region.kernelTime);
+    m_openRegions[producer].push_back(region);
+    m_resultList.push_back(TimerResult(m_systemId));
+}
+
+void TimerCounter::end(const marker::Producer& producer, marker::Timestamp time, bool batched, const marker::CpuTimes* cpuTimes)
+{
+    std::vector<OpenRegion>& openRegions = m_openRegions[producer];
+    if (openRegions.empty())
+        return;
+
+    // in nanosec
+    const OpenRegion& region = openRegions.back();
+    TimerResult& result = m_resultList[region.index];
+    result.elapsedTime = time > region.time ? time - region.time : 0;
+    uint64_t userTime, kernelTime;
+    if (region.hasCpuTimes && this->cpuTimes(producer, cpuTimes, batched, userTime, kernelTime)) {
+        result.userTime = userTime > region.userTime ? userTime - region.userTime : 0;
+        result.kernelTime = kernelTime > region.kernelTime ? kernelTime - region.kernelTime : 0;
+        result.hasCpuTimes = true;
     }
+    openRegions.pop_back();
 }
 
 void TimerCounter::startMeasurement()
 {
     m_resultList.clear();
+    m_openRegions.clear();
 }
 
 const ResultList& TimerCounter::resultList() const
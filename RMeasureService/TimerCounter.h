@@ -32,25 +32,79 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #define BILLION 1000000000L
 
+#include <map>
 #include <vector>
 #include <string>
 #include <stdint.h> /* for uint64 definition */
-#include <time.h>   /* for clock_gettime */
+
+#include "Marker.h"
 
 namespace timer {
-typedef std::pair<std::string, uint64_t> TimerResult;
+
+/**
+ * The times of a kernel region (in nanosec). The CPU times are the ones of
+ * the producer thread during the region.
+ */
+struct TimerResult {
+    std::string systemId;
+    uint64_t elapsedTime;
+    uint64_t userTime;
+    uint64_t kernelTime;
+    bool hasCpuTimes; ///< the CPU times of the producer thread are known at both markers
+
+    TimerResult(const std::string& systemId);
+};
 typedef std::vector<TimerResult> ResultList;
 
+/**
+ * An open kernel region: its index in the result list, its start time, and
+ * the CPU times of its producer thread at the start.
+ */
+struct OpenRegion {
+    std::size_t index;
+    marker::Timestamp time;
+    uint64_t userTime;
+    uint64_t kernelTime;
+    bool hasCpuTimes;
+};
+
 class TimerCounter {
     std::string m_systemId;
-    timespec m_start;
+    std::string m_procRoot; ///< the procfs of the producers, empty if the CPU times are not measured
+    uint64_t m_tickLength; ///< the length of a clock tick of procfs (in nanosec)
+    std::map<marker::Producer, std::vector<OpenRegion> > m_openRegions; ///< stacks of the open (possibly nested) regions of each producer
     ResultList m_resultList;
 
+    /**
+     * The user and kernel CPU times of the producer thread (in nanosec): the
+     * ones of the marker if it carries them, otherwise they are read from
+     * procfs (not for the batched markers, they arrive late).
+     */
+    bool cpuTimes(const marker::Producer& producer, const marker::CpuTimes* markerTimes, bool batched, uint64_t& userTime, uint64_t& kernelTime) const;
+
 public:
     TimerCounter(const std::string& systemId);
     ~TimerCounter();
 
-    void calculate(bool isBegin = false);
+    /**
+     * Measure the user and kernel CPU times of the producer threads, an empty
+     * root disables it. The markers of the ring and the socket carry them
+     * (read at the call site), the ones of the named pipe don't: for them
+     * <procRoot>/<pid>/task/<tid>/stat is read when the marker is processed,
+     * in clock ticks (USER_HZ, usually 10 ms).
+     */
+    void setCpuTimes(const std::string& procRoot);
+    bool isCpuTimeMeasured() const;
+
+    /**
+     * Open a new kernel region, its result is reserved in the order of the
+     * begin markers. cpuTimes are the CPU times carried by the marker, NULL
+     * if it has none.
+     */
+    void begin(const marker::Producer& producer, marker::Timestamp time, bool batched = false, const marker::CpuTimes* cpuTimes = NULL);
+
+    /** Close the innermost open kernel region of the producer. */
+    void end(const marker::Producer& producer, marker::Timestamp time, bool batched = false, const marker::CpuTimes* cpuTimes = NULL);
     void startMeasurement();
 
     const ResultList& resultList() const;
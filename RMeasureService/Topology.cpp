@@ -0,0 +1,154 @@
+/*
+Copyright (c) 2014-2017 University of Szeged
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software without
+   specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <map>
+
+#include "Topology.h"
+
+namespace rapl {
+
+std::string readAttribute(const std::string& path)
+{
+    char buffer[4096];
+    std::string value;
+    FILE* file = fopen(path.c_str(), "r");
+    if (file) {
+        if (fgets(buffer, sizeof buffer, file))
+            value = buffer;
+        fclose(file);
+    }
+    value.erase(value.find_last_not_of(" \n") + 1);
+    return value;
+}
+
+/* The numbers of the entries of a directory named prefix<number>, in ascending order. */
+static std::vector<int> listNumbered(const std::string& path, const std::string& prefix)
+{
+    std::vector<int> numbers;
+    DIR* directory = opendir(path.c_str());
+    if (!directory)
+        return numbers;
+    while (dirent* entry = readdir(directory)) {
+        const std::string entryName = entry->d_name;
+        if (entryName.size() > prefix.size() && entryName.compare(0, prefix.size(), prefix) == 0
+            && entryName.find_first_not_of("0123456789", prefix.size()) == std::string::npos)
+            numbers.push_back(atoi(entryName.c_str() + prefix.size()));
+    }
+    closedir(directory);
+    std::sort(numbers.begin(), numbers.end());
+    return numbers;
+}
+
+/* The cpus of a cpu list ("0-11,24-35"). */
+static std::vector<int> parseCpuList(const std::string& list)
+{
+    std::vector<int> cpus;
+    const char* position = list.c_str();
+    while (*position) {
+        char* end;
+        const long first = strtol(position, &end, 10);
+        if (end == position)
+            break;
+        long last = first;
+        if (*end == '-')
+            last = strtol(end + 1, &end, 10);
+        for (long cpu = first; cpu <= last; ++cpu)
+            cpus.push_back((int)cpu);
+        position = *end == ',' ? end + 1 : end;
+        if (*end != ',')
+            break;
+    }
+    return cpus;
+}
+
+std::vector<Package> discoverPackages(const std::string& sysfsRoot)
+{
+    const std::string cpuRoot = sysfsRoot + "/devices/system/cpu";
+    const std::string nodeRoot = sysfsRoot + "/devices/system/node";
+
+    // the NUMA node of each cpu, the machines without NUMA have no node directory
+    std::map<int, int> cpuNodes;
+    const std::vector<int> nodes = listNumbered(nodeRoot, "node");
+    for (std::size_t i = 0; i < nodes.size(); ++i) {
+        const std::vector<int> cpus = parseCpuList(readAttribute(nodeRoot + "/node" + std::to_string(nodes[i]) + "/cpulist"));
+        for (std::size_t j = 0; j < cpus.size(); ++j)
+            cpuNodes[cpus[j]] = nodes[i];
+    }
+
+    std::map<int, Package> packages;
+    std::map<std::pair<int, int>, int> firstThreads; // (package, core_id) -> the first cpu of the core
+    const std::vector<int> cpus = listNumbered(cpuRoot, "cpu");
+    for (std::size_t i = 0; i < cpus.size(); ++i) {
+        const std::string cpuPath = cpuRoot + "/cpu" + std::to_string(cpus[i]);
+        // the boot cpu may have no online attribute, the offline cpus have no topology
+        if (readAttribute(cpuPath + "/online") == "0")
+            continue;
+        const std::string packageId = readAttribute(cpuPath + "/topology/physical_package_id");
+        if (packageId.empty())
+            continue;
+
+        Package& package = packages[atoi(packageId.c_str())];
+        package.id = atoi(packageId.c_str());
+        package.cores.push_back(cpus[i]);
+        const std::string coreId = readAttribute(cpuPath + "/topology/core_id");
+        if (firstThreads.insert(std::make_pair(std::make_pair(package.id, atoi(coreId.c_str())), cpus[i])).second)
+            package.physicalCores.push_back(cpus[i]);
+        std::map<int, int>::const_iterator nodeIt = cpuNodes.find(cpus[i]);
+        if (nodeIt != cpuNodes.end() && std::find(package.nodes.begin(), package.nodes.end(), nodeIt->second) == package.nodes.end())
+            package.nodes.push_back(nodeIt->second);
+    }
+
+    std::vector<Package> result;
+    for (std::map<int, Package>::iterator it = packages.begin(); it != packages.end(); ++it) {
+        std::sort(it->second.nodes.begin(), it->second.nodes.end());
+        result.push_back(it->second);
+    }
+    return result;
+}
+
+std::string formatCpuList(const std::vector<int>& cpus)
+{
+    std::string list;
+    for (std::size_t i = 0; i < cpus.size(); ) {
+        std::size_t last = i;
+        while (last + 1 < cpus.size() && cpus[last + 1] == cpus[last] + 1)
+            ++last;
+        list += (list.empty() ? "" : ",") + std::to_string(cpus[i]);
+        if (last > i)
+            list += "-" + std::to_string(cpus[last]);
+        i = last + 1;
+    }
+    return list;
+}
+
+} // namespace rapl
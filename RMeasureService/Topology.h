@@ -0,0 +1,66 @@
+/*
+Copyright (c) 2014-2017 University of Szeged
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software without
+   specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef TOPOLOGY_H_INCLUDED
+#define TOPOLOGY_H_INCLUDED
+
+#include <string>
+#include <vector>
+
+namespace rapl {
+
+/** A processor package (socket) of the machine. */
+struct Package {
+    int id; ///< the physical_package_id of its cpus
+    std::vector<int> cores; ///< the online logical cpus of the package, in ascending order
+    std::vector<int> physicalCores; ///< the first online cpu of each physical core (core_id) of the package
+    std::vector<int> nodes; ///< the NUMA nodes of these cpus, in ascending order
+};
+
+/**
+ * Discover the packages of the machine from the topology/physical_package_id
+ * of the cpus in <sysfsRoot>/devices/system/cpu, and their NUMA nodes from
+ * the cpulist of the nodes in <sysfsRoot>/devices/system/node. The offline
+ * cpus are left out. The packages are in the order of their ids, empty if
+ * the topology can't be read.
+ */
+std::vector<Package> discoverPackages(const std::string& sysfsRoot);
+
+/**
+ * The first line of a sysfs attribute without the trailing whitespace,
+ * empty if it can't be read.
+ */
+std::string readAttribute(const std::string& path);
+
+/** The cpu list notation of sysfs ("0-11,24-35") of ascending numbers. */
+std::string formatCpuList(const std::vector<int>& cpus);
+
+} // namespace rapl
+
+#endif // TOPOLOGY_H_INCLUDED
@@ -0,0 +1,63 @@
+/*
+Copyright (c) 2014-2017 University of Szeged
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software without
+   specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "MeasuredKernels.h"
+
+#include <map>
+
+namespace repara {
+namespace measurement {
+
+void decodeMeasuredKernels(const xmlrpc_c::value& measuredKernels, std::vector<std::string>& names, std::vector<uint32_t>& kernels)
+{
+    std::map<std::string, xmlrpc_c::value> measuredKernelsMap(static_cast<std::map<std::string, xmlrpc_c::value> >(xmlrpc_c::value_struct(measuredKernels)));
+    const std::vector<xmlrpc_c::value> namesData = xmlrpc_c::value_array(measuredKernelsMap["names"]).cvalue();
+    const std::vector<unsigned char> idsData = xmlrpc_c::value_bytes(measuredKernelsMap["ids"]).vectorUcharValue();
+
+    names.clear();
+    names.reserve(namesData.size());
+    std::vector<xmlrpc_c::value>::const_iterator nameIt = namesData.begin();
+    for (; nameIt != namesData.end(); ++nameIt)
+        names.push_back(static_cast<std::string>(xmlrpc_c::value_string(*nameIt)));
+
+    // the ids are little-endian 32 bit indices of the names table
+    const uint32_t nameCount = names.size();
+    kernels.clear();
+    kernels.reserve(idsData.size() / 4);
+    for (std::size_t i = 0; i + 4 <= idsData.size(); i += 4) {
+        const uint32_t id = (uint32_t)idsData[i] | ((uint32_t)idsData[i + 1] << 8)
+                          | ((uint32_t)idsData[i + 2] << 16) | ((uint32_t)idsData[i + 3] << 24);
+        if (id >= nameCount && names.size() == nameCount)
+            names.push_back(std::string());
+        kernels.push_back(id < nameCount ? id : nameCount);
+    }
+}
+
+} // namespace measurement
+} // namespace repara
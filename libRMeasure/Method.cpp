@@ -0,0 +1,205 @@
+/*
+Copyright (c) 2014-2017 University of Szeged
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software without
+   specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "Method.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <xmlrpc-c/base.hpp>
+
+namespace repara {
+namespace measurement {
+
+/*
+ * The additive data types. It is a function-local static, because the
+ * capabilities are initialized in another translation unit.
+ */
+static const std::vector<SourceCapability>& additiveCapabilities()
+{
+    static const SourceCapability additive[] = {
+        SourceCapability::Energy,
+        SourceCapability::ElapsedTime,
+        SourceCapability::KernelTime,
+        SourceCapability::UserTime,
+        SourceCapability::CoreEnergy,
+        SourceCapability::UncoreEnergy,
+        SourceCapability::DramEnergy,
+        SourceCapability::PlatformEnergy,
+        SourceCapability::Cycles,
+        SourceCapability::Instructions,
+        SourceCapability::LlcMisses,
+        SourceCapability::BranchMisses
+    };
+    static const std::vector<SourceCapability> capabilities(additive, additive + sizeof(additive) / sizeof(additive[0]));
+    return capabilities;
+}
+
+/*
+ * Add the additive data of the sources to the result, multiplied by the sign.
+ */
+static void addSources(Measurement::SourceMap& result, const Measurement::SourceMap& sources, double sign)
+{
+    const std::vector<SourceCapability>& additive = additiveCapabilities();
+    Measurement::SourceMap::const_iterator sourceIt = sources.begin();
+    for (; sourceIt != sources.end(); ++sourceIt) {
+        const Measurement::DataMap& dataMap = sourceIt->second;
+        for (std::size_t i = 0; i < additive.size(); ++i) {
+            Measurement::DataMap::const_iterator dataMapIt = dataMap.find(additive[i]);
+            if (dataMapIt != dataMap.end())
+                result[sourceIt->first][additive[i]] += sign * dataMapIt->second;
+        }
+    }
+}
+
+const Measurement::SourceMap Measurement::exclusiveSources(const std::string& kernelName) const
+{
+    SourceMap exclusive;
+    const InvocationList& invocationList = invocations();
+    const int kernel = kernelIndex(kernelName);
+
+    InvocationList::const_iterator invocationIt = invocationList.begin();
+    for (; invocationIt != invocationList.end(); ++invocationIt) {
+        if ((int)invocationIt->kernel == kernel)
+            addSources(exclusive, invocationIt->sources, invocationIt->weight);
+
+        // the direct children of the kernel are not part of its exclusive data
+        const int parent = invocationIt->parent;
+        if (parent >= 0 && parent < (int)invocationList.size() && (int)invocationList[parent].kernel == kernel)
+            addSources(exclusive, invocationIt->sources, -invocationIt->weight);
+    }
+
+    SourceMap::iterator sourceIt = exclusive.begin();
+    for (; sourceIt != exclusive.end(); ++sourceIt) {
+        DataMap& dataMap = sourceIt->second;
+        DataMap::const_iterator energyIt = dataMap.find(SourceCapability::Energy);
+        DataMap::const_iterator timeIt = dataMap.find(SourceCapability::ElapsedTime);
+        if (energyIt != dataMap.end() && timeIt != dataMap.end() && timeIt->second > 0.0)
+            dataMap[SourceCapability::AveragePower] = energyIt->second / timeIt->second;
+    }
+    return exclusive;
+}
+
+/*
+ * The extrapolated total is the (estimated) number of the invocations times
+ * the weighted mean of the measured ones, its variance is estimated like the
+ * variance of a simple random sample of that size.
+ */
+const Measurement::SourceMap Measurement::aggregatedErrors(const std::string& kernelName) const
+{
+    typedef std::map<std::string, std::map<SourceCapability, std::vector<std::pair<double, double> > > > SampleMap;
+    SampleMap samples;
+    const std::vector<SourceCapability>& additive = additiveCapabilities();
+    const InvocationList& invocationList = invocations();
+    const int kernel = kernelIndex(kernelName);
+
+    InvocationList::const_iterator invocationIt = invocationList.begin();
+    for (; invocationIt != invocationList.end(); ++invocationIt) {
+        if ((int)invocationIt->kernel != kernel)
+            continue;
+        SourceMap::const_iterator sourceIt = invocationIt->sources.begin();
+        for (; sourceIt != invocationIt->sources.end(); ++sourceIt) {
+            for (std::size_t i = 0; i < additive.size(); ++i) {
+                DataMap::const_iterator dataMapIt = sourceIt->second.find(additive[i]);
+                if (dataMapIt != sourceIt->second.end())
+                    samples[sourceIt->first][additive[i]].push_back(std::make_pair(invocationIt->weight, dataMapIt->second));
+            }
+        }
+    }
+
+    SourceMap errors;
+    SampleMap::const_iterator deviceIt = samples.begin();
+    for (; deviceIt != samples.end(); ++deviceIt) {
+        std::map<SourceCapability, std::vector<std::pair<double, double> > >::const_iterator capabilityIt = deviceIt->second.begin();
+        for (; capabilityIt != deviceIt->second.end(); ++capabilityIt) {
+            const std::vector<std::pair<double, double> >& sample = capabilityIt->second;
+            const double count = sample.size();
+            double population = 0.0;
+            double sum = 0.0;
+            for (std::size_t i = 0; i < sample.size(); ++i) {
+                population += sample[i].first;
+                sum += sample[i].first * sample[i].second;
+            }
+
+            double error = 0.0;
+            if (count > 1.0 && population > count) {
+                const double mean = sum / population;
+                double variance = 0.0;
+                for (std::size_t i = 0; i < sample.size(); ++i)
+                    variance += sample[i].first * (sample[i].second - mean) * (sample[i].second - mean);
+                variance = variance / population * count / (count - 1.0);
+                error = 1.96 * population * std::sqrt((1.0 - count / population) * variance / count);
+            }
+            errors[deviceIt->first][capabilityIt->first] = error;
+        }
+    }
+    return errors;
+}
+
+const std::string& Measurement::kernelName(const KernelInvocation& invocation) const
+{
+    static const std::string unknown;
+    return invocation.kernel < kernelNames().size() ? kernelNames()[invocation.kernel] : unknown;
+}
+
+int Measurement::kernelIndex(const std::string& kernelName) const
+{
+    const std::vector<std::string>& names = kernelNames();
+    std::vector<std::string>::const_iterator nameIt = std::find(names.begin(), names.end(), kernelName);
+    return nameIt != names.end() ? (int)(nameIt - names.begin()) : -1;
+}
+
+Measurement::KernelInvocation Measurement::kernelInvocation(uint32_t kernel, const xmlrpc_c::value* invocation)
+{
+    KernelInvocation result;
+    result.kernel = kernel;
+    result.parent = -1;
+    result.pid = 0;
+    result.tid = 0;
+    result.weight = 1.0;
+    result.session = 0;
+    if (!invocation)
+        return result;
+
+    std::map<std::string, xmlrpc_c::value> invocationMap(static_cast<std::map<std::string, xmlrpc_c::value> >(xmlrpc_c::value_struct(*invocation)));
+    if (invocationMap.count("parent"))
+        result.parent = static_cast<int>(xmlrpc_c::value_int(invocationMap["parent"]));
+    if (invocationMap.count("pid"))
+        result.pid = static_cast<unsigned>(xmlrpc_c::value_int(invocationMap["pid"]));
+    if (invocationMap.count("tid"))
+        result.tid = static_cast<unsigned>(xmlrpc_c::value_int(invocationMap["tid"]));
+    if (invocationMap.count("weight"))
+        result.weight = static_cast<double>(xmlrpc_c::value_double(invocationMap["weight"]));
+    if (invocationMap.count("session"))
+        result.session = static_cast<unsigned>(xmlrpc_c::value_int(invocationMap["session"]));
+    return result;
+}
+
+} // namespace repara::measurement
+} // namespace repara
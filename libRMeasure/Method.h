@@ -34,10 +34,15 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <map>
 #include <string>
 #include <vector>
+#include <stdint.h> /* for uint32 definition */
 
 #define SCOPESERVICE "SCOPESERVICE"
 #define RMEASURESERVICE "RMEASURESERVICE"
 
+namespace xmlrpc_c {
+class value;
+}
+
 namespace repara {
 
 /**
@@ -76,6 +81,33 @@ public:
      */
     typedef std::map<std::string, SourceContainer> KernelSourceMap;
 
+    /**
+     * A measured invocation of a kernel. Invocations are stored in the order
+     * they were entered, kernel is the index of the name of the kernel in
+     * kernelNames(), parent is the index of the enclosing invocation
+     * (-1 for a top-level one) of the same producer (pid and tid of the
+     * thread which sent the markers). The sources are inclusive, i.e. they
+     * contain the data of the nested invocations too. If the kernel is
+     * sampled, weight is the number of the invocations this one represents.
+     * Session is the marker socket session of the producer process (0 if
+     * the markers came through the marker ring or the FIFO), the invocations
+     * of concurrently measured jobs can be told apart by it.
+     */
+    struct KernelInvocation {
+        uint32_t kernel;
+        int parent;
+        unsigned pid;
+        unsigned tid;
+        double weight;
+        unsigned session;
+        SourceMap sources;
+    };
+
+    /**
+     * The tree of the measured invocations in the order they were entered.
+     */
+    typedef std::vector<KernelInvocation> InvocationList;
+
     /**
      * Virtual destructor, since objects of subclasses will most often be
      * handled and deleted via Measurement pointers.
@@ -96,16 +128,71 @@ public:
 
     /**
      * The aggregated results of the given kernel from the KernelSourceMap.
+     * The results are inclusive, nested kernels are counted in their parents too.
+     * The totals of a sampled kernel are extrapolated from the measured
+     * invocations by their weights, InvocationCount is the (estimated)
+     * number of the invocations.
      * It is not guaranteed to return meaningful data before calling stop().
      */
     virtual const SourceMap aggregatedSources(const std::string& kernelName) const = 0;
 
+    /**
+     * The 95% confidence half-widths of the extrapolated additive totals
+     * (the energies, ElapsedTime, KernelTime, UserTime) of aggregatedSources().
+     * They are 0 if every invocation of the kernel was measured.
+     * It is not guaranteed to return meaningful data before calling stop().
+     */
+    const SourceMap aggregatedErrors(const std::string& kernelName) const;
+
+    /**
+     * The measured invocations with their nesting.
+     * It is not guaranteed to return meaningful data before calling stop().
+     */
+    virtual const InvocationList& invocations() const = 0;
+
+    /**
+     * The names of the measured kernels, each name is stored once and the
+     * invocations refer to it by its index.
+     * It is not guaranteed to return meaningful data before calling stop().
+     */
+    virtual const std::vector<std::string>& kernelNames() const = 0;
+
+    /**
+     * The name of the kernel of an invocation.
+     */
+    const std::string& kernelName(const KernelInvocation& invocation) const;
+
+    /**
+     * The aggregated exclusive results of the given kernel: the additive data
+     * (the energies, ElapsedTime, KernelTime, UserTime) of the directly nested
+     * invocations is subtracted, and AveragePower is recalculated from the
+     * exclusive Energy and ElapsedTime.
+     * It is not guaranteed to return meaningful data before calling stop().
+     */
+    const SourceMap exclusiveSources(const std::string& kernelName) const;
+
     /**
      * The container with the results of the given kernel from the KernelSourceMap.
      * It is not guaranteed to return meaningful data before calling stop().
      */
     virtual const SourceContainer kernelSources(const std::string& kernelName) const = 0;
 
+protected:
+    /**
+     * An invocation of a kernel without its sources, from its entry of
+     * rmeasure.getKernelInvocations (NULL if the service didn't send the
+     * invocations). The fields an older service doesn't send keep their
+     * defaults: a top-level invocation of weight 1 of the producer 0:0 in
+     * session 0.
+     */
+    static KernelInvocation kernelInvocation(uint32_t kernel, const xmlrpc_c::value* invocation);
+
+    /**
+     * The index of the name of the kernel in kernelNames(), -1 if it wasn't
+     * measured.
+     */
+    int kernelIndex(const std::string& kernelName) const;
+
 }; // class Measurement
 
 /**
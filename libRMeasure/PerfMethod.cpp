@@ -0,0 +1,252 @@
+/*
+Copyright (c) 2014-2017 University of Szeged
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software without
+   specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "PerfMethod.h"
+
+#include "MeasuredKernels.h"
+
+#include <xmlrpc-c/client_simple.hpp>
+
+namespace repara {
+namespace measurement {
+namespace perf {
+
+const std::string startListeningCommand = "perf.startListening";
+const std::string stopListeningCommand = "perf.stopListening";
+const std::string getMeasuredDataCommand = "perf.getMeasuredData";
+const std::string getMeasuredComponentsCommand = "perf.getMeasuredComponents";
+const std::string getMeasuredEventsCommand = "perf.getMeasuredEvents";
+const std::string getMeasuredKernelsCommand = "rmeasure.getMeasuredKernels";
+const std::string getKernelInvocationsCommand = "rmeasure.getKernelInvocations";
+
+/*
+ * The events of the service and their capabilities. It is a function-local
+ * static, because the capabilities are initialized in another translation unit.
+ */
+static const std::map<std::string, SourceCapability>& eventCapabilities()
+{
+    static std::map<std::string, SourceCapability> capabilities;
+    if (capabilities.empty()) {
+        capabilities.insert(std::make_pair("cycles", SourceCapability::Cycles));
+        capabilities.insert(std::make_pair("instructions", SourceCapability::Instructions));
+        capabilities.insert(std::make_pair("llcMisses", SourceCapability::LlcMisses));
+        capabilities.insert(std::make_pair("branchMisses", SourceCapability::BranchMisses));
+    }
+    return capabilities;
+}
+
+PerfMeasurement::PerfMeasurement()
+    : _inProgress(true), _kernelResults(), _invocations(), _kernelNames()
+{
+    xmlrpc_c::clientSimple myClient;
+    xmlrpc_c::value startListeningResult;
+    myClient.call(getenv(RMEASURESERVICE), startListeningCommand, "", &startListeningResult);
+    bool startListening = static_cast<bool>(xmlrpc_c::value_boolean(startListeningResult));
+    if (!startListening)
+        _inProgress = false;
+}
+
+PerfMeasurement::~PerfMeasurement()
+{
+}
+
+void PerfMeasurement::stop()
+{
+    if (_inProgress) {
+        xmlrpc_c::clientSimple myClient;
+        xmlrpc_c::value stopListeningResult;
+
+        myClient.call(getenv(RMEASURESERVICE), stopListeningCommand, "", &stopListeningResult);
+
+        bool stopListening = static_cast<bool>(xmlrpc_c::value_boolean(stopListeningResult));
+        if (stopListening) {
+            xmlrpc_c::value measurementResults, measuredKernels, kernelInvocations;
+            myClient.call(getenv(RMEASURESERVICE), getMeasuredDataCommand, "", &measurementResults);
+            myClient.call(getenv(RMEASURESERVICE), getMeasuredKernelsCommand, "", &measuredKernels);
+            myClient.call(getenv(RMEASURESERVICE), getKernelInvocationsCommand, "", &kernelInvocations);
+
+            std::vector<uint32_t> kernels;
+            decodeMeasuredKernels(measuredKernels, _kernelNames, kernels);
+            std::vector<xmlrpc_c::value> kernelResults = xmlrpc_c::value_array(measurementResults).cvalue();
+            std::vector<xmlrpc_c::value> invocations = xmlrpc_c::value_array(kernelInvocations).cvalue();
+
+            if (kernels.size() == kernelResults.size()) {
+                std::vector<xmlrpc_c::value>::iterator resultsIt = kernelResults.begin();
+                std::vector<uint32_t>::const_iterator kernelsIt = kernels.begin();
+                std::size_t index = 0;
+                // the results of a kernel are looked up by its name once, not at each invocation
+                std::vector<SourceContainer*> kernelContainers(_kernelNames.size(), NULL);
+                for (; resultsIt != kernelResults.end(); ++resultsIt, ++kernelsIt, ++index) {
+                    const xmlrpc_c::value_struct measurements = static_cast<xmlrpc_c::value_struct>(*resultsIt);
+                    std::map<std::string, xmlrpc_c::value> measurementsMap(static_cast<std::map<std::string, xmlrpc_c::value> >(measurements));
+                    std::map<std::string, xmlrpc_c::value>::iterator measurementsIt = measurementsMap.begin();
+                    SourceMap result;
+                    for (; measurementsIt != measurementsMap.end(); ++measurementsIt) {
+                        const std::string device = static_cast<std::string>(xmlrpc_c::value_string(measurementsIt->first));
+                        const xmlrpc_c::value_struct results = static_cast<xmlrpc_c::value_struct>(measurementsIt->second);
+                        std::map<std::string, xmlrpc_c::value> resultsMap(static_cast<std::map<std::string, xmlrpc_c::value> >(results));
+                        DataMap& data = result[device];
+                        std::map<std::string, SourceCapability>::const_iterator eventIt = eventCapabilities().begin();
+                        for (; eventIt != eventCapabilities().end(); ++eventIt) {
+                            if (resultsMap.count(eventIt->first))
+                                data[eventIt->second] = static_cast<double>(xmlrpc_c::value_double(resultsMap[eventIt->first]));
+                        }
+                    }
+                    SourceContainer*& kernelContainer = kernelContainers[*kernelsIt];
+                    if (!kernelContainer)
+                        kernelContainer = &_kernelResults[_kernelNames[*kernelsIt]];
+                    kernelContainer->push_back(result);
+
+                    KernelInvocation invocation = kernelInvocation(*kernelsIt, invocations.size() == kernels.size() ? &invocations[index] : NULL);
+                    invocation.sources = result;
+                    _invocations.push_back(invocation);
+                }
+            }
+        }
+    }
+}
+
+const Measurement::KernelSourceMap& PerfMeasurement::kernelSourceMap() const
+{
+    return _kernelResults;
+}
+
+const Measurement::SourceMap PerfMeasurement::aggregatedSources(const std::string& kernelName) const
+{
+    SourceMap aggregatedSources;
+    const int kernel = kernelIndex(kernelName);
+    InvocationList::const_iterator invocationIt = _invocations.begin();
+    for (; invocationIt != _invocations.end(); ++invocationIt) {
+        if ((int)invocationIt->kernel == kernel) {
+            // a sampled invocation stands for weight invocations of the kernel
+            const double weight = invocationIt->weight;
+            SourceMap::const_iterator sourceIt = invocationIt->sources.begin();
+            for (; sourceIt != invocationIt->sources.end(); ++sourceIt) {
+                const std::string& device = sourceIt->first;
+                const DataMap& dataMap = sourceIt->second;
+                std::map<std::string, SourceCapability>::const_iterator eventIt = eventCapabilities().begin();
+                for (; eventIt != eventCapabilities().end(); ++eventIt) {
+                    DataMap::const_iterator dataMapIt = dataMap.find(eventIt->second);
+                    if (dataMapIt != dataMap.end())
+                        aggregatedSources[device][eventIt->second] += weight * dataMapIt->second;
+                }
+                aggregatedSources[device][SourceCapability::InvocationCount] += weight;
+            }
+        }
+    }
+    return aggregatedSources;
+}
+
+const Measurement::InvocationList& PerfMeasurement::invocations() const
+{
+    return _invocations;
+}
+
+const std::vector<std::string>& PerfMeasurement::kernelNames() const
+{
+    return _kernelNames;
+}
+
+const Measurement::SourceContainer PerfMeasurement::kernelSources(const std::string& kernelName) const
+{
+    SourceContainer sources;
+    KernelSourceMap::const_iterator kernelIt = _kernelResults.find(kernelName);
+    if (kernelIt != _kernelResults.end())
+        sources = kernelIt->second;
+
+    return sources;
+}
+
+const bool& PerfMeasurement::isInProgress() const
+{
+    return _inProgress;
+}
+
+PerfMethod::PerfMethod()
+    : _caps()
+{
+    xmlrpc_c::clientSimple myClient;
+    xmlrpc_c::value measuredComponents, measuredEvents;
+
+    myClient.call(getenv(RMEASURESERVICE), getMeasuredComponentsCommand, "", &measuredComponents);
+    myClient.call(getenv(RMEASURESERVICE), getMeasuredEventsCommand, "", &measuredEvents);
+    std::vector<xmlrpc_c::value> components = xmlrpc_c::value_array(measuredComponents).cvalue();
+    std::vector<xmlrpc_c::value> events = xmlrpc_c::value_array(measuredEvents).cvalue();
+
+    SourceCapabilities eventCaps;
+    for (std::size_t i = 0; i < events.size(); ++i) {
+        std::map<std::string, SourceCapability>::const_iterator eventIt = eventCapabilities().find(static_cast<std::string>(xmlrpc_c::value_string(events[i])));
+        if (eventIt != eventCapabilities().end())
+            eventCaps |= eventIt->second;
+    }
+    if (eventCaps == SourceCapabilities::None)
+        return;
+
+    std::vector<xmlrpc_c::value>::iterator componentIt = components.begin();
+    for (; componentIt != components.end(); ++componentIt) {
+        const std::string device = static_cast<std::string>(xmlrpc_c::value_string(*componentIt));
+        _caps[device] = SourceCapability::InvocationCount;
+        _caps[device] |= eventCaps;
+    }
+}
+
+PerfMethod::~PerfMethod()
+{
+}
+
+PerfMethod* PerfMethod::_instance = NULL;
+
+PerfMethod* PerfMethod::getInstance()
+{
+    if (!_instance)
+        _instance = new PerfMethod;
+    return _instance;
+}
+
+void PerfMethod::deleteInstance()
+{
+    delete _instance;
+    _instance = NULL;
+}
+
+const Method::SourceCapabilityMap& PerfMethod::sourceCapabilities() const
+{
+    return _caps;
+}
+
+Measurement* PerfMethod::start()
+{
+    if (_caps.empty())
+        return NULL;
+    return new PerfMeasurement;
+}
+
+} // namespace repara::measurement::perf
+} // namespace repara::measurement
+} // namespace repara
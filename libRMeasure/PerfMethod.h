@@ -0,0 +1,108 @@
+/*
+Copyright (c) 2014-2017 University of Szeged
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software without
+   specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef PERFMETHOD_H_INCLUDED
+#define PERFMETHOD_H_INCLUDED
+
+#include "Method.h"
+
+namespace repara {
+namespace measurement {
+
+/**
+ * Namespace for the perf_event-based measurement method implementation.
+ */
+namespace perf {
+
+/**
+ * A measurement method implementation relying on the hardware performance
+ * counters read by the service (cycles, instructions, last level cache
+ * misses, branch misses). The counters are measured on the producer threads
+ * of the kernels (the device is the platform), or on every cpu of the
+ * sockets (the devices are the processors), as the service is configured.
+ * The counts are scaled by the service if the counters were multiplexed.
+ */
+class PerfMeasurement : public Measurement {
+    bool _inProgress; ///< specifies whether the measurement is in progress
+    KernelSourceMap _kernelResults; ///< contains the results of the measurement for each kernel
+    InvocationList _invocations; ///< contains the measured invocations in the order they were entered
+    std::vector<std::string> _kernelNames; ///< the names of the measured kernels, the invocations refer to them by their index
+
+public:
+    PerfMeasurement();
+    ~PerfMeasurement();
+
+    void stop();
+    const KernelSourceMap& kernelSourceMap() const;
+    /**
+     * The counts of the invocations of the kernel, the ones which couldn't
+     * be measured (batched markers, threads without counters) are left out
+     * of the sums and of the InvocationCount.
+     */
+    const SourceMap aggregatedSources(const std::string& kernelName) const;
+    const InvocationList& invocations() const;
+    const std::vector<std::string>& kernelNames() const;
+    const SourceContainer kernelSources(const std::string& kernelName) const;
+
+    const bool& isInProgress() const;
+
+}; // class PerfMethod::PerfMeasurement
+
+class PerfMethod : public Method {
+    SourceCapabilityMap _caps; ///< contains sourceCapabilities
+    static PerfMethod* _instance;
+
+    PerfMethod();
+    ~PerfMethod();
+    PerfMethod(const PerfMethod&) = delete;
+    void operator=(const PerfMethod&)  = delete;
+
+public:
+    static PerfMethod* getInstance();
+    static void deleteInstance();
+
+    /**
+     * This function will return the available sourceCapabilities.
+     */
+    const SourceCapabilityMap& sourceCapabilities() const;
+
+    /**
+     * Start a measurement. Calling stop() on the
+     * returned Measurement object will retrieve the counts from the
+     * service, and store this data into the SourceMap.
+     */
+    Measurement* start();
+
+}; // class PerfMethod
+
+} // namespace repara::measurement::perf
+} // namespace repara::measurement
+} // namespace repara
+
+#endif // PERFMETHOD_H_INCLUDED
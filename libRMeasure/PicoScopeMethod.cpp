@@ -29,6 +29,9 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "PicoScopeMethod.h"
 
+#include <algorithm>
+#include "MeasuredKernels.h"
+
 #include <xmlrpc-c/client_simple.hpp>
 
 #define XML_SIZE_LIMIT 64*1024*1024 // 64 MB
@@ -52,9 +55,10 @@ const std::string setSampleCommand = "pico.setSample";
 const std::string startListeningCommand = "scope.startListening";
 const std::string stopListeningCommand = "scope.stopListening";
 const std::string getMeasuredKernelsCommand = "rmeasure.getMeasuredKernels";
+const std::string getKernelInvocationsCommand = "rmeasure.getKernelInvocations";
 
 PicoScopeMeasurement::PicoScopeMeasurement()
-    : _rawData(), _allowRaw(false), _inProgress(true), _kernelResults()
+    : _rawData(), _allowRaw(false), _inProgress(true), _kernelResults(), _invocations(), _kernelNames()
 {
     xmlrpc_c::clientSimple myClient;
 
@@ -99,17 +103,41 @@ void PicoScopeMeasurement::stop()
         bool stopListening = static_cast<bool>(xmlrpc_c::value_boolean(stopListeningResult));
 
         if (stopStreaming && stopListening) {
-            xmlrpc_c::value measurementResults, kernelNames;
+            xmlrpc_c::value measurementResults, measuredKernels, kernelInvocations;
             myClient.call(getenv(SCOPESERVICE), getValuesCommand, "", &measurementResults);
-            myClient.call(getenv(RMEASURESERVICE), getMeasuredKernelsCommand, "", &kernelNames);
+            myClient.call(getenv(RMEASURESERVICE), getMeasuredKernelsCommand, "", &measuredKernels);
+            myClient.call(getenv(RMEASURESERVICE), getKernelInvocationsCommand, "", &kernelInvocations);
 
-            std::vector<xmlrpc_c::value> kernels = xmlrpc_c::value_array(kernelNames).cvalue();
+            std::vector<uint32_t> kernels;
+            decodeMeasuredKernels(measuredKernels, _kernelNames, kernels);
             std::vector<xmlrpc_c::value> kernelResults = xmlrpc_c::value_array(measurementResults).cvalue();
+            std::vector<xmlrpc_c::value> invocations = xmlrpc_c::value_array(kernelInvocations).cvalue();
+
+            // the parallel port is high while any producer is inside a kernel, the scope
+            // results belong to the invocations which raised it
+            const bool hasInvocations = invocations.size() == kernels.size();
+            InvocationList parsedInvocations;
+            std::vector<bool> scopeMarked(kernels.size(), true);
+            std::vector<double> scopeDelays(kernels.size(), 0.0);
+            for (std::size_t i = 0; i < kernels.size(); ++i)
+                parsedInvocations.push_back(kernelInvocation(kernels[i], hasInvocations ? &invocations[i] : NULL));
+            if (hasInvocations) {
+                for (std::size_t i = 0; i < invocations.size(); ++i) {
+                    std::map<std::string, xmlrpc_c::value> invocationMap(static_cast<std::map<std::string, xmlrpc_c::value> >(xmlrpc_c::value_struct(invocations[i])));
+                    if (invocationMap.count("scopeMarked"))
+                        scopeMarked[i] = static_cast<bool>(xmlrpc_c::value_boolean(invocationMap["scopeMarked"]));
+                    else
+                        scopeMarked[i] = (parsedInvocations[i].parent == -1);
+                    // the pin was raised and lowered late, by the delivery of the markers
+                    if (invocationMap.count("scopeBeginDelay") && invocationMap.count("scopeEndDelay"))
+                        scopeDelays[i] = static_cast<double>(xmlrpc_c::value_double(invocationMap["scopeBeginDelay"]))
+                                       - static_cast<double>(xmlrpc_c::value_double(invocationMap["scopeEndDelay"]));
+                }
+            }
+            const std::size_t topLevelCount = std::count(scopeMarked.begin(), scopeMarked.end(), true);
 
-            if (kernels.size() == kernelResults.size()) {
+            if (topLevelCount == kernelResults.size()) {
                 std::vector<xmlrpc_c::value>::iterator resultsIt = kernelResults.begin();
-                std::vector<xmlrpc_c::value>::iterator kernelsIt = kernels.begin();
-
 
                 xmlrpc_c::value rawDataResult; // use this if collecting raw is allowed
                 std::vector<xmlrpc_c::value> rawData; // use this if collecting raw is allowed
@@ -120,36 +148,53 @@ void PicoScopeMeasurement::stop()
                     xmlrpc_limit_set(XMLRPC_XML_SIZE_LIMIT_ID, XML_SIZE_LIMIT);
                     myClient.call(getenv(SCOPESERVICE), getRawDataCommand, "", &rawDataResult);
                     rawData = xmlrpc_c::value_array(rawDataResult).cvalue();
-                    if (rawData.size() != kernels.size())
+                    if (rawData.size() != topLevelCount)
                         _allowRaw = false;
                     else
                         rawIt = rawData.begin();
                 }
 
-                for (; resultsIt != kernelResults.end(); ++resultsIt, ++kernelsIt) {
-                    const xmlrpc_c::value_struct measurements = static_cast<xmlrpc_c::value_struct>(*resultsIt);
-                    std::map<std::string, xmlrpc_c::value> measurementsMap(static_cast<std::map<std::string, xmlrpc_c::value> >(measurements));
-                    std::map<std::string, xmlrpc_c::value>::iterator measurementsIt = measurementsMap.begin();
-                    SourceMap result;
-                    for (; measurementsIt != measurementsMap.end(); ++measurementsIt) {
-                        const std::string device = static_cast<std::string>(xmlrpc_c::value_string(measurementsIt->first));
-                        const xmlrpc_c::value_struct results = static_cast<xmlrpc_c::value_struct>(measurementsIt->second);
-                        std::map<std::string, xmlrpc_c::value> resultsMap(static_cast<std::map<std::string, xmlrpc_c::value> >(results));
-                        result[device][SourceCapability::Energy] = static_cast<double>(xmlrpc_c::value_double(resultsMap["energy"]));
-                        result[device][SourceCapability::MinimumPower] = static_cast<double>(xmlrpc_c::value_double(resultsMap["minPower"]));
-                        result[device][SourceCapability::MaximumPower] = static_cast<double>(xmlrpc_c::value_double(resultsMap["maxPower"]));
-                        result[device][SourceCapability::ElapsedTime] = static_cast<double>(xmlrpc_c::value_double(resultsMap["elapsedTime"]));
-                        result[device][SourceCapability::AveragePower] = result[device][SourceCapability::Energy] / result[device][SourceCapability::ElapsedTime];
+                // the results of a kernel are looked up by its name once, not at each invocation
+                std::vector<SourceContainer*> kernelContainers(_kernelNames.size(), NULL);
+                for (std::size_t index = 0; index < kernels.size(); ++index) {
+                    KernelInvocation& invocation = parsedInvocations[index];
+
+                    if (scopeMarked[index]) {
+                        const xmlrpc_c::value_struct measurements = static_cast<xmlrpc_c::value_struct>(*resultsIt);
+                        std::map<std::string, xmlrpc_c::value> measurementsMap(static_cast<std::map<std::string, xmlrpc_c::value> >(measurements));
+                        std::map<std::string, xmlrpc_c::value>::iterator measurementsIt = measurementsMap.begin();
+                        SourceMap result;
+                        for (; measurementsIt != measurementsMap.end(); ++measurementsIt) {
+                            const std::string device = static_cast<std::string>(xmlrpc_c::value_string(measurementsIt->first));
+                            const xmlrpc_c::value_struct results = static_cast<xmlrpc_c::value_struct>(measurementsIt->second);
+                            std::map<std::string, xmlrpc_c::value> resultsMap(static_cast<std::map<std::string, xmlrpc_c::value> >(results));
+                            result[device][SourceCapability::Energy] = static_cast<double>(xmlrpc_c::value_double(resultsMap["energy"]));
+                            result[device][SourceCapability::MinimumPower] = static_cast<double>(xmlrpc_c::value_double(resultsMap["minPower"]));
+                            result[device][SourceCapability::MaximumPower] = static_cast<double>(xmlrpc_c::value_double(resultsMap["maxPower"]));
+                            result[device][SourceCapability::ElapsedTime] = static_cast<double>(xmlrpc_c::value_double(resultsMap["elapsedTime"]));
+                            result[device][SourceCapability::AveragePower] = result[device][SourceCapability::Energy] / result[device][SourceCapability::ElapsedTime];
+
+                            // move the window to the marker timestamps, assuming the average power at its edges
+                            const double correctedTime = result[device][SourceCapability::ElapsedTime] + scopeDelays[index];
+                            if (scopeDelays[index] != 0.0 && correctedTime > 0.0) {
+                                result[device][SourceCapability::Energy] += result[device][SourceCapability::AveragePower] * scopeDelays[index];
+                                result[device][SourceCapability::ElapsedTime] = correctedTime;
+                            }
+                        }
+
+                        SourceContainer*& kernelContainer = kernelContainers[kernels[index]];
+                        if (!kernelContainer)
+                            kernelContainer = &_kernelResults[_kernelNames[kernels[index]]];
+                        kernelContainer->push_back(result);
+                        invocation.sources = result;
+                        ++resultsIt;
+
+                        if (_allowRaw) {
+                            _rawData[_kernelNames[kernels[index]]].push_back(static_cast<std::string>(xmlrpc_c::value_string(*rawIt)));
+                            ++rawIt;
+                        }
                     }
-                    const std::string kernelName = static_cast<std::string>(xmlrpc_c::value_string(*kernelsIt));
-
-                    _kernelResults[kernelName].push_back(result);
-
-                    if (_allowRaw) {
-                        _rawData[kernelName].push_back(static_cast<std::string>(xmlrpc_c::value_string(*rawIt)));
-                        ++rawIt;
-                    }
-
+                    _invocations.push_back(invocation);
                 }
             }
         }
@@ -164,18 +209,20 @@ const Measurement::KernelSourceMap& PicoScopeMeasurement::kernelSourceMap() cons
 const Measurement::SourceMap PicoScopeMeasurement::aggregatedSources(const std::string& kernelName) const
 {
     SourceMap aggregatedSources;
-    KernelSourceMap::const_iterator kernelIt = _kernelResults.find(kernelName);
-    if (kernelIt != _kernelResults.end()) {
-        SourceContainer::const_iterator containerIt = kernelIt->second.begin();
-        for (; containerIt != kernelIt->second.end(); ++containerIt) {
-            SourceMap::const_iterator sourceIt = containerIt->begin();
-            for (; sourceIt != containerIt->end(); ++sourceIt) {
+    const int kernel = kernelIndex(kernelName);
+    InvocationList::const_iterator invocationIt = _invocations.begin();
+    for (; invocationIt != _invocations.end(); ++invocationIt) {
+        if ((int)invocationIt->kernel == kernel) {
+            // a sampled invocation stands for weight invocations of the kernel
+            const double weight = invocationIt->weight;
+            SourceMap::const_iterator sourceIt = invocationIt->sources.begin();
+            for (; sourceIt != invocationIt->sources.end(); ++sourceIt) {
                 const std::string& device = sourceIt->first;
                 const DataMap& dataMap = sourceIt->second;
                 DataMap::const_iterator dataMapIt;
 
                 dataMapIt = dataMap.find(SourceCapability::Energy);
-                aggregatedSources[device][SourceCapability::Energy] += (dataMapIt != dataMap.end()) ? dataMapIt->second : 0.0;
+                aggregatedSources[device][SourceCapability::Energy] += (dataMapIt != dataMap.end()) ? weight * dataMapIt->second : 0.0;
 
                 dataMapIt = dataMap.find(SourceCapability::MinimumPower);
                 aggregatedSources[device][SourceCapability::MinimumPower] += (dataMapIt != dataMap.end()) ? dataMapIt->second : 0.0;
@@ -184,16 +231,28 @@ const Measurement::SourceMap PicoScopeMeasurement::aggregatedSources(const std::
                 aggregatedSources[device][SourceCapability::MaximumPower] += (dataMapIt != dataMap.end()) ? dataMapIt->second : 0.0;
 
                 dataMapIt = dataMap.find(SourceCapability::ElapsedTime);
-                aggregatedSources[device][SourceCapability::ElapsedTime] += (dataMapIt != dataMap.end()) ? dataMapIt->second : 0.0;
+                aggregatedSources[device][SourceCapability::ElapsedTime] += (dataMapIt != dataMap.end()) ? weight * dataMapIt->second : 0.0;
 
                 dataMapIt = dataMap.find(SourceCapability::AveragePower);
                 aggregatedSources[device][SourceCapability::AveragePower] += (dataMapIt != dataMap.end()) ? dataMapIt->second : 0.0;
+
+                aggregatedSources[device][SourceCapability::InvocationCount] += weight;
             }
         }
     }
     return aggregatedSources;
 }
 
+const Measurement::InvocationList& PicoScopeMeasurement::invocations() const
+{
+    return _invocations;
+}
+
+const std::vector<std::string>& PicoScopeMeasurement::kernelNames() const
+{
+    return _kernelNames;
+}
+
 const Measurement::SourceContainer PicoScopeMeasurement::kernelSources(const std::string& kernelName) const
 {
     SourceContainer sources;
@@ -291,6 +350,7 @@ bool PicoScopeMethod::openScope()
                 _caps[device] |= SourceCapability::MinimumPower;
                 _caps[device] |= SourceCapability::MaximumPower;
                 _caps[device] |= SourceCapability::AveragePower;
+                _caps[device] |= SourceCapability::InvocationCount;
             }
         }
     }
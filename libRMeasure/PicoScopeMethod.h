@@ -71,6 +71,8 @@ class PicoScopeMeasurement : public Measurement {
     bool _allowRaw; ///< specifies whether collecting raw data is enabled
     bool _inProgress; ///< specifies whether measurement is in progress
     KernelSourceMap _kernelResults; ///< contains the results for each measurement
+    InvocationList _invocations; ///< contains the measured invocations in the order they were entered
+    std::vector<std::string> _kernelNames; ///< the names of the measured kernels, the invocations refer to them by their index
 
 
 public:
@@ -80,6 +82,13 @@ public:
 
     const KernelSourceMap& kernelSourceMap() const;
     const SourceMap aggregatedSources(const std::string& kernelName) const;
+
+    /**
+     * The measured invocations. The scope marks the outermost regions only,
+     * so the nested invocations have no sources.
+     */
+    const InvocationList& invocations() const;
+    const std::vector<std::string>& kernelNames() const;
     const SourceContainer kernelSources(const std::string& kernelName) const;
 
     /**
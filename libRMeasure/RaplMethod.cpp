@@ -29,6 +29,9 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "RaplMethod.h"
 
+#include "MeasuredKernels.h"
+
+#include <algorithm>
 #include <xmlrpc-c/client_simple.hpp>
 
 namespace repara {
@@ -39,10 +42,46 @@ const std::string startListeningCommand = "rapl.startListening";
 const std::string stopListeningCommand = "rapl.stopListening";
 const std::string getMeasuredDataCommand = "rapl.getMeasuredData";
 const std::string getMeasuredProcessorsCommand = "rapl.getMeasuredProcessors";
+const std::string getMeasuredDomainsCommand = "rapl.getMeasuredDomains";
+const std::string getSamplingRateCommand = "rapl.getSamplingRate";
 const std::string getMeasuredKernelsCommand = "rmeasure.getMeasuredKernels";
+const std::string getKernelInvocationsCommand = "rmeasure.getKernelInvocations";
+
+/*
+ * The RAPL domains measured besides the package, and their capabilities. The
+ * service sends their results as "<domain>Energy". It is a function-local
+ * static, because the capabilities are initialized in another translation unit.
+ */
+static const std::map<std::string, SourceCapability>& domainCapabilities()
+{
+    static std::map<std::string, SourceCapability> capabilities;
+    if (capabilities.empty()) {
+        capabilities.insert(std::make_pair("pp0", SourceCapability::CoreEnergy));
+        capabilities.insert(std::make_pair("pp1", SourceCapability::UncoreEnergy));
+        capabilities.insert(std::make_pair("dram", SourceCapability::DramEnergy));
+        capabilities.insert(std::make_pair("psys", SourceCapability::PlatformEnergy));
+    }
+    return capabilities;
+}
+
+/*
+ * The power statistics of the sampler of the service, and their capabilities.
+ * They are sent only for the kernels overlapping a sampling interval.
+ */
+static const std::map<std::string, SourceCapability>& powerCapabilities()
+{
+    static std::map<std::string, SourceCapability> capabilities;
+    if (capabilities.empty()) {
+        capabilities.insert(std::make_pair("minPower", SourceCapability::MinimumPower));
+        capabilities.insert(std::make_pair("maxPower", SourceCapability::MaximumPower));
+        capabilities.insert(std::make_pair("medianPower", SourceCapability::MedianPower));
+        capabilities.insert(std::make_pair("p95Power", SourceCapability::Percentile95Power));
+    }
+    return capabilities;
+}
 
-RaplMeasurement::RaplMeasurement()
-    : _inProgress(true), _kernelResults()
+RaplMeasurement::RaplMeasurement(Aggregation aggregation)
+    : _inProgress(true), _kernelResults(), _invocations(), _kernelNames(), _aggregation(aggregation), _repeatedResults()
 {
     xmlrpc_c::clientSimple myClient;
     xmlrpc_c::value startListeningResult;
@@ -66,17 +105,23 @@ void RaplMeasurement::stop()
 
         bool stopListening = static_cast<bool>(xmlrpc_c::value_boolean(stopListeningResult));
         if (stopListening) {
-            xmlrpc_c::value measurementResults, kernelNames;
+            xmlrpc_c::value measurementResults, measuredKernels, kernelInvocations;
             myClient.call(getenv(RMEASURESERVICE), getMeasuredDataCommand, "", &measurementResults);
-            myClient.call(getenv(RMEASURESERVICE), getMeasuredKernelsCommand, "", &kernelNames);
+            myClient.call(getenv(RMEASURESERVICE), getMeasuredKernelsCommand, "", &measuredKernels);
+            myClient.call(getenv(RMEASURESERVICE), getKernelInvocationsCommand, "", &kernelInvocations);
 
-            std::vector<xmlrpc_c::value> kernels = xmlrpc_c::value_array(kernelNames).cvalue();
+            std::vector<uint32_t> kernels;
+            decodeMeasuredKernels(measuredKernels, _kernelNames, kernels);
             std::vector<xmlrpc_c::value> kernelResults = xmlrpc_c::value_array(measurementResults).cvalue();
+            std::vector<xmlrpc_c::value> invocations = xmlrpc_c::value_array(kernelInvocations).cvalue();
 
             if (kernels.size() == kernelResults.size()) {
                 std::vector<xmlrpc_c::value>::iterator resultsIt = kernelResults.begin();
-                std::vector<xmlrpc_c::value>::iterator kernelsIt = kernels.begin();
-                for (; resultsIt != kernelResults.end(); ++resultsIt, ++kernelsIt) {
+                std::vector<uint32_t>::const_iterator kernelsIt = kernels.begin();
+                std::size_t index = 0;
+                // the results of a kernel are looked up by its name once, not at each invocation
+                std::vector<SourceContainer*> kernelContainers(_kernelNames.size(), NULL);
+                for (; resultsIt != kernelResults.end(); ++resultsIt, ++kernelsIt, ++index) {
                     const xmlrpc_c::value_struct measurements = static_cast<xmlrpc_c::value_struct>(*resultsIt);
                     std::map<std::string, xmlrpc_c::value> measurementsMap(static_cast<std::map<std::string, xmlrpc_c::value> >(measurements));
                     std::map<std::string, xmlrpc_c::value>::iterator measurementsIt = measurementsMap.begin();
@@ -88,9 +133,49 @@ void RaplMeasurement::stop()
                         result[device][SourceCapability::Energy] = static_cast<double>(xmlrpc_c::value_double(resultsMap["energy"]));
                         result[device][SourceCapability::ElapsedTime] = static_cast<double>(xmlrpc_c::value_double(resultsMap["elapsedTime"]));
                         result[device][SourceCapability::AveragePower] = result[device][SourceCapability::Energy] / result[device][SourceCapability::ElapsedTime];
+                        std::map<std::string, SourceCapability>::const_iterator domainIt = domainCapabilities().begin();
+                        for (; domainIt != domainCapabilities().end(); ++domainIt) {
+                            if (resultsMap.count(domainIt->first + "Energy"))
+                                result[device][domainIt->second] = static_cast<double>(xmlrpc_c::value_double(resultsMap[domainIt->first + "Energy"]));
+                        }
+                        std::map<std::string, SourceCapability>::const_iterator powerIt = powerCapabilities().begin();
+                        for (; powerIt != powerCapabilities().end(); ++powerIt) {
+                            if (resultsMap.count(powerIt->first))
+                                result[device][powerIt->second] = static_cast<double>(xmlrpc_c::value_double(resultsMap[powerIt->first]));
+                        }
+                    }
+                    SourceContainer*& kernelContainer = kernelContainers[*kernelsIt];
+                    if (!kernelContainer)
+                        kernelContainer = &_kernelResults[_kernelNames[*kernelsIt]];
+                    kernelContainer->push_back(result);
+
+                    KernelInvocation invocation = kernelInvocation(*kernelsIt, invocations.size() == kernels.size() ? &invocations[index] : NULL);
+                    invocation.sources = result;
+                    _invocations.push_back(invocation);
+                }
+            }
+
+            // the services without the estimator send the invocations only
+            if (_aggregation == AGGREGATE_REPEATED) {
+                try {
+                    xmlrpc_c::value repeatedResults;
+                    myClient.call(getenv(RMEASURESERVICE), getMeasuredDataCommand, "s", &repeatedResults, "repeated");
+                    std::map<std::string, xmlrpc_c::value> kernelsMap(static_cast<std::map<std::string, xmlrpc_c::value> >(xmlrpc_c::value_struct(repeatedResults)));
+                    std::map<std::string, xmlrpc_c::value>::iterator kernelIt = kernelsMap.begin();
+                    for (; kernelIt != kernelsMap.end(); ++kernelIt) {
+                        std::map<std::string, xmlrpc_c::value> devicesMap(static_cast<std::map<std::string, xmlrpc_c::value> >(xmlrpc_c::value_struct(kernelIt->second)));
+                        std::map<std::string, xmlrpc_c::value>::iterator deviceIt = devicesMap.begin();
+                        for (; deviceIt != devicesMap.end(); ++deviceIt) {
+                            std::map<std::string, xmlrpc_c::value> resultsMap(static_cast<std::map<std::string, xmlrpc_c::value> >(xmlrpc_c::value_struct(deviceIt->second)));
+                            DataMap& result = _repeatedResults[kernelIt->first][deviceIt->first];
+                            result[SourceCapability::InvocationEnergy] = static_cast<double>(xmlrpc_c::value_double(resultsMap["energy"]));
+                            if (resultsMap.count("energyLow")) {
+                                result[SourceCapability::InvocationEnergyLow] = static_cast<double>(xmlrpc_c::value_double(resultsMap["energyLow"]));
+                                result[SourceCapability::InvocationEnergyHigh] = static_cast<double>(xmlrpc_c::value_double(resultsMap["energyHigh"]));
+                            }
+                        }
                     }
-                    const std::string kernelName = static_cast<std::string>(xmlrpc_c::value_string(*kernelsIt));
-                    _kernelResults[kernelName].push_back(result);
+                } catch (std::exception const&) {
                 }
             }
         }
@@ -105,30 +190,75 @@ const Measurement::KernelSourceMap& RaplMeasurement::kernelSourceMap() const
 const Measurement::SourceMap RaplMeasurement::aggregatedSources(const std::string& kernelName) const
 {
     SourceMap aggregatedSources;
-    KernelSourceMap::const_iterator kernelIt = _kernelResults.find(kernelName);
-    if (kernelIt != _kernelResults.end()) {
-        SourceContainer::const_iterator containerIt = kernelIt->second.begin();
-        for (; containerIt != kernelIt->second.end(); ++containerIt) {
-            SourceMap::const_iterator sourceIt = containerIt->begin();
-            for (; sourceIt != containerIt->end(); ++sourceIt) {
+    std::map<std::string, double> sampledTimes; // the time of the invocations with power statistics, by device
+    const int kernel = kernelIndex(kernelName);
+    InvocationList::const_iterator invocationIt = _invocations.begin();
+    for (; invocationIt != _invocations.end(); ++invocationIt) {
+        if ((int)invocationIt->kernel == kernel) {
+            // a sampled invocation stands for weight invocations of the kernel
+            const double weight = invocationIt->weight;
+            SourceMap::const_iterator sourceIt = invocationIt->sources.begin();
+            for (; sourceIt != invocationIt->sources.end(); ++sourceIt) {
                 const std::string& device = sourceIt->first;
                 const DataMap& dataMap = sourceIt->second;
                 DataMap::const_iterator dataMapIt;
 
                 dataMapIt = dataMap.find(SourceCapability::Energy);
-                aggregatedSources[device][SourceCapability::Energy] += (dataMapIt != dataMap.end()) ? dataMapIt->second : 0.0;
+                aggregatedSources[device][SourceCapability::Energy] += (dataMapIt != dataMap.end()) ? weight * dataMapIt->second : 0.0;
 
                 dataMapIt = dataMap.find(SourceCapability::ElapsedTime);
-                aggregatedSources[device][SourceCapability::ElapsedTime] += (dataMapIt != dataMap.end()) ? dataMapIt->second : 0.0;
+                aggregatedSources[device][SourceCapability::ElapsedTime] += (dataMapIt != dataMap.end()) ? weight * dataMapIt->second : 0.0;
 
                 dataMapIt = dataMap.find(SourceCapability::AveragePower);
                 aggregatedSources[device][SourceCapability::AveragePower] += (dataMapIt != dataMap.end()) ? dataMapIt->second : 0.0;
+
+                std::map<std::string, SourceCapability>::const_iterator domainIt = domainCapabilities().begin();
+                for (; domainIt != domainCapabilities().end(); ++domainIt) {
+                    dataMapIt = dataMap.find(domainIt->second);
+                    if (dataMapIt != dataMap.end())
+                        aggregatedSources[device][domainIt->second] += weight * dataMapIt->second;
+                }
+
+                // the extremes of the invocations, and the time-weighted mean of their median and 95th percentile
+                dataMapIt = dataMap.find(SourceCapability::MinimumPower);
+                if (dataMapIt != dataMap.end()) {
+                    DataMap& aggregated = aggregatedSources[device];
+                    const double time = weight * dataMap.find(SourceCapability::ElapsedTime)->second;
+                    const double previousTime = sampledTimes[device];
+                    sampledTimes[device] += time;
+                    aggregated[SourceCapability::MinimumPower] = previousTime > 0.0 ? std::min(aggregated[SourceCapability::MinimumPower], dataMapIt->second) : dataMapIt->second;
+                    aggregated[SourceCapability::MaximumPower] = std::max(aggregated[SourceCapability::MaximumPower], dataMap.find(SourceCapability::MaximumPower)->second);
+                    const SourceCapability averaged[] = { SourceCapability::MedianPower, SourceCapability::Percentile95Power };
+                    for (std::size_t i = 0; i < 2; ++i) {
+                        const double value = dataMap.find(averaged[i])->second;
+                        aggregated[averaged[i]] = sampledTimes[device] > 0.0 ? (aggregated[averaged[i]] * previousTime + value * time) / sampledTimes[device] : value;
+                    }
+                }
+
+                aggregatedSources[device][SourceCapability::InvocationCount] += weight;
             }
         }
     }
+
+    std::map<std::string, SourceMap>::const_iterator repeatedIt = _repeatedResults.find(kernelName);
+    if (repeatedIt != _repeatedResults.end()) {
+        SourceMap::const_iterator sourceIt = repeatedIt->second.begin();
+        for (; sourceIt != repeatedIt->second.end(); ++sourceIt)
+            aggregatedSources[sourceIt->first].insert(sourceIt->second.begin(), sourceIt->second.end());
+    }
     return aggregatedSources;
 }
 
+const Measurement::InvocationList& RaplMeasurement::invocations() const
+{
+    return _invocations;
+}
+
+const std::vector<std::string>& RaplMeasurement::kernelNames() const
+{
+    return _kernelNames;
+}
+
 const Measurement::SourceContainer RaplMeasurement::kernelSources(const std::string& kernelName) const
 {
     SourceContainer sources;
@@ -145,7 +275,7 @@ const bool& RaplMeasurement::isInProgress() const
 }
 
 RaplMethod::RaplMethod()
-    : _caps()
+    : _caps(), _repeatedCaps(), _aggregation(AGGREGATE_INVOCATIONS)
 {
     xmlrpc_c::clientSimple myClient;
     xmlrpc_c::value measuredProcessors;
@@ -153,12 +283,46 @@ RaplMethod::RaplMethod()
     myClient.call(getenv(RMEASURESERVICE), getMeasuredProcessorsCommand, "", &measuredProcessors);
     std::vector<xmlrpc_c::value> processors = xmlrpc_c::value_array(measuredProcessors).cvalue();
 
+    // the services without the domains measure the package only
+    SourceCapabilities domainCaps;
+    try {
+        xmlrpc_c::value measuredDomains;
+        myClient.call(getenv(RMEASURESERVICE), getMeasuredDomainsCommand, "", &measuredDomains);
+        std::vector<xmlrpc_c::value> domains = xmlrpc_c::value_array(measuredDomains).cvalue();
+        for (std::size_t i = 0; i < domains.size(); ++i) {
+            std::map<std::string, SourceCapability>::const_iterator domainIt = domainCapabilities().find(static_cast<std::string>(xmlrpc_c::value_string(domains[i])));
+            if (domainIt != domainCapabilities().end())
+                domainCaps |= domainIt->second;
+        }
+    } catch (std::exception const&) {
+    }
+
+    // the services without the sampler don't send the power statistics
+    SourceCapabilities powerCaps;
+    try {
+        xmlrpc_c::value samplingRate;
+        myClient.call(getenv(RMEASURESERVICE), getSamplingRateCommand, "", &samplingRate);
+        if (static_cast<double>(xmlrpc_c::value_double(samplingRate)) > 0.0) {
+            std::map<std::string, SourceCapability>::const_iterator powerIt = powerCapabilities().begin();
+            for (; powerIt != powerCapabilities().end(); ++powerIt)
+                powerCaps |= powerIt->second;
+        }
+    } catch (std::exception const&) {
+    }
+
     std::vector<xmlrpc_c::value>::iterator procIt = processors.begin();
     for (; procIt != processors.end(); ++procIt) {
         const std::string device = static_cast<std::string>(xmlrpc_c::value_string(*procIt));
         _caps[device] = SourceCapability::ElapsedTime;
         _caps[device] |= SourceCapability::Energy;
         _caps[device] |= SourceCapability::AveragePower;
+        _caps[device] |= SourceCapability::InvocationCount;
+        _caps[device] |= domainCaps;
+        _caps[device] |= powerCaps;
+        _repeatedCaps[device] = _caps[device];
+        _repeatedCaps[device] |= SourceCapability::InvocationEnergy;
+        _repeatedCaps[device] |= SourceCapability::InvocationEnergyLow;
+        _repeatedCaps[device] |= SourceCapability::InvocationEnergyHigh;
     }
 }
 
@@ -183,14 +347,19 @@ void RaplMethod::deleteInstance()
 
 const Method::SourceCapabilityMap& RaplMethod::sourceCapabilities() const
 {
-    return _caps;
+    return _aggregation == AGGREGATE_REPEATED ? _repeatedCaps : _caps;
+}
+
+void RaplMethod::setAggregation(Aggregation aggregation)
+{
+    _aggregation = aggregation;
 }
 
 Measurement* RaplMethod::start()
 {
     if (_caps.empty())
         return NULL;
-    return new RaplMeasurement();
+    return new RaplMeasurement(_aggregation);
 }
 
 } // namespace repara::measurement::rapl
@@ -40,6 +40,15 @@ namespace measurement {
  */
 namespace rapl {
 
+/**
+ * How RaplMeasurement::aggregatedSources() aggregates the invocations of a kernel.
+ */
+enum Aggregation
+{
+    AGGREGATE_INVOCATIONS, ///< the totals of the measured invocations
+    AGGREGATE_REPEATED ///< the totals, and the energy of one invocation estimated by the service from the repeated invocations
+};
+
 /**
  * A simple measurement method implementation relying on RAPL energy readings.
  * The /dev/cpu/?/msr driver must be enabled and permissions set
@@ -48,14 +57,26 @@ namespace rapl {
 class RaplMeasurement : public Measurement {
     bool _inProgress; ///< specifies whether the measurement is in progress
     KernelSourceMap _kernelResults; ///< contains the results of the measurement for each kernel
+    InvocationList _invocations; ///< contains the measured invocations in the order they were entered
+    std::vector<std::string> _kernelNames; ///< the names of the measured kernels, the invocations refer to them by their index
+    Aggregation _aggregation;
+    std::map<std::string, SourceMap> _repeatedResults; ///< the repeated-invocation estimates of the kernels (AGGREGATE_REPEATED)
 
 public:
-    RaplMeasurement();
+    RaplMeasurement(Aggregation aggregation = AGGREGATE_INVOCATIONS);
     ~RaplMeasurement();
 
     void stop();
     const KernelSourceMap& kernelSourceMap() const;
+    /**
+     * With AGGREGATE_REPEATED, InvocationEnergy is the energy per invocation
+     * estimated from the repeated invocations of the kernel, and
+     * InvocationEnergyLow and InvocationEnergyHigh are its 95% confidence
+     * interval (if the invocations spanned enough time to resample them).
+     */
     const SourceMap aggregatedSources(const std::string& kernelName) const;
+    const InvocationList& invocations() const;
+    const std::vector<std::string>& kernelNames() const;
     const SourceContainer kernelSources(const std::string& kernelName) const;
 
     const bool& isInProgress() const;
@@ -64,6 +85,8 @@ public:
 
 class RaplMethod : public Method {
     SourceCapabilityMap _caps; ///< contains sourceCapabilities
+    SourceCapabilityMap _repeatedCaps; ///< contains sourceCapabilities with AGGREGATE_REPEATED
+    Aggregation _aggregation;
     static RaplMethod* _instance;
 
     RaplMethod();
@@ -80,6 +103,14 @@ public:
      */
     const SourceCapabilityMap& sourceCapabilities() const;
 
+    /**
+     * Set how the measurements started after this call aggregate the
+     * invocations of a kernel. AGGREGATE_REPEATED is meant for the kernels
+     * which are much shorter than the update interval of the RAPL counters
+     * (about a millisecond), the energy of their single invocations is noise.
+     */
+    void setAggregation(Aggregation aggregation);
+
     /**
      * Start a measurement. Calling stop() on the
      * returned Measurement object will retrieve the results from the
@@ -62,6 +62,20 @@ const SourceCapability SourceCapability::MaximumPower(1 << 3);
 const SourceCapability SourceCapability::ElapsedTime(1 << 4);
 const SourceCapability SourceCapability::KernelTime(1 << 5);
 const SourceCapability SourceCapability::UserTime(1 << 6);
+const SourceCapability SourceCapability::InvocationCount(1 << 7);
+const SourceCapability SourceCapability::CoreEnergy(1 << 8);
+const SourceCapability SourceCapability::UncoreEnergy(1 << 9);
+const SourceCapability SourceCapability::DramEnergy(1 << 10);
+const SourceCapability SourceCapability::PlatformEnergy(1 << 11);
+const SourceCapability SourceCapability::MedianPower(1 << 12);
+const SourceCapability SourceCapability::Percentile95Power(1 << 13);
+const SourceCapability SourceCapability::InvocationEnergy(1 << 14);
+const SourceCapability SourceCapability::InvocationEnergyLow(1 << 15);
+const SourceCapability SourceCapability::InvocationEnergyHigh(1 << 16);
+const SourceCapability SourceCapability::Cycles(1 << 17);
+const SourceCapability SourceCapability::Instructions(1 << 18);
+const SourceCapability SourceCapability::LlcMisses(1 << 19);
+const SourceCapability SourceCapability::BranchMisses(1 << 20);
 
 SourceCapabilities::SourceCapabilities(Type s) : _set(s)
 {
@@ -53,6 +53,20 @@ public:
     static const SourceCapability ElapsedTime; ///< Capability of elapsed time (a.k.a. wall-clock time) measurement (in seconds)
     static const SourceCapability KernelTime; ///< Capability of measuring CPU-time spent in kernel mode (in seconds)
     static const SourceCapability UserTime; ///< Capability of measuring CPU-time spent in user mode (in seconds)
+    static const SourceCapability InvocationCount; ///< Capability of counting the invocations of a kernel (estimated if the kernel is sampled)
+    static const SourceCapability CoreEnergy; ///< Capability of measuring the energy consumption of the cores of a processor (in Joules, RAPL PP0)
+    static const SourceCapability UncoreEnergy; ///< Capability of measuring the energy consumption of the uncore or graphics of a processor (in Joules, RAPL PP1)
+    static const SourceCapability DramEnergy; ///< Capability of measuring the energy consumption of the memory attached to a processor (in Joules, RAPL DRAM)
+    static const SourceCapability PlatformEnergy; ///< Capability of measuring the energy consumption of the whole platform (in Joules, RAPL PSys)
+    static const SourceCapability MedianPower; ///< Capability of measuring median power dissipation (in Watts)
+    static const SourceCapability Percentile95Power; ///< Capability of measuring the 95th percentile of power dissipation (in Watts)
+    static const SourceCapability InvocationEnergy; ///< Capability of estimating the energy consumption of one invocation of a kernel from its repeated invocations (in Joules)
+    static const SourceCapability InvocationEnergyLow; ///< Capability of estimating the lower bound of the 95% confidence interval of InvocationEnergy (in Joules)
+    static const SourceCapability InvocationEnergyHigh; ///< Capability of estimating the upper bound of the 95% confidence interval of InvocationEnergy (in Joules)
+    static const SourceCapability Cycles; ///< Capability of counting the core cycles (perf_event, scaled if the counters were multiplexed)
+    static const SourceCapability Instructions; ///< Capability of counting the retired instructions (perf_event, scaled if the counters were multiplexed)
+    static const SourceCapability LlcMisses; ///< Capability of counting the read misses of the last level cache (perf_event, scaled if the counters were multiplexed)
+    static const SourceCapability BranchMisses; ///< Capability of counting the mispredicted branches (perf_event, scaled if the counters were multiplexed)
 
     /** Check whether two capabilities are equal. */
     bool operator==(SourceCapability that) const;
@@ -29,6 +29,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "TimerMethod.h"
 
+#include "MeasuredKernels.h"
+
 #include <xmlrpc-c/client_simple.hpp>
 
 namespace repara {
@@ -39,10 +41,12 @@ const std::string startListeningCommand = "timer.startListening";
 const std::string stopListeningCommand = "timer.stopListening";
 const std::string getMeasuredDataCommand = "timer.getMeasuredData";
 const std::string getMeasuredSystemIdCommand = "timer.getMeasuredSystemId";
+const std::string getMeasuredTimesCommand = "timer.getMeasuredTimes";
 const std::string getMeasuredKernelsCommand = "rmeasure.getMeasuredKernels";
+const std::string getKernelInvocationsCommand = "rmeasure.getKernelInvocations";
 
 TimerMeasurement::TimerMeasurement()
-    : _inProgress(true), _kernelResults()
+    : _inProgress(true), _kernelResults(), _invocations(), _kernelNames()
 {
     xmlrpc_c::clientSimple myClient;
     xmlrpc_c::value startListeningResult;
@@ -65,17 +69,23 @@ void TimerMeasurement::stop()
         myClient.call(getenv(RMEASURESERVICE), stopListeningCommand, "", &stopListeningResult);
         bool stopListening = static_cast<bool>(xmlrpc_c::value_boolean(stopListeningResult));
         if (stopListening) {
-            xmlrpc_c::value measurementResults, kernelNames;
+            xmlrpc_c::value measurementResults, measuredKernels, kernelInvocations;
             myClient.call(getenv(RMEASURESERVICE), getMeasuredDataCommand, "", &measurementResults);
-            myClient.call(getenv(RMEASURESERVICE), getMeasuredKernelsCommand, "", &kernelNames);
+            myClient.call(getenv(RMEASURESERVICE), getMeasuredKernelsCommand, "", &measuredKernels);
+            myClient.call(getenv(RMEASURESERVICE), getKernelInvocationsCommand, "", &kernelInvocations);
 
-            std::vector<xmlrpc_c::value> kernels = xmlrpc_c::value_array(kernelNames).cvalue();
+            std::vector<uint32_t> kernels;
+            decodeMeasuredKernels(measuredKernels, _kernelNames, kernels);
             std::vector<xmlrpc_c::value> kernelResults = xmlrpc_c::value_array(measurementResults).cvalue();
+            std::vector<xmlrpc_c::value> invocations = xmlrpc_c::value_array(kernelInvocations).cvalue();
             if (kernels.size() == kernelResults.size()) {
                 std::vector<xmlrpc_c::value>::iterator resultsIt = kernelResults.begin();
-                std::vector<xmlrpc_c::value>::iterator kernelsIt = kernels.begin();
+                std::vector<uint32_t>::const_iterator kernelsIt = kernels.begin();
+                std::size_t index = 0;
+                // the results of a kernel are looked up by its name once, not at each invocation
+                std::vector<SourceContainer*> kernelContainers(_kernelNames.size(), NULL);
 
-                for (; resultsIt != kernelResults.end(); ++resultsIt, ++kernelsIt) {
+                for (; resultsIt != kernelResults.end(); ++resultsIt, ++kernelsIt, ++index) {
                     const xmlrpc_c::value_struct measurements = static_cast<xmlrpc_c::value_struct>(*resultsIt);
                     std::map<std::string, xmlrpc_c::value> measurementsMap(static_cast<std::map<std::string, xmlrpc_c::value> >(measurements));
                     std::map<std::string, xmlrpc_c::value>::iterator measurementsIt = measurementsMap.begin();
@@ -85,9 +95,19 @@ void TimerMeasurement::stop()
                         const xmlrpc_c::value_struct results = static_cast<xmlrpc_c::value_struct>(measurementsIt->second);
                         std::map<std::string, xmlrpc_c::value> resultsMap(static_cast<std::map<std::string, xmlrpc_c::value> >(results));
                         result[device][SourceCapability::ElapsedTime] = static_cast<double>(xmlrpc_c::value_double(resultsMap["elapsedTime"]));
+                        if (resultsMap.count("userTime")) {
+                            result[device][SourceCapability::UserTime] = static_cast<double>(xmlrpc_c::value_double(resultsMap["userTime"]));
+                            result[device][SourceCapability::KernelTime] = static_cast<double>(xmlrpc_c::value_double(resultsMap["kernelTime"]));
+                        }
                     }
-                    const std::string kernelName = static_cast<std::string>(xmlrpc_c::value_string(*kernelsIt));
-                    _kernelResults[kernelName].push_back(result);
+                    SourceContainer*& kernelContainer = kernelContainers[*kernelsIt];
+                    if (!kernelContainer)
+                        kernelContainer = &_kernelResults[_kernelNames[*kernelsIt]];
+                    kernelContainer->push_back(result);
+
+                    KernelInvocation invocation = kernelInvocation(*kernelsIt, invocations.size() == kernels.size() ? &invocations[index] : NULL);
+                    invocation.sources = result;
+                    _invocations.push_back(invocation);
                 }
             }
         }
@@ -102,23 +122,45 @@ const Measurement::KernelSourceMap& TimerMeasurement::kernelSourceMap() const
 const Measurement::SourceMap TimerMeasurement::aggregatedSources(const std::string& kernelName) const
 {
     SourceMap aggregatedSources;
-    KernelSourceMap::const_iterator kernelIt = _kernelResults.find(kernelName);
-    if (kernelIt != _kernelResults.end()) {
-        SourceContainer::const_iterator containerIt = kernelIt->second.begin();
-        for (; containerIt != kernelIt->second.end(); ++containerIt) {
-            SourceMap::const_iterator sourceIt = containerIt->begin();
-            for (; sourceIt != containerIt->end(); ++sourceIt) {
+    const int kernel = kernelIndex(kernelName);
+    InvocationList::const_iterator invocationIt = _invocations.begin();
+    for (; invocationIt != _invocations.end(); ++invocationIt) {
+        if ((int)invocationIt->kernel == kernel) {
+            // a sampled invocation stands for weight invocations of the kernel
+            const double weight = invocationIt->weight;
+            SourceMap::const_iterator sourceIt = invocationIt->sources.begin();
+            for (; sourceIt != invocationIt->sources.end(); ++sourceIt) {
                 const std::string& device = sourceIt->first;
                 const DataMap& dataMap = sourceIt->second;
                 DataMap::const_iterator dataMapIt;
                 dataMapIt = dataMap.find(SourceCapability::ElapsedTime);
-                aggregatedSources[device][SourceCapability::ElapsedTime] += (dataMapIt != dataMap.end()) ? dataMapIt->second : 0.0;
+                aggregatedSources[device][SourceCapability::ElapsedTime] += (dataMapIt != dataMap.end()) ? weight * dataMapIt->second : 0.0;
+
+                // the CPU times are missing from the batched invocations
+                dataMapIt = dataMap.find(SourceCapability::UserTime);
+                if (dataMapIt != dataMap.end())
+                    aggregatedSources[device][SourceCapability::UserTime] += weight * dataMapIt->second;
+                dataMapIt = dataMap.find(SourceCapability::KernelTime);
+                if (dataMapIt != dataMap.end())
+                    aggregatedSources[device][SourceCapability::KernelTime] += weight * dataMapIt->second;
+
+                aggregatedSources[device][SourceCapability::InvocationCount] += weight;
             }
         }
     }
     return aggregatedSources;
 }
 
+const Measurement::InvocationList& TimerMeasurement::invocations() const
+{
+    return _invocations;
+}
+
+const std::vector<std::string>& TimerMeasurement::kernelNames() const
+{
+    return _kernelNames;
+}
+
 const Measurement::SourceContainer TimerMeasurement::kernelSources(const std::string& kernelName) const
 {
     SourceContainer sources;
@@ -138,8 +180,25 @@ TimerMethod::TimerMethod()
 
     myClient.call(getenv(RMEASURESERVICE), getMeasuredSystemIdCommand, "", &measuredSystemId);
     const std::string device = static_cast<std::string>(xmlrpc_c::value_string(measuredSystemId));
-    if (!device.empty())
+    if (!device.empty()) {
         _caps[device] = SourceCapability::ElapsedTime;
+        _caps[device] |= SourceCapability::InvocationCount;
+
+        // the services without the CPU times measure the elapsed time only
+        try {
+            xmlrpc_c::value measuredTimes;
+            myClient.call(getenv(RMEASURESERVICE), getMeasuredTimesCommand, "", &measuredTimes);
+            std::vector<xmlrpc_c::value> times = xmlrpc_c::value_array(measuredTimes).cvalue();
+            for (std::size_t i = 0; i < times.size(); ++i) {
+                const std::string time = static_cast<std::string>(xmlrpc_c::value_string(times[i]));
+                if (time == "userTime")
+                    _caps[device] |= SourceCapability::UserTime;
+                else if (time == "kernelTime")
+                    _caps[device] |= SourceCapability::KernelTime;
+            }
+        } catch (std::exception const&) {
+        }
+    }
 }
 
 TimerMethod::~TimerMethod()
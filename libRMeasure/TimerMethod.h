@@ -42,13 +42,16 @@ namespace timer {
 
 /**
  * A simple measurement method implementation relying on the time() function.
- * The only supported type of measured data is wall-clock time elapsed between
+ * The measured data is the wall-clock time elapsed between
  * TimerMethod::start() and TimerMeasurement::stop(), and it's reported as a measurement done on the whole
- * system.
+ * system. If the service reads them, the user and kernel CPU times of the
+ * producer thread are reported too (UserTime, KernelTime).
  */
 class TimerMeasurement : public Measurement {
     bool _inProgress; ///< specifies whether the measurement is in progress
     KernelSourceMap _kernelResults;
+    InvocationList _invocations; ///< contains the measured invocations in the order they were entered
+    std::vector<std::string> _kernelNames; ///< the names of the measured kernels, the invocations refer to them by their index
 
 public:
     TimerMeasurement();
@@ -57,6 +60,8 @@ public:
 
     const KernelSourceMap& kernelSourceMap() const;
     const SourceMap aggregatedSources(const std::string& kernelName) const;
+    const InvocationList& invocations() const;
+    const std::vector<std::string>& kernelNames() const;
     const SourceContainer kernelSources(const std::string& kernelName) const;
     const bool& isInProgress() const;
 